@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <string>
 
 #include "imgui.h"
@@ -286,8 +287,17 @@ void GUI::drawRenderSettings(Render& render) {
     }
 
     // Denoise Button
+    // デノイズはバックグラウンドで行い、終わったらDenoise Layerに反映される
     if (ImGui::Button("Denoise")) {
-      render.renderer.denoise();
+      render.renderer.requestDenoise();
+    }
+    ImGui::SameLine();
+
+    // Interactiveでデノイズするパスの間隔(0ならデノイズしない)
+    static int denoise_interval = render.renderer.getDenoiseInterval();
+    if (ImGui::InputInt("Denoise Interval", &denoise_interval)) {
+      denoise_interval = std::max(denoise_interval, 0);
+      render.renderer.setDenoiseInterval(denoise_interval);
     }
 
     ImGui::Separator();
@@ -314,6 +324,23 @@ void GUI::drawRenderSettings(Render& render) {
       // Save layer
       render.renderer.saveLayer(std::string(filename));
     }
+
+    // 全てのレイヤーを1つのEXRにまとめて保存する
+    static int exr_compression =
+        static_cast<int>(render.renderer.getEXRCompression());
+    if (ImGui::Combo("EXR Compression", &exr_compression,
+                     "None\0RLE\0ZIPS\0ZIP\0PIZ\0\0")) {
+      render.renderer.setEXRCompression(
+          static_cast<Prl2::EXRCompression>(exr_compression));
+    }
+    static int exr_tile_size = render.renderer.getEXRTileSize();
+    if (ImGui::InputInt("EXR Tile Size", &exr_tile_size)) {
+      exr_tile_size = std::max(exr_tile_size, 0);
+      render.renderer.setEXRTileSize(exr_tile_size);
+    }
+    if (ImGui::Button("Save All Layers (EXR)")) {
+      render.renderer.saveAllLayers(std::string(filename));
+    }
   }
   ImGui::End();
 
@@ -470,12 +497,16 @@ void GUI::drawIntegratorUI(Render& render) {
       e = 0;
     } else if (type == Prl2::IntegratorType::NEE) {
       e = 1;
+    } else if (type == Prl2::IntegratorType::Wavefront) {
+      e = 2;
     }
-    if (ImGui::Combo("Integrator Type", &e, "PT\0NEE\0\0")) {
+    if (ImGui::Combo("Integrator Type", &e, "PT\0NEE\0Wavefront\0\0")) {
       if (e == 0) {
         render.renderer.setIntegratorType(Prl2::IntegratorType::PT);
       } else if (e == 1) {
         render.renderer.setIntegratorType(Prl2::IntegratorType::NEE);
+      } else if (e == 2) {
+        render.renderer.setIntegratorType(Prl2::IntegratorType::Wavefront);
       }
     }
   }
@@ -1,12 +1,12 @@
 #include "render.h"
 
 #include "camera/pinhole.h"
-#include "intersector/embree.h"
 #include "intersector/linear.h"
 #include "light/area-light.h"
 #include "material/diffuse.h"
 #include "material/glass.h"
 #include "material/mirror.h"
+#include "renderer/scene-loader.h"
 #include "shape/plane.h"
 #include "shape/sphere.h"
 
@@ -70,9 +70,8 @@ void Render::initScene() {
   const auto prim7 =
       std::make_shared<Prl2::Primitive>(geom7, diffuse_white, light);
 
-  std::shared_ptr<Prl2::EmbreeIntersector> intersector =
-      std::make_shared<Prl2::EmbreeIntersector>();
-  renderer.scene.intersector = intersector;
+  renderer.scene.intersector =
+      Prl2::createIntersector(renderer.config.intersector_type);
 
   renderer.scene.addPrimitive(prim1);
   renderer.scene.addPrimitive(prim2);
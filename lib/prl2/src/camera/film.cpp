@@ -4,39 +4,32 @@
 #include <cmath>
 #include <fstream>
 #include <iostream>
+#include <vector>
 
 namespace Prl2 {
 
 void Film::writePPM(const std::string& filename) const {
-  std::ofstream file(filename);
-
-  file << "P3" << std::endl;
-  file << width << " " << height << std::endl;
-  file << "255" << std::endl;
+  std::ofstream file(filename, std::ios::binary);
+  file << "P6\n" << width << " " << height << "\n255\n";
 
+  // 1行ずつ変換してまとめて書き込む
+  std::vector<unsigned char> row(3 * width);
   for (std::size_t j = 0; j < height; ++j) {
     for (std::size_t i = 0; i < width; ++i) {
-      const SPD spd = getPixel(i, j);
-
       // RGBを計算
       // ガンマ補正も同時に行う
-      const RGB rgb = spd.toRGB();
-      const unsigned int r = std::clamp(
-          static_cast<unsigned int>(255 * std::pow(rgb.x(), 1 / 2.2)),
-          static_cast<unsigned int>(0), static_cast<unsigned int>(255));
-      const unsigned int g = std::clamp(
-          static_cast<unsigned int>(255 * std::pow(rgb.y(), 1 / 2.2)),
-          static_cast<unsigned int>(0), static_cast<unsigned int>(255));
-      const unsigned int b = std::clamp(
-          static_cast<unsigned int>(255 * std::pow(rgb.z(), 1 / 2.2)),
-          static_cast<unsigned int>(0), static_cast<unsigned int>(255));
-
-      //書き込み
-      file << r << " " << g << " " << b << std::endl;
+      const RGB rgb = getRGB(i, j);
+      for (int c = 0; c < 3; ++c) {
+        const Real v = rgb[c] > 0 ? std::pow(rgb[c], 1 / 2.2f) : 0;
+        row[3 * i + static_cast<std::size_t>(c)] =
+            static_cast<unsigned char>(255 * std::min(v, 1.0f));
+      }
     }
-  }
 
-  file.close();
+    //書き込み
+    file.write(reinterpret_cast<const char*>(row.data()),
+               static_cast<std::streamsize>(row.size()));
+  }
 }
 
 }
\ No newline at end of file
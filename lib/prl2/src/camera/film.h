@@ -12,90 +12,125 @@
 
 namespace Prl2 {
 
+// Filmの種類
+// CIEXYZはSPDを保持しない代わりに、画素あたりのメモリがSpectralの1/20になる
+enum class FilmType {
+  Spectral,  // 画素ごとにSPDを格納する
+  CIEXYZ,    // 画素ごとに等色関数で重み付けしたXYZを格納する
+};
+
 //フィルム面を表すクラス
-// SPDを画素ごとに格納する
+// SPDまたはXYZを画素ごとに格納する
 //フィルム面の位置は[-0.5*width_length, 0.5*width_length] x [-0.5*height_length,
 // 0.5*height_length]で表される
 class Film {
  public:
   unsigned int width;       //横幅
   unsigned int height;      //縦幅
-  Real width_length;        //横の物理的長さ[m]
-  Real height_length;       //縦の物理的長さ[m]
-  Real diagonal_length;     //対角線の物理的長さ[m]
-  std::vector<SPD> pixels;  //画素
+  Real width_length;            //横の物理的長さ[m]
+  Real height_length;           //縦の物理的長さ[m]
+  Real diagonal_length;         //対角線の物理的長さ[m]
+  FilmType type;                // Filmの種類
+  std::vector<SPD> pixels;      //画素(Spectralの場合)
+  std::vector<XYZ> xyz_pixels;  //画素(XYZの場合)
 
   Film(unsigned int _width, unsigned int _height,
        const Real& _width_length = 0.0251f,
-       const Real& _height_length = 0.0251f)
+       const Real& _height_length = 0.0251f,
+       const FilmType& _type = FilmType::Spectral)
       : width(_width),
         height(_height),
         width_length(_width_length),
         height_length(_height_length),
         diagonal_length(std::sqrt(width_length * width_length +
-                                  height_length * height_length)) {
-    pixels.resize(width * height);
+                                  height_length * height_length)),
+        type(_type) {
+    resize(width, height);
   }
 
   // (i, j)のSPDを入手
+  // XYZの場合はSPDを保持していないので黒を返す
   SPD getPixel(unsigned int i, unsigned int j) const {
     assert(i < width);
     assert(j < height);
+    if (type == FilmType::CIEXYZ) {
+      return SPD();
+    }
     return pixels[i + width * j];
   }
   //物理的位置からSPDを入手
   SPD getpixel(const Vec2& v) const {
     unsigned int i, j;
     computeIndex(v, i, j);
+    return getPixel(i, j);
+  }
+
+  // (i, j)のXYZを入手
+  XYZ getXYZ(unsigned int i, unsigned int j) const {
     assert(i < width);
     assert(j < height);
-    return pixels[i + width * j];
+    if (type == FilmType::CIEXYZ) {
+      return xyz_pixels[i + width * j];
+    }
+    return pixels[i + width * j].toXYZ();
+  }
+
+  // (i, j)のsRGBを入手
+  RGB getRGB(unsigned int i, unsigned int j) const {
+    return clamp(XYZ2RGB(getXYZ(i, j)), Vec3(0), Vec3(INF));
   }
 
   //(i, j)にSPDをセット
   void setPixel(unsigned int i, unsigned int j, const SPD& spd) {
     assert(i < width);
     assert(j < height);
-    pixels[i + width * j] = spd;
+    if (type == FilmType::CIEXYZ) {
+      xyz_pixels[i + width * j] = spd.toXYZ();
+    } else {
+      pixels[i + width * j] = spd;
+    }
   }
   //物理的位置にSPDをセット
   void setPixel(const Vec2& v, const SPD& spd) {
     unsigned int i, j;
     computeIndex(v, i, j);
-    assert(i < width);
-    assert(j < height);
-    pixels[i + width * j] = spd;
+    setPixel(i, j, spd);
   }
 
   //(i, j)にSPDを加算
   void addPixel(unsigned int i, unsigned int j, const SPD& spd) {
     assert(i < width);
     assert(j < height);
-    pixels[i + width * j] += spd;
+    if (type == FilmType::CIEXYZ) {
+      xyz_pixels[i + width * j] += spd.toXYZ();
+    } else {
+      pixels[i + width * j] += spd;
+    }
   }
   //物理的位置にSPDを加算
   void addPixel(const Vec2& v, const SPD& spd) {
     unsigned int i, j;
     computeIndex(v, i, j);
-    assert(i < width);
-    assert(j < height);
-    pixels[i + width * j] += spd;
+    addPixel(i, j, spd);
   }
 
   //(i, j)に分光放射束を加算
+  // XYZの場合は等色関数で重み付けしてから加算する
   void addPixel(unsigned int i, unsigned int j, const Real& _lambda,
                 const Real& _phi) {
     assert(i < width);
     assert(j < height);
-    pixels[i + width * j].addPhi(_lambda, _phi);
+    if (type == FilmType::CIEXYZ) {
+      xyz_pixels[i + width * j] += SPD::toXYZ(_lambda, _phi);
+    } else {
+      pixels[i + width * j].addPhi(_lambda, _phi);
+    }
   }
   //物理的位置に分光放射束を加算
   void addPixel(const Vec2& v, const Real& _lambda, const Real& _phi) {
     unsigned int i, j;
     computeIndex(v, i, j);
-    assert(i < width);
-    assert(j < height);
-    pixels[i + width * j].addPhi(_lambda, _phi);
+    addPixel(i, j, _lambda, _phi);
   }
 
   //(u, v)の物理的な位置を計算
@@ -107,7 +142,11 @@ class Film {
   void divide(unsigned int i, unsigned int j, const Real& k) {
     assert(i < width);
     assert(j < height);
-    pixels[i + width * j] /= k;
+    if (type == FilmType::CIEXYZ) {
+      xyz_pixels[i + width * j] /= k;
+    } else {
+      pixels[i + width * j] /= k;
+    }
   }
   // フィルム全体をある値で割る
   void divide(const Real& k) {
@@ -122,21 +161,32 @@ class Film {
   void clear() {
     for (unsigned int j = 0; j < height; ++j) {
       for (unsigned int i = 0; i < width; ++i) {
-        pixels[i + width * j].clear();
+        clearPixel(i, j);
       }
     }
   }
 
   // 指定したピクセルをクリア
   void clearPixel(unsigned int i, unsigned int j) {
-    pixels[i + width * j].clear();
+    if (type == FilmType::CIEXYZ) {
+      xyz_pixels[i + width * j] = XYZ();
+    } else {
+      pixels[i + width * j].clear();
+    }
   }
 
   // フィルムをリサイズ
+  // 使わない方の画素は確保しない
   void resize(unsigned int _width, unsigned int _height) {
     width = _width;
     height = _height;
-    pixels.resize(_width * _height);
+    if (type == FilmType::CIEXYZ) {
+      xyz_pixels.resize(_width * _height);
+      std::vector<SPD>().swap(pixels);
+    } else {
+      pixels.resize(_width * _height);
+      std::vector<XYZ>().swap(xyz_pixels);
+    }
   }
 
   // フィルムの物理的長さをリサイズ
@@ -1,8 +1,10 @@
 #ifndef PRL2_BOUNDS3_H
 #define PRL2_BOUNDS3_H
 
+#include <algorithm>
 #include <iostream>
 
+#include "core/ray.h"
 #include "core/vec3.h"
 
 namespace Prl2 {
@@ -22,8 +24,84 @@ class Bounds3 {
     p1[1] = std::max(_p1.y(), _p2.y());
     p1[2] = std::max(_p1.z(), _p2.z());
   }
+
+  // 中心を返す
+  Vec3 center() const { return 0.5f * (p0 + p1); }
+
+  // 表面積を返す
+  Real surfaceArea() const {
+    const Vec3 d = p1 - p0;
+    return 2 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+  }
+
+  // 最も長い軸を返す
+  int maxExtent() const {
+    const Vec3 d = p1 - p0;
+    if (d.x() > d.y() && d.x() > d.z()) {
+      return 0;
+    } else if (d.y() > d.z()) {
+      return 1;
+    } else {
+      return 2;
+    }
+  }
+
+  // 点のBounds3内での相対位置を返す(p0で0, p1で1)
+  Vec3 offset(const Vec3& p) const {
+    Vec3 o = p - p0;
+    for (int i = 0; i < 3; ++i) {
+      if (p1[i] > p0[i]) {
+        o[i] /= p1[i] - p0[i];
+      }
+    }
+    return o;
+  }
+
+  // レイとの衝突判定を行う(Slab法)
+  // dirInv: レイの方向の逆数, dirIsNeg: レイの方向が負かどうか
+  bool intersect(const Ray& ray, const Vec3& dirInv, const int dirIsNeg[3],
+                 const Real& tmax) const {
+    const Bounds3& b = *this;
+    Real t0 = (b[dirIsNeg[0]].x() - ray.origin.x()) * dirInv.x();
+    Real t1 = (b[1 - dirIsNeg[0]].x() - ray.origin.x()) * dirInv.x();
+    const Real ty0 = (b[dirIsNeg[1]].y() - ray.origin.y()) * dirInv.y();
+    const Real ty1 = (b[1 - dirIsNeg[1]].y() - ray.origin.y()) * dirInv.y();
+    if (t0 > ty1 || ty0 > t1) return false;
+    t0 = std::max(t0, ty0);
+    t1 = std::min(t1, ty1);
+
+    const Real tz0 = (b[dirIsNeg[2]].z() - ray.origin.z()) * dirInv.z();
+    const Real tz1 = (b[1 - dirIsNeg[2]].z() - ray.origin.z()) * dirInv.z();
+    if (t0 > tz1 || tz0 > t1) return false;
+    t0 = std::max(t0, tz0);
+    t1 = std::min(t1, tz1);
+
+    return t0 < tmax && t1 > ray.tmin;
+  }
+
+  const Vec3& operator[](int i) const { return i == 0 ? p0 : p1; }
 };
 
+// 2つのBounds3を含むBounds3を返す
+inline Bounds3 mergeBounds(const Bounds3& b1, const Bounds3& b2) {
+  Bounds3 ret;
+  for (int i = 0; i < 3; ++i) {
+    ret.p0[i] = std::min(b1.p0[i], b2.p0[i]);
+    ret.p1[i] = std::max(b1.p1[i], b2.p1[i]);
+  }
+  return ret;
+}
+
+// Bounds3と点を含むBounds3を返す
+inline Bounds3 mergeBounds(const Bounds3& b, const Vec3& p) {
+  Bounds3 ret;
+  for (int i = 0; i < 3; ++i) {
+    ret.p0[i] = std::min(b.p0[i], p[i]);
+    ret.p1[i] = std::max(b.p1[i], p[i]);
+  }
+  return ret;
+}
+
 inline std::ostream& operator<<(std::ostream& stream, const Bounds3& bounds) {
   stream << "p0: " << bounds.p0 << ", p1: " << bounds.p1;
   return stream;
@@ -0,0 +1,72 @@
+#ifndef _PRL2_DIRECTION_CONE_H
+#define _PRL2_DIRECTION_CONE_H
+
+#include <algorithm>
+#include <cmath>
+
+#include "core/constant.h"
+#include "core/type.h"
+#include "core/vec3.h"
+
+namespace Prl2 {
+
+// 方向の集合を囲む円錐
+// 中心軸wとwからの角度θの余弦で表す(cos_theta = -1なら全ての方向)
+struct DirectionCone {
+  Vec3 w;          // 中心軸(正規化済み)
+  Real cos_theta;  // 中心軸からの角度の余弦
+
+  DirectionCone() : w(Vec3(0, 0, 1)), cos_theta(-1) {}
+  DirectionCone(const Vec3& _w, const Real& _cos_theta)
+      : w(_w), cos_theta(_cos_theta) {}
+
+  // 1つの方向だけを持つ円錐
+  explicit DirectionCone(const Vec3& _w) : w(_w), cos_theta(1) {}
+
+  // 全ての方向を持つ円錐
+  static DirectionCone entireSphere() { return DirectionCone(); }
+
+  bool isEntireSphere() const { return cos_theta <= -1; }
+};
+
+// 2つの円錐を両方とも含む円錐を返す
+// 最小の円錐ではないが、必ず両方を含む
+inline DirectionCone mergeCones(const DirectionCone& a,
+                                const DirectionCone& b) {
+  if (a.isEntireSphere() || b.isEntireSphere()) {
+    return DirectionCone::entireSphere();
+  }
+
+  const Real theta_a = std::acos(std::clamp(a.cos_theta, Real(-1), Real(1)));
+  const Real theta_b = std::acos(std::clamp(b.cos_theta, Real(-1), Real(1)));
+  const Real theta_d = std::acos(std::clamp(dot(a.w, b.w), Real(-1), Real(1)));
+
+  // 片方がもう片方を含む場合
+  if (std::min(theta_d + theta_b, PI) <= theta_a) {
+    return a;
+  }
+  if (std::min(theta_d + theta_a, PI) <= theta_b) {
+    return b;
+  }
+
+  // 両方の端を通る円錐
+  const Real theta_o = 0.5f * (theta_a + theta_d + theta_b);
+  if (theta_o >= PI) {
+    return DirectionCone::entireSphere();
+  }
+
+  // a.wをa.wとb.wを含む平面内でtheta_o - theta_aだけb.wの方へ回す
+  const Vec3 axis = cross(a.w, b.w);
+  if (length2(axis) == 0) {
+    return DirectionCone::entireSphere();
+  }
+  const Vec3 k = normalize(axis);
+  const Real theta_r = theta_o - theta_a;
+  const Vec3 w = a.w * std::cos(theta_r) + cross(k, a.w) * std::sin(theta_r);
+
+  return DirectionCone(normalize(w), std::cos(theta_o));
+}
+
+}  // namespace Prl2
+
+#endif
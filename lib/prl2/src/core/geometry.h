@@ -1,6 +1,7 @@
 #ifndef PRL2_GEOMETRY_H
 #define PRL2_GEOMETRY_H
 
+#include <cmath>
 #include <memory>
 
 #include "core/bounds3.h"
@@ -35,31 +36,111 @@ class Geometry {
     }
   };
 
-  // ワールド座標系のレイを受け取り、衝突判定を行う
-  bool occluded(const Ray& ray) const {
+  // ワールド座標系のレイを受け取り、tmaxまでの衝突判定を行う
+  // 方向ベクトルは正規化せずに変換するので、衝突距離はローカル座標系でも変わらない
+  bool occluded(const Ray& ray, const Real& tmax) const {
     //レイをローカル座標系に変換
     const Ray ray_local = localToWorld->applyInverse(ray);
 
-    return shape->occluded(ray_local);
+    return shape->occluded(ray_local, tmax);
   }
 
+  // ワールド座標系のレイを受け取り、face番目の面との衝突計算を行う
+  bool intersectFace(unsigned int face, const Ray& ray,
+                     IntersectInfo& info) const {
+    const Ray ray_local = localToWorld->applyInverse(ray);
+
+    IntersectInfo info_local;
+    if (shape->intersectFace(face, ray_local, info_local)) {
+      info = localToWorld->apply(info_local);
+      return true;
+    } else {
+      return false;
+    }
+  };
+
+  // ワールド座標系のレイを受け取り、face番目の面とのtmaxまでの衝突判定を行う
+  bool occludedFace(unsigned int face, const Ray& ray, const Real& tmax) const {
+    const Ray ray_local = localToWorld->applyInverse(ray);
+
+    return shape->occludedFace(face, ray_local, tmax);
+  };
+
   // Geometry上の点をサンプリングする
+  // pdf_areaはワールド座標系の面積に関するpdf
   void samplePoint(Sampler& sampler, Vec3& p, Vec3& n, Real& pdf_area) const {
     // ローカル座標系でサンプリング
     Vec3 p_local, n_local;
     shape->samplePoint(sampler, p_local, n_local, pdf_area);
 
     // ワールド座標系に変換
-    p = localToWorld->applyPoint(p_local);
-    n = localToWorld->applyNormal(n_local);
+    toWorld(p_local, n_local, p, n, pdf_area);
+  };
+
+  // face番目の面上の点をサンプリングする
+  // pdf_areaはワールド座標系の面積に関するpdf
+  void sampleFace(unsigned int face, Sampler& sampler, Vec3& p, Vec3& n,
+                  Real& pdf_area) const {
+    Vec3 p_local, n_local;
+    shape->sampleFace(face, sampler, p_local, n_local, pdf_area);
+
+    toWorld(p_local, n_local, p, n, pdf_area);
+  };
+
+  // ワールド座標系での表面積の目安を返す
+  // 回転、平行移動、一様なスケールに対しては正確で、
+  // 一様でないスケールに対しては体積の拡大率から求めた近似になる
+  Real getArea() const {
+    const Real det = std::abs(localToWorld->getDeterminant());
+    return shape->getArea() * std::pow(det, Real(2) / 3);
+  };
+
+  // face番目の面のワールド座標系での表面積の目安を返す
+  Real getFaceArea(unsigned int face) const {
+    const Real det = std::abs(localToWorld->getDeterminant());
+    return shape->getFaceArea(face) * std::pow(det, Real(2) / 3);
+  };
+
+  // face番目の面のワールド座標系の法線を全て含む円錐を返す
+  // 角度を保たない変換では円錐の広がりが変わるので、1方向の場合以外は全方向にする
+  DirectionCone getFaceNormalCone(unsigned int face) const {
+    const DirectionCone cone = shape->getFaceNormalCone(face);
+    if (cone.isEntireSphere() ||
+        (cone.cos_theta < 1 && !localToWorld->preservesAngles())) {
+      return DirectionCone::entireSphere();
+    }
+    return DirectionCone(normalize(localToWorld->applyNormal(cone.w)),
+                         cone.cos_theta);
   };
 
   const std::shared_ptr<Shape>& getShape() const { return shape; };
+  const std::shared_ptr<Transform>& getTransform() const {
+    return localToWorld;
+  };
 
   // ワールド座標系のバウンディングボックスを計算する
   Bounds3 getBounds() const { return localToWorld->apply(shape->getBounds()); };
 
+  // face番目の面のワールド座標系のバウンディングボックスを計算する
+  Bounds3 getFaceBounds(unsigned int face) const {
+    return localToWorld->apply(shape->getFaceBounds(face));
+  };
+
+  // 面の数を返す
+  unsigned int getNumFaces() const { return shape->getNumFaces(); };
+
  private:
+  // ローカル座標系でサンプリングした点をワールド座標系に変換する
+  // 面積要素は|det M| * |M^{-T} n|倍になるので、pdfをその分小さくする
+  void toWorld(const Vec3& p_local, const Vec3& n_local, Vec3& p, Vec3& n,
+               Real& pdf_area) const {
+    p = localToWorld->applyPoint(p_local);
+    const Vec3 n_world = localToWorld->applyNormal(n_local);
+    const Real n_length = length(n_world);
+    n = n_world / n_length;
+    pdf_area /= std::abs(localToWorld->getDeterminant()) * n_length;
+  };
+
   const std::shared_ptr<Shape> shape;  // Shape
   const std::shared_ptr<Transform>
       localToWorld;  // ローカル座標系からワールド座標系へのTransform
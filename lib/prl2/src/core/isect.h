@@ -20,13 +20,15 @@ struct IntersectInfo {
   Vec3 hitNormal;                 // 法線
   Vec2 uv;                        // UV座標
   const Primitive* hitPrimitive;  // 衝突Primitiveへのポインタ
+  unsigned int faceID;            // 衝突した面のインデックス(メッシュ以外は0)
 
   IntersectInfo()
       : t(std::numeric_limits<Real>::max()),
         hitPos(Vec3()),
         hitNormal(Vec3()),
         uv(Vec2()),
-        hitPrimitive(nullptr) {}
+        hitPrimitive(nullptr),
+        faceID(0) {}
 };
 
 inline std::ostream& operator<<(std::ostream& stream,
@@ -35,6 +37,7 @@ inline std::ostream& operator<<(std::ostream& stream,
   stream << "hitPos: " << info.hitPos << std::endl;
   stream << "hitNormal: " << info.hitNormal << std::endl;
   stream << "uv: " << info.uv << std::endl;
+  stream << "faceID: " << info.faceID << std::endl;
   return stream;
 }
 
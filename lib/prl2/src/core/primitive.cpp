@@ -17,9 +17,15 @@ bool Primitive::intersect(const Ray& ray, IntersectInfo& info) const {
   }
 }
 
-bool Primitive::occluded(const Ray& ray, IntersectInfo& info) const {
-  if (geometry->occluded(ray)) {
-    // 衝突Primitiveをセット
+bool Primitive::occluded(const Ray& ray, const Real& tmax) const {
+  return geometry->occluded(ray, tmax);
+}
+
+Bounds3 Primitive::getBounds() const { return geometry->getBounds(); }
+
+bool Primitive::intersectFace(unsigned int face, const Ray& ray,
+                              IntersectInfo& info) const {
+  if (geometry->intersectFace(face, ray, info)) {
     info.hitPrimitive = this;
     return true;
   } else {
@@ -27,10 +33,21 @@ bool Primitive::occluded(const Ray& ray, IntersectInfo& info) const {
   }
 }
 
-Bounds3 Primitive::getBounds() const { return geometry->getBounds(); }
+bool Primitive::occludedFace(unsigned int face, const Ray& ray,
+                             const Real& tmax) const {
+  return geometry->occludedFace(face, ray, tmax);
+}
+
+Bounds3 Primitive::getFaceBounds(unsigned int face) const {
+  return geometry->getFaceBounds(face);
+}
+
+unsigned int Primitive::getNumFaces() const { return geometry->getNumFaces(); }
 
 bool Primitive::isLight() const { return light != nullptr; }
 
+bool Primitive::isDelta() const { return material->isDelta(); }
+
 const std::shared_ptr<Geometry>& Primitive::getGeometry() const {
   return geometry;
 }
@@ -45,34 +62,57 @@ unsigned int Primitive::getID() const { return id; }
 
 void Primitive::setID(unsigned int _id) { id = _id; }
 
-Real Primitive::sampleBRDF(const Vec3& wo, const Vec3& n, Real lambda,
-                           Sampler& sampler, Vec3& wi, Real& cos,
-                           Real& pdf) const {
-  Vec3 s, t;
-  orthonormalBasis(n, s, t);
+void Primitive::getMaterialFrame(const Vec3& wo, const Vec3& n, Vec3& s,
+                                 Vec3& ns, Vec3& t) const {
+  ns = !material->isTransmissive() && dot(wo, n) < 0 ? -n : n;
+  orthonormalBasis(ns, s, t);
+}
+
+SampledSpectrum Primitive::sampleBRDF(const Vec3& wo, const Vec3& n,
+                                      SampledWavelengths& lambda,
+                                      Sampler& sampler, Vec3& wi, Real& cos,
+                                      Real& pdf) const {
+  Vec3 s, ns, t;
+  getMaterialFrame(wo, n, s, ns, t);
 
   MaterialArgs args;
   args.lambda = lambda;
-  args.wo_local = worldToMaterial(wo, s, n, t);
+  args.wo_local = worldToMaterial(wo, s, ns, t);
 
-  const Real brdf = material->sampleDirection(args, sampler, pdf);
+  const SampledSpectrum brdf = material->sampleDirection(args, sampler, pdf);
   cos = absCosTheta(args.wi_local);
-  wi = materialToWorld(args.wi_local, s, n, t);
+  wi = materialToWorld(args.wi_local, s, ns, t);
+  lambda = args.lambda;
 
   return brdf;
 }
 
-Real Primitive::BRDF(const Vec3& wo, const Vec3& n, Real lambda,
-                     const Vec3& wi) const {
-  Vec3 s, t;
-  orthonormalBasis(n, s, t);
+SampledSpectrum Primitive::BRDF(const Vec3& wo, const Vec3& n,
+                                const SampledWavelengths& lambda,
+                                const Vec3& wi) const {
+  Vec3 s, ns, t;
+  getMaterialFrame(wo, n, s, ns, t);
 
   MaterialArgs args;
   args.lambda = lambda;
-  args.wo_local = worldToMaterial(wo, s, n, t);
-  args.wi_local = worldToMaterial(wi, s, n, t);
+  args.wo_local = worldToMaterial(wo, s, ns, t);
+  args.wi_local = worldToMaterial(wi, s, ns, t);
 
   return material->BRDF(args);
 }
 
+Real Primitive::BRDFPdf(const Vec3& wo, const Vec3& n,
+                        const SampledWavelengths& lambda,
+                        const Vec3& wi) const {
+  Vec3 s, ns, t;
+  getMaterialFrame(wo, n, s, ns, t);
+
+  MaterialArgs args;
+  args.lambda = lambda;
+  args.wo_local = worldToMaterial(wo, s, ns, t);
+  args.wi_local = worldToMaterial(wi, s, ns, t);
+
+  return material->getPdf(args);
+}
+
 }  // namespace Prl2
\ No newline at end of file
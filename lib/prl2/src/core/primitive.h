@@ -21,22 +21,51 @@ class Primitive {
   // ワールド座標系のレイを受け取り、Geometryとの衝突計算を行う。結果をinfoに保存する。
   bool intersect(const Ray& ray, IntersectInfo& info) const;
 
-  // ワールド座標系のレイを受け取り、Geometryとの衝突判定を行う
-  // 衝突Primitiveのみがセットされる
-  bool occluded(const Ray& ray, IntersectInfo& info) const;
+  // ワールド座標系のレイを受け取り、tmaxまでのGeometryとの衝突判定を行う
+  bool occluded(const Ray& ray, const Real& tmax) const;
 
   // ワールド座標系のバウンディングボックスを取得する
   Bounds3 getBounds() const;
 
+  // face番目の面との衝突計算を行う
+  // メッシュ全体を1つのPrimitiveとする場合に、面ごとにBVHに入れるために使う
+  bool intersectFace(unsigned int face, const Ray& ray,
+                     IntersectInfo& info) const;
+
+  // face番目の面とのtmaxまでの衝突判定を行う
+  bool occludedFace(unsigned int face, const Ray& ray, const Real& tmax) const;
+
+  // face番目の面のワールド座標系のバウンディングボックスを取得する
+  Bounds3 getFaceBounds(unsigned int face) const;
+
+  // 面の数を取得する
+  unsigned int getNumFaces() const;
+
   // 光源かどうか
   bool isLight() const;
 
+  // MaterialのBRDFがデルタ関数で表されるか
+  bool isDelta() const;
+
   // BRDFから方向をサンプリングする
-  Real sampleBRDF(const Vec3& wo, const Vec3& n, Real lambda, Sampler& sampler,
-                  Vec3& wi, Real& cos, Real& pdf) const;
+  // Materialが波長を打ち切った場合はlambdaに反映される
+  SampledSpectrum sampleBRDF(const Vec3& wo, const Vec3& n,
+                             SampledWavelengths& lambda, Sampler& sampler,
+                             Vec3& wi, Real& cos, Real& pdf) const;
 
   // BRDFを計算する
-  Real BRDF(const Vec3& wo, const Vec3& n, Real lambda, const Vec3& wi) const;
+  SampledSpectrum BRDF(const Vec3& wo, const Vec3& n,
+                       const SampledWavelengths& lambda, const Vec3& wi) const;
+
+  // sampleBRDFでwiがサンプリングされる確率密度を計算する
+  Real BRDFPdf(const Vec3& wo, const Vec3& n, const SampledWavelengths& lambda,
+               const Vec3& wi) const;
+
+  // 法線nの点のマテリアル座標系の基底(s, ns, t)を計算する
+  // 屈折しないマテリアルでは裏側から当たった場合に法線を反転し、
+  // sampleBRDF, BRDF, BRDFPdfが常にwo側の同じ半球を使うようにする
+  void getMaterialFrame(const Vec3& wo, const Vec3& n, Vec3& s, Vec3& ns,
+                        Vec3& t) const;
 
   const std::shared_ptr<Geometry>& getGeometry() const;
   const std::shared_ptr<Material>& getMaterial() const;
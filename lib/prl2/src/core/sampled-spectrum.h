@@ -0,0 +1,200 @@
+#ifndef _PRL2_SAMPLED_SPECTRUM_H
+#define _PRL2_SAMPLED_SPECTRUM_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "core/spectrum.h"
+#include "core/type.h"
+
+namespace Prl2 {
+
+// 1本のパスで運ぶ波長の数
+// SIMDの幅に合わせて4か8にする
+#ifndef PRL2_WAVELENGTH_SAMPLES
+#define PRL2_WAVELENGTH_SAMPLES 4
+#endif
+constexpr unsigned int WAVELENGTH_SAMPLES = PRL2_WAVELENGTH_SAMPLES;
+
+// パスが運ぶ波長ごとの値(分光放射輝度、分光反射率、Throughputなど)を表す
+// 要素ごとの演算はコンパイラの自動ベクトル化でSIMD命令になる
+class alignas(4 * WAVELENGTH_SAMPLES) SampledSpectrum {
+ public:
+  // 0で初期化
+  SampledSpectrum() {
+    for (unsigned int k = 0; k < WAVELENGTH_SAMPLES; ++k) {
+      v[k] = 0;
+    }
+  }
+
+  // ある値で初期化
+  explicit SampledSpectrum(const Real& c) {
+    for (unsigned int k = 0; k < WAVELENGTH_SAMPLES; ++k) {
+      v[k] = c;
+    }
+  }
+
+  Real operator[](unsigned int k) const {
+    assert(k < WAVELENGTH_SAMPLES);
+    return v[k];
+  }
+  Real& operator[](unsigned int k) {
+    assert(k < WAVELENGTH_SAMPLES);
+    return v[k];
+  }
+
+  // 全ての要素が0か返す
+  bool isBlack() const {
+    for (unsigned int k = 0; k < WAVELENGTH_SAMPLES; ++k) {
+      if (v[k] != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // NaNを含むか返す
+  bool hasNaN() const {
+    for (unsigned int k = 0; k < WAVELENGTH_SAMPLES; ++k) {
+      if (std::isnan(v[k])) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  //演算
+  SampledSpectrum& operator+=(const SampledSpectrum& s) {
+    for (unsigned int k = 0; k < WAVELENGTH_SAMPLES; ++k) {
+      v[k] += s.v[k];
+    }
+    return *this;
+  }
+  SampledSpectrum& operator-=(const SampledSpectrum& s) {
+    for (unsigned int k = 0; k < WAVELENGTH_SAMPLES; ++k) {
+      v[k] -= s.v[k];
+    }
+    return *this;
+  }
+  SampledSpectrum& operator*=(const SampledSpectrum& s) {
+    for (unsigned int k = 0; k < WAVELENGTH_SAMPLES; ++k) {
+      v[k] *= s.v[k];
+    }
+    return *this;
+  }
+  SampledSpectrum& operator*=(const Real& c) {
+    for (unsigned int k = 0; k < WAVELENGTH_SAMPLES; ++k) {
+      v[k] *= c;
+    }
+    return *this;
+  }
+  SampledSpectrum& operator/=(const SampledSpectrum& s) {
+    for (unsigned int k = 0; k < WAVELENGTH_SAMPLES; ++k) {
+      v[k] /= s.v[k];
+    }
+    return *this;
+  }
+  SampledSpectrum& operator/=(const Real& c) {
+    for (unsigned int k = 0; k < WAVELENGTH_SAMPLES; ++k) {
+      v[k] /= c;
+    }
+    return *this;
+  }
+
+ private:
+  Real v[WAVELENGTH_SAMPLES];
+};
+
+inline SampledSpectrum operator+(SampledSpectrum s1,
+                                 const SampledSpectrum& s2) {
+  return s1 += s2;
+}
+inline SampledSpectrum operator-(SampledSpectrum s1,
+                                 const SampledSpectrum& s2) {
+  return s1 -= s2;
+}
+inline SampledSpectrum operator*(SampledSpectrum s1,
+                                 const SampledSpectrum& s2) {
+  return s1 *= s2;
+}
+inline SampledSpectrum operator*(SampledSpectrum s, const Real& c) {
+  return s *= c;
+}
+inline SampledSpectrum operator*(const Real& c, SampledSpectrum s) {
+  return s *= c;
+}
+inline SampledSpectrum operator/(SampledSpectrum s1,
+                                 const SampledSpectrum& s2) {
+  return s1 /= s2;
+}
+inline SampledSpectrum operator/(SampledSpectrum s, const Real& c) {
+  return s /= c;
+}
+
+// 0割りになる要素は0にして割り算する
+inline SampledSpectrum safeDivide(const SampledSpectrum& s1,
+                                  const SampledSpectrum& s2) {
+  SampledSpectrum ret;
+  for (unsigned int k = 0; k < WAVELENGTH_SAMPLES; ++k) {
+    ret[k] = s2[k] != 0 ? s1[k] / s2[k] : 0;
+  }
+  return ret;
+}
+
+// パスが運ぶ波長とそのpdfを表す
+// 先頭の波長(Hero Wavelength)を一様にサンプリングし、
+// 残りの波長は波長域を等間隔にずらして層別化する
+struct SampledWavelengths {
+  SampledSpectrum lambda;  // 波長[nm]
+  SampledSpectrum pdf;     // 波長のpdf
+
+  Real operator[](unsigned int k) const { return lambda[k]; }
+
+  // Hero Wavelengthを返す
+  Real hero() const { return lambda[0]; }
+
+  // 乱数から波長を一様にサンプリングする
+  static SampledWavelengths sampleUniform(const Real& u) {
+    constexpr Real range = SPD::LAMBDA_MAX - SPD::LAMBDA_MIN;
+
+    SampledWavelengths ret;
+    ret.lambda[0] = SPD::LAMBDA_MIN + u * range;
+    for (unsigned int k = 1; k < WAVELENGTH_SAMPLES; ++k) {
+      Real l = ret.lambda[0] + k * range / WAVELENGTH_SAMPLES;
+      if (l >= SPD::LAMBDA_MAX) {
+        l -= range;
+      }
+      ret.lambda[k] = l;
+    }
+    ret.pdf = SampledSpectrum(1 / range);
+    return ret;
+  }
+
+  // Hero Wavelength以外の波長を打ち切る
+  // 屈折率が波長に依存する場合など、波長ごとに経路が分かれる場合に使う
+  // Hero Wavelengthだけで全体の寄与を推定するのでpdfを波長数で割る
+  void terminateSecondary() {
+    if (isSecondaryTerminated()) {
+      return;
+    }
+    for (unsigned int k = 1; k < WAVELENGTH_SAMPLES; ++k) {
+      pdf[k] = 0;
+    }
+    pdf[0] /= WAVELENGTH_SAMPLES;
+  }
+
+  // Hero Wavelength以外の波長が打ち切られているか返す
+  bool isSecondaryTerminated() const {
+    for (unsigned int k = 1; k < WAVELENGTH_SAMPLES; ++k) {
+      if (pdf[k] != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+}  // namespace Prl2
+
+#endif
@@ -3,6 +3,7 @@
 #include <fstream>
 #include <iostream>
 
+#include "core/sampled-spectrum.h"
 #include "core/spectrum.h"
 
 namespace Prl2 {
@@ -88,112 +89,155 @@ Real SPD::sample(const Real& l) const {
   }
 }
 
+SampledSpectrum SPD::sample(const SampledWavelengths& lambda) const {
+  SampledSpectrum ret;
+  for (unsigned int k = 0; k < WAVELENGTH_SAMPLES; ++k) {
+    ret[k] = sample(lambda[k]);
+  }
+  return ret;
+}
+
 //等色関数は線形補間して使用する
+XYZ SPD::colorMatchingFunction(std::size_t i) {
+  const Real lambda_value = LAMBDA_MIN + LAMBDA_INTERVAL * i;
+
+  //対応する等色関数のインデックスを計算
+  const int index = (lambda_value - 380) / 5;
+  assert(index >= 0 && index < color_matching_func_samples);
+
+  //等色関数を線形補間
+  if (index != color_matching_func_samples - 1) {
+    const Real cmf_lambda = 5 * index + 380;
+    const Real t = (lambda_value - cmf_lambda) / 5;
+    assert(t >= 0 && t <= 1);
+
+    return XYZ((1.0f - t) * color_matching_func_x[index] +
+                   t * color_matching_func_x[index + 1],
+               (1.0f - t) * color_matching_func_y[index] +
+                   t * color_matching_func_y[index + 1],
+               (1.0f - t) * color_matching_func_z[index] +
+                   t * color_matching_func_z[index + 1]);
+  } else {
+    return XYZ(color_matching_func_x[index], color_matching_func_y[index],
+               color_matching_func_z[index]);
+  }
+}
+
 XYZ SPD::toXYZ() const {
   XYZ xyz;
 
   for (std::size_t i = 0; i < LAMBDA_SAMPLES; ++i) {
-    const Real lambda_value = LAMBDA_MIN + LAMBDA_INTERVAL * i;
     const Real phi_value = phi[i];
 
     //放射束が0の場合は計算をスキップ
     if (phi_value == 0) continue;
 
-    //対応する等色関数のインデックスを計算
-    const int index = (lambda_value - 380) / 5;
-    assert(index >= 0 && index < color_matching_func_samples);
-
-    //等色関数を線形補間
-    Real cmf_x, cmf_y, cmf_z;
-    if (index != color_matching_func_samples - 1) {
-      const Real cmf_lambda = 5 * index + 380;
-      const Real t = (lambda_value - cmf_lambda) / 5;
-      assert(t >= 0 && t <= 1);
-
-      cmf_x = (1.0f - t) * color_matching_func_x[index] +
-              t * color_matching_func_x[index + 1];
-      cmf_y = (1.0f - t) * color_matching_func_y[index] +
-              t * color_matching_func_y[index + 1];
-      cmf_z = (1.0f - t) * color_matching_func_z[index] +
-              t * color_matching_func_z[index + 1];
-    } else {
-      cmf_x = color_matching_func_x[index];
-      cmf_y = color_matching_func_y[index];
-      cmf_z = color_matching_func_z[index];
-    }
-
     // XYZを計算(短冊近似)
-    xyz[0] += cmf_x * phi_value;
-    xyz[1] += cmf_y * phi_value;
-    xyz[2] += cmf_z * phi_value;
+    xyz += phi_value * colorMatchingFunction(i);
   }
 
   return xyz;
 }
 
-SPD RGB2Spectrum(const RGB& rgb) {
-  static const std::vector<Real> sampled_lambda = {
-      380, 417.7, 455.55, 493.33, 531.11, 568.88, 606.66, 644.44, 682.22, 720};
+// addPhiと同じように両側の波長に寄与を分配し、それぞれの等色関数で重み付けする
+XYZ SPD::toXYZ(const Real& _lambda, const Real& _phi) {
+  //範囲外の寄与は加算しない
+  if (_lambda < LAMBDA_MIN || _lambda >= LAMBDA_MAX) {
+    return XYZ();
+  }
 
-  static const SPD white_spectrum =
-      SPD(sampled_lambda, {1, 1, 0.9999, 0.9993, 0.9992, 0.9998, 1, 1, 1, 1});
+  //対応する波長のインデックスを計算
+  const size_t lambda_index = (_lambda - LAMBDA_MIN) / LAMBDA_INTERVAL;
 
-  static const SPD cyan_spectrum =
-      SPD(sampled_lambda,
-          {0.9710, 0.9426, 1.0007, 1.0007, 1.0007, 1.0007, 0.1564, 0, 0, 0});
+  //両側に寄与を分配する
+  const Real lambda0 = LAMBDA_MIN + lambda_index * LAMBDA_INTERVAL;
+  const Real t = (_lambda - lambda0) / LAMBDA_INTERVAL;
+  return (1.0f - t) * _phi * colorMatchingFunction(lambda_index) +
+         t * _phi * colorMatchingFunction(lambda_index + 1);
+}
 
-  static const SPD magenta_spectrum = SPD(
-      sampled_lambda, {1, 1, 0.9685, 0.2229, 0, 0.0458, 0.8369, 1, 1, 0.9959});
+const SPD& RGB2SpectrumBasis(unsigned int i) {
+  static const std::vector<Real> sampled_lambda = {
+      380, 417.7, 455.55, 493.33, 531.11, 568.88, 606.66, 644.44, 682.22, 720};
 
-  static const SPD yellow_spectrum =
+  static const SPD basis[RGB_SPECTRUM_BASIS_NUM] = {
+      // white
+      SPD(sampled_lambda, {1, 1, 0.9999, 0.9993, 0.9992, 0.9998, 1, 1, 1, 1}),
+      // cyan
       SPD(sampled_lambda,
-          {0.0001, 0, 0.1088, 0.6651, 1, 1, 0.9996, 0.9586, 0.9685, 0.9840});
-
-  static const SPD red_spectrum =
+          {0.9710, 0.9426, 1.0007, 1.0007, 1.0007, 1.0007, 0.1564, 0, 0, 0}),
+      // magenta
       SPD(sampled_lambda,
-          {0.1012, 0.0515, 0, 0, 0, 0, 0.8325, 1.0149, 1.0149, 1.0149});
-
-  static const SPD green_spectrum = SPD(
-      sampled_lambda, {0, 0, 0.0273, 0.7937, 1, 0.9418, 0.1719, 0, 0, 0.0025});
-
-  static const SPD blue_spectrum =
+          {1, 1, 0.9685, 0.2229, 0, 0.0458, 0.8369, 1, 1, 0.9959}),
+      // yellow
+      SPD(sampled_lambda,
+          {0.0001, 0, 0.1088, 0.6651, 1, 1, 0.9996, 0.9586, 0.9685, 0.9840}),
+      // red
       SPD(sampled_lambda,
-          {1, 1, 0.8916, 0.3323, 0, 0, 0.0003, 0.0369, 0.0483, 0.0496});
+          {0.1012, 0.0515, 0, 0, 0, 0, 0.8325, 1.0149, 1.0149, 1.0149}),
+      // green
+      SPD(sampled_lambda,
+          {0, 0, 0.0273, 0.7937, 1, 0.9418, 0.1719, 0, 0, 0.0025}),
+      // blue
+      SPD(sampled_lambda,
+          {1, 1, 0.8916, 0.3323, 0, 0, 0.0003, 0.0369, 0.0483, 0.0496})};
 
-  SPD ret;
+  return basis[i];
+}
+
+RGBSpectrumCoefficients RGB2SpectrumCoefficients(const RGB& rgb) {
+  RGBSpectrumCoefficients ret;
   const Real red = rgb.x();
   const Real green = rgb.y();
   const Real blue = rgb.z();
+
+  const auto set = [&](const Real& c0, const Real& c1, uint8_t b1,
+                       const Real& c2, uint8_t b2) {
+    ret.coeffs[0] = c0;
+    ret.coeffs[1] = c1;
+    ret.coeffs[2] = c2;
+    ret.basis[0] = RGB_SPECTRUM_WHITE;
+    ret.basis[1] = b1;
+    ret.basis[2] = b2;
+  };
+
   if (red <= green && red <= blue) {
-    ret += red * white_spectrum;
     if (green <= blue) {
-      ret += (green - red) * cyan_spectrum;
-      ret += (blue - green) * blue_spectrum;
+      set(red, green - red, RGB_SPECTRUM_CYAN, blue - green,
+          RGB_SPECTRUM_BLUE);
     } else {
-      ret += (blue - red) * cyan_spectrum;
-      ret += (green - blue) * green_spectrum;
+      set(red, blue - red, RGB_SPECTRUM_CYAN, green - blue,
+          RGB_SPECTRUM_GREEN);
     }
   } else if (green <= red && green <= blue) {
-    ret += green * white_spectrum;
     if (red <= blue) {
-      ret += (red - green) * magenta_spectrum;
-      ret += (blue - red) * blue_spectrum;
+      set(green, red - green, RGB_SPECTRUM_MAGENTA, blue - red,
+          RGB_SPECTRUM_BLUE);
     } else {
-      ret += (blue - green) * magenta_spectrum;
-      ret += (red - blue) * red_spectrum;
+      set(green, blue - green, RGB_SPECTRUM_MAGENTA, red - blue,
+          RGB_SPECTRUM_RED);
     }
   } else {
-    ret += blue * white_spectrum;
     if (red <= green) {
-      ret += (red - blue) * yellow_spectrum;
-      ret += (green - red) * green_spectrum;
+      set(blue, red - blue, RGB_SPECTRUM_YELLOW, green - red,
+          RGB_SPECTRUM_GREEN);
     } else {
-      ret += (green - blue) * yellow_spectrum;
-      ret += (red - green) * red_spectrum;
+      set(blue, green - blue, RGB_SPECTRUM_YELLOW, red - green,
+          RGB_SPECTRUM_RED);
     }
   }
 
   return ret;
 }
 
+SPD RGB2Spectrum(const RGB& rgb) {
+  const RGBSpectrumCoefficients c = RGB2SpectrumCoefficients(rgb);
+
+  SPD ret;
+  for (int k = 0; k < 3; ++k) {
+    ret += c.coeffs[k] * RGB2SpectrumBasis(c.basis[k]);
+  }
+  return ret;
+}
+
 }  // namespace Prl2
\ No newline at end of file
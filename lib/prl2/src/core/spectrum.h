@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <array>
+#include <cstdint>
 #include <iomanip>
 #include <iostream>
 #include <vector>
@@ -15,6 +16,9 @@ namespace Prl2 {
 using XYZ = Vec3;
 using RGB = Vec3;
 
+class SampledSpectrum;
+struct SampledWavelengths;
+
 // XYZをsRGB色空間に変換する
 // XYZ to sRGB(D65)
 // http://www.brucelindbloom.com/index.html?Eqn_RGB_XYZ_Matrix.html
@@ -93,9 +97,16 @@ class SPD {
   // l : 波長[nm]
   Real sample(const Real& l) const;
 
+  //パスが運ぶ全ての波長の放射束を線形補間して返す
+  SampledSpectrum sample(const SampledWavelengths& lambda) const;
+
   // XYZ色空間に変換する
   XYZ toXYZ() const;
 
+  // 分光放射束をXYZ色空間に変換する
+  // addPhiで加算してからtoXYZで変換した結果と一致する
+  static XYZ toXYZ(const Real& _lambda, const Real& _phi);
+
   // sRGB色空間に変換する
   // XYZ to sRGB(D65)
   // http://www.brucelindbloom.com/index.html?Eqn_RGB_XYZ_Matrix.html
@@ -156,6 +167,9 @@ class SPD {
   }
 
  private:
+  // i番目の波長における等色関数の値を返す
+  static XYZ colorMatchingFunction(std::size_t i);
+
   //等色関数(CIE1931)
   // http://cvrl.ucl.ac.uk/cmfs.htm
   static constexpr int color_matching_func_samples = 85;
@@ -336,6 +350,32 @@ inline std::ostream& operator<<(std::ostream& stream, const SPD& spd) {
 // An RGB to Spectrum Conversion for Reflectances, Smits(2001)
 SPD RGB2Spectrum(const RGB& rgb);
 
+// RGB2Spectrumの基底の番号
+enum RGBSpectrumBasis : uint8_t {
+  RGB_SPECTRUM_WHITE,
+  RGB_SPECTRUM_CYAN,
+  RGB_SPECTRUM_MAGENTA,
+  RGB_SPECTRUM_YELLOW,
+  RGB_SPECTRUM_RED,
+  RGB_SPECTRUM_GREEN,
+  RGB_SPECTRUM_BLUE,
+  RGB_SPECTRUM_BASIS_NUM
+};
+
+// RGB2Spectrumのi番目の基底のSPDを返す
+const SPD& RGB2SpectrumBasis(unsigned int i);
+
+// RGB2Spectrumの結果を3つの基底の線形結合で表したもの
+// RGB2Spectrum(rgb) = Σ coeffs[k] * RGB2SpectrumBasis(basis[k])
+// SPDを作らずに、必要な波長だけ基底をサンプリングして計算できる
+struct RGBSpectrumCoefficients {
+  Real coeffs[3];    // 係数
+  uint8_t basis[3];  // 基底の番号
+};
+
+// RGBをRGB2Spectrumの基底の係数に変換する
+RGBSpectrumCoefficients RGB2SpectrumCoefficients(const RGB& rgb);
+
 }  // namespace Prl2
 
 #endif
\ No newline at end of file
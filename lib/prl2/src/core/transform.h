@@ -32,6 +32,28 @@ class Transform {
     return *this;
   }
 
+  // 変換行列の左上3x3の行列式を返す
+  // 体積の拡大率を表す
+  Real getDeterminant() const {
+    const auto& m = mat.m;
+    return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+           m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+           m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+  }
+
+  // 角度を保つ変換(回転、平行移動、一様なスケール)か
+  bool preservesAngles() const {
+    const auto& m = mat.m;
+    const Vec3 c0(m[0][0], m[1][0], m[2][0]);
+    const Vec3 c1(m[0][1], m[1][1], m[2][1]);
+    const Vec3 c2(m[0][2], m[1][2], m[2][2]);
+    const Real s = length2(c0);
+    const Real eps = 1e-4f * s;
+    return std::abs(length2(c1) - s) <= eps &&
+           std::abs(length2(c2) - s) <= eps && std::abs(dot(c0, c1)) <= eps &&
+           std::abs(dot(c1, c2)) <= eps && std::abs(dot(c2, c0)) <= eps;
+  }
+
   // 方向ベクトルに対して変換を施す
   Vec3 applyDirection(const Vec3& v) const {
     Vec3 ret;
@@ -147,8 +169,17 @@ class Transform {
   }
 
   // Bounds3に対して変換を施す
+  // 回転しても全体を含むように8つの頂点を変換したものを囲む
   Bounds3 apply(const Bounds3& bounds) const {
-    return Bounds3(applyPoint(bounds.p0), applyPoint(bounds.p1));
+    const Vec3 c0 = applyPoint(bounds.p0);
+    Bounds3 ret(c0, c0);
+    for (int k = 1; k < 8; ++k) {
+      const Vec3 corner((k & 1) ? bounds.p1.x() : bounds.p0.x(),
+                        (k & 2) ? bounds.p1.y() : bounds.p0.y(),
+                        (k & 4) ? bounds.p1.z() : bounds.p0.z());
+      ret = mergeBounds(ret, applyPoint(corner));
+    }
+    return ret;
   }
 };
 
@@ -16,13 +16,14 @@ bool AO::integrate(unsigned int i, unsigned int j, const Scene& scene,
     return false;
   }
 
-  // 波長は550nmに固定
   // 波長のサンプリング
-  const Real lambda =
-      SPD::LAMBDA_MIN + sampler.getNext() * (SPD::LAMBDA_MAX - SPD::LAMBDA_MIN);
+  // 白色を全ての波長で平均して書き込む
+  const SampledWavelengths lambda =
+      SampledWavelengths::sampleUniform(sampler.getNext());
   result.lambda = lambda;
 
-  const Real white_phi = white.sample(lambda);
+  const SampledSpectrum white_phi =
+      white.sample(lambda) / static_cast<Real>(WAVELENGTH_SAMPLES);
 
   IntersectInfo info;
   if (scene.intersect(ray, info)) {
@@ -31,18 +32,18 @@ bool AO::integrate(unsigned int i, unsigned int j, const Scene& scene,
     Vec3 s, t;
     orthonormalBasis(info.hitNormal, s, t);
     const Vec3 wi = materialToWorld(wi_local, s, info.hitNormal, t);
-    Ray shadow_ray(info.hitPos, wi);
 
-    // Compute Hit Distance
-    IntersectInfo shadow_info;
-    Real hitDistance = ray.tmax;
-    if (scene.intersect(shadow_ray, shadow_info)) {
-      hitDistance = shadow_info.t;
-    }
+    // 衝突情報をAOVとして書き込む
+    result.first_hit = true;
+    result.first_info = info;
+    result.first_wi = wi;
+    Ray shadow_ray(info.hitPos, wi);
 
-    result.phi = hitDistance > 1 ? white_phi : 0;
+    // 距離1以内に遮蔽物があるか判定する
+    result.phi =
+        scene.occluded(shadow_ray, 1) ? SampledSpectrum(0) : white_phi;
   } else {
-    result.phi = 0;
+    result.phi = SampledSpectrum(0);
   }
 
   return true;
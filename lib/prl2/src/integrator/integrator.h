@@ -1,20 +1,81 @@
 #ifndef INTEGRATOR_H
 #define INTEGRATOR_H
 
+#include <array>
+
+#include "core/isect.h"
 #include "core/ray.h"
+#include "core/sampled-spectrum.h"
 #include "core/spectrum.h"
 #include "core/type.h"
+#include "material/material.h"
 #include "renderer/scene.h"
 #include "sampler/sampler.h"
 
 namespace Prl2 {
 
 struct IntegratorResult {
-  Real lambda;            // サンプリングされた波長
-  Real phi;               // 分光放射輝度
+  SampledWavelengths lambda;  // サンプリングされた波長
+  SampledSpectrum phi;  // 波長ごとの分光放射束(波長のpdfで割ったもの)
   std::vector<Ray> rays;  // Path
 
-  IntegratorResult() : lambda(0), phi(0){};
+  // 最初の衝突点の情報(AOV)
+  // Integratorが自身のPrimary Rayの衝突計算の結果を書き込むので、
+  // AOVのためにPrimary Rayを別に飛ばす必要がなく、Render Layerと同じサンプルになる
+  bool first_hit;            // Primary Rayが物体に当たったか
+  IntersectInfo first_info;  // 最初の衝突情報
+  Vec3 first_wi;             // 最初の衝突点でサンプリングされた方向
+
+  IntegratorResult() : first_hit(false){};
+
+  // 使い回すためにクリアする
+  // Pathの配列の容量は残しておく
+  void clear() {
+    lambda = SampledWavelengths();
+    phi = SampledSpectrum();
+    rays.clear();
+    first_hit = false;
+    first_wi = Vec3();
+  };
+};
+
+// まとめて計算する画素サンプル
+struct PixelSample {
+  unsigned int i;  // 画素のX座標
+  unsigned int j;  // 画素のY座標
+};
+
+// Wavefrontで追跡中のパスの状態とステージ間のキュー
+// ステージごとに同じ種類のデータだけを連続して読むように配列を分けて持つ
+// レンダリングスレッドごとに持ち、配列の容量を残したままWaveごとに使い回す
+struct WaveWorkspace {
+  std::vector<Ray> rays;                     // 次に追跡するレイ
+  std::vector<SampledWavelengths> lambdas;   // パスが運ぶ波長
+  std::vector<SampledSpectrum> throughputs;  // Throughput
+  std::vector<SampledSpectrum> radiances;    // 分光放射輝度
+  std::vector<Real> camera_weights;          // camera_cos / camera_pdf
+  std::vector<IntersectInfo> infos;          // 直前の衝突情報
+
+  std::vector<unsigned int> active;          // 追跡中のパスの番号
+  std::vector<Ray> extend_rays;              // まとめて衝突計算するレイ
+  std::vector<IntersectInfo> extend_infos;   // まとめて計算した衝突情報
+  std::vector<unsigned int> miss_queue;      // 空に飛んでいったパス
+  std::vector<unsigned int> light_queue;     // 光源に当たったパス
+
+  // 物体に当たったパス(Materialの種類ごと)
+  std::array<std::vector<unsigned int>, NUM_MATERIAL_TYPES> material_queues;
+
+  // n本のパスの状態を初期化する
+  // 容量が足りていれば確保し直さない
+  void reset(std::size_t n) {
+    rays.resize(n);
+    lambdas.resize(n);
+    throughputs.assign(n, SampledSpectrum(1));
+    radiances.assign(n, SampledSpectrum(0));
+    camera_weights.assign(n, 0);
+    infos.resize(n);
+    active.clear();
+  };
 };
 
 //与えられたレイとシーンから分光放射輝度を計算するクラス
@@ -27,14 +88,41 @@ class Integrator {
   virtual bool integrate(unsigned int i, unsigned int j, const Scene& scene,
                          Sampler& sampler, IntegratorResult& result) const = 0;
 
- protected:
-  std::shared_ptr<Light> sampleLight(const Scene& scene,
-                                     Sampler& sampler) const {
-    unsigned int i = sampler.getNext() * scene.lights.size();
-    if (i == scene.lights.size()) {
-      i--;
+  // 複数の画素サンプルの受け取る分光放射束をまとめて計算する
+  // samples[k]の結果をresults[k]に書き込む
+  // 寄与が無いサンプルはphiが0になる
+  // workspaceはパスの状態を置く作業領域で、呼び出し側が使い回す
+  // 既定では1つずつintegrateを呼ぶ
+  virtual void integrateWave(const std::vector<PixelSample>& samples,
+                             const Scene& scene, Sampler& sampler,
+                             std::vector<IntegratorResult>& results,
+                             WaveWorkspace& workspace) const {
+    results.resize(samples.size());
+    for (std::size_t k = 0; k < samples.size(); ++k) {
+      results[k].clear();
+      integrate(samples[k].i, samples[k].j, scene, sampler, results[k]);
     }
-    return scene.lights[i];
+  };
+
+  // まとめて計算した方が速いか
+  // trueの場合、Rendererは画素サンプルをタイルごとにまとめて渡す
+  virtual bool isWavefront() const { return false; };
+
+ protected:
+  // infoの点に対して光源の面を1つ選び、選ぶ確率をpdfに返す
+  // 光源はLight BVHで衝突点への寄与の目安に比例して選ぶ
+  // 寄与する光源が無い場合はnullptrを返す
+  const Light* sampleLight(const Scene& scene, const IntersectInfo& info,
+                           Sampler& sampler, unsigned int& face,
+                           Real& pdf) const {
+    return scene.sampleLight(info, sampler.getNext(), face, pdf);
+  };
+
+  // infoの点に対してsampleLightでlightのface番目の面が選ばれる確率を返す
+  // MISの重みの計算に使う
+  Real lightPdf(const Scene& scene, const IntersectInfo& info,
+                const Light* light, unsigned int face) const {
+    return scene.lightPdf(info, light, face);
   };
 };
 
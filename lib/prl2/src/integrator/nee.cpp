@@ -15,60 +15,111 @@ bool NEE::integrate(unsigned int i, unsigned int j, const Scene& scene,
   }
 
   // 波長のサンプリング
-  const Real lambda =
-      SPD::LAMBDA_MIN + sampler.getNext() * (SPD::LAMBDA_MAX - SPD::LAMBDA_MIN);
-  constexpr Real lambda_pdf = 1 / (SPD::LAMBDA_MAX - SPD::LAMBDA_MIN);
-  ray.lambda = lambda;
+  // Hero Wavelengthから等間隔にずらした波長をまとめて追跡する
+  SampledWavelengths lambda =
+      SampledWavelengths::sampleUniform(sampler.getNext());
+  ray.lambda = lambda.hero();
 
-  Real throughput = 1;                 // Throughput
+  SampledSpectrum throughput(1);       // Throughput
   Real russian_roulette_prob = 0.99f;  // ロシアンルーレットの確率
-  Real radiance = 0;                   // 分光放射輝度
+  SampledSpectrum radiance;            // 分光放射輝度
+  Real brdf_pdf = 0;  // 直前のBRDF Samplingのpdf(鏡面反射の場合は0)
   for (int depth = 0; depth < MAX_DEPTH; ++depth) {
     result.rays.push_back(ray);
 
     // ロシアンルーレット
-    if (sampler.getNext() > russian_roulette_prob) {
-      break;
-    } else {
-      throughput /= russian_roulette_prob;
+    // AOVを必ず書き込めるようにPrimary Rayでは行わない
+    if (depth > 0) {
+      if (sampler.getNext() > russian_roulette_prob) {
+        break;
+      } else {
+        throughput /= russian_roulette_prob;
+      }
     }
 
     // レイが物体に当たったら
     IntersectInfo info;
     if (scene.intersect(ray, info)) {
+      // 最初の衝突情報をAOVとして書き込む
+      if (depth == 0) {
+        result.first_hit = true;
+        result.first_info = info;
+      }
+
       // 光源に当たったら終了
       if (info.hitPrimitive->isLight()) {
         break;
       }
 
-      // Light Sampling
-      const auto light = sampleLight(scene, sampler);
-      Vec3 light_pos;
-      Real light_pdf;
-      light->samplePoint(info, sampler, light_pos, light_pdf);
-
-      // Visibility Test
-      Ray shadow_ray(info.hitPos, normalize(light_pos - info.hitPos),
-                     ray.lambda);
-      IntersectInfo shadow_info;
-      if (scene.intersect(shadow_ray, shadow_info)) {
-        if (shadow_info.hitPrimitive->getLight() == light) {
-          const Real brdf = info.hitPrimitive->BRDF(
-              -ray.direction, info.hitNormal, ray.lambda, shadow_ray.direction);
-          const Real cos = std::abs(dot(shadow_ray.direction, info.hitNormal));
-          radiance += throughput * brdf * cos *
-                      light->Le(shadow_ray, shadow_info) / light_pdf;
+      // BRDFがデルタ関数で表される場合は直接サンプリングの寄与が0になるので、
+      // 光源と空のシャドウレイを飛ばさない
+      if (!info.hitPrimitive->isDelta()) {
+        // Light Sampling
+        // 光源はSceneが所有しているので、生ポインタのまま使う
+        unsigned int light_face;
+        Real light_select_pdf;
+        const Light* light =
+            sampleLight(scene, info, sampler, light_face, light_select_pdf);
+        if (light != nullptr) {
+          IntersectInfo light_info;
+          Real light_pdf;
+          light->sampleFace(light_face, info, sampler, light_info.hitPos,
+                            light_info.hitNormal, light_pdf);
+          light_info.faceID = light_face;
+          light_pdf *= light_select_pdf;
+
+          // Visibility Test
+          // 光源上の点の手前までに何かに当たるかだけを判定する
+          const Vec3 to_light = light_info.hitPos - info.hitPos;
+          const Real light_distance = length(to_light);
+          const Ray shadow_ray(info.hitPos, to_light / light_distance,
+                               ray.lambda);
+          if (!scene.occluded(shadow_ray,
+                              (1 - SHADOW_RAY_EPS) * light_distance)) {
+            const SampledSpectrum brdf = info.hitPrimitive->BRDF(
+                -ray.direction, info.hitNormal, lambda, shadow_ray.direction);
+            const Real cos =
+                std::abs(dot(shadow_ray.direction, info.hitNormal));
+            radiance += throughput * brdf * cos *
+                        light->Le(shadow_ray, light_info, lambda) / light_pdf;
+          }
+        }
+
+        // Sky Sampling
+        // 空が方向の分布を持つ場合は空の方向も直接サンプリングし、
+        // BRDF Samplingで空に当たった場合とMISで組み合わせる
+        if (scene.sky->hasDistribution()) {
+          Real sky_pdf;
+          const Vec3 wi = scene.sky->sampleDirection(sampler, sky_pdf);
+          const Ray shadow_ray(info.hitPos, wi, ray.lambda);
+          if (sky_pdf > 0 && !scene.occluded(shadow_ray, Ray::tmax)) {
+            const SampledSpectrum brdf = info.hitPrimitive->BRDF(
+                -ray.direction, info.hitNormal, lambda, wi);
+            const Real cos = std::abs(dot(wi, info.hitNormal));
+            const Real brdf_pdf_wi = info.hitPrimitive->BRDFPdf(
+                -ray.direction, info.hitNormal, lambda, wi);
+            const Real weight = powerHeuristic(sky_pdf, brdf_pdf_wi);
+            radiance += throughput * brdf * cos * weight *
+                        scene.sky->getRadiance(shadow_ray, lambda) / sky_pdf;
+          }
         }
       }
 
       // BRDF Sampling
       Vec3 wi;
       Real cos, pdf;
-      const Real brdf = info.hitPrimitive->sampleBRDF(
-          -ray.direction, info.hitNormal, ray.lambda, sampler, wi, cos, pdf);
+      const SampledSpectrum brdf = info.hitPrimitive->sampleBRDF(
+          -ray.direction, info.hitNormal, lambda, sampler, wi, cos, pdf);
+
+      // 最初の衝突点でサンプリングされた方向をAOVとして書き込む
+      if (depth == 0) {
+        result.first_wi = wi;
+      }
 
       // Throughputを更新
       throughput *= brdf * cos / pdf;
+      brdf_pdf = info.hitPrimitive->BRDFPdf(-ray.direction, info.hitNormal,
+                                            lambda, wi);
 
       // レイを更新
       ray.origin = info.hitPos;
@@ -76,13 +127,21 @@ bool NEE::integrate(unsigned int i, unsigned int j, const Scene& scene,
     }
     // レイが空に飛んでいったら
     else {
-      radiance += throughput * scene.sky->getRadiance(ray);
+      // Sky Samplingでも計算している場合はMISの重みを掛ける
+      Real weight = 1;
+      if (depth > 0 && brdf_pdf > 0 && scene.sky->hasDistribution()) {
+        weight = powerHeuristic(brdf_pdf, scene.sky->getPdf(ray.direction));
+      }
+      radiance += weight * throughput * scene.sky->getRadiance(ray, lambda);
       break;
     }
   }
 
+  // 波長ごとのpdfで割り、波長数で平均する
+  // 打ち切られた波長はpdfが0なので寄与も0になる
   result.lambda = lambda;
-  result.phi = radiance * camera_cos / (lambda_pdf * camera_pdf);
+  result.phi = safeDivide(radiance, lambda.pdf) * camera_cos /
+               (camera_pdf * WAVELENGTH_SAMPLES);
   return true;
 }
 
@@ -11,6 +11,8 @@ class NEE : public Integrator {
 
  private:
   static constexpr int MAX_DEPTH = 100;
+  // 光源自身に当たらないようにシャドウレイを短くする割合
+  static constexpr Real SHADOW_RAY_EPS = 1e-3f;
 };
 
 }  // namespace Prl2
\ No newline at end of file
@@ -15,39 +15,54 @@ bool PT::integrate(unsigned int i, unsigned int j, const Scene& scene,
   }
 
   // 波長のサンプリング
-  const Real lambda =
-      SPD::LAMBDA_MIN + sampler.getNext() * (SPD::LAMBDA_MAX - SPD::LAMBDA_MIN);
-  constexpr Real lambda_pdf = 1 / (SPD::LAMBDA_MAX - SPD::LAMBDA_MIN);
-  ray.lambda = lambda;
+  // Hero Wavelengthから等間隔にずらした波長をまとめて追跡する
+  SampledWavelengths lambda =
+      SampledWavelengths::sampleUniform(sampler.getNext());
+  ray.lambda = lambda.hero();
 
-  Real throughput = 1;                 // Throughput
+  SampledSpectrum throughput(1);       // Throughput
   Real russian_roulette_prob = 0.99f;  // ロシアンルーレットの確率
-  Real radiance = 0;                   // 分光放射輝度
+  SampledSpectrum radiance;            // 分光放射輝度
 
   for (int depth = 0; depth < MAXDEPTH; ++depth) {
     result.rays.push_back(ray);
 
     // ロシアンルーレット
-    if (sampler.getNext() > russian_roulette_prob) {
-      break;
-    } else {
-      throughput /= russian_roulette_prob;
+    // AOVを必ず書き込めるようにPrimary Rayでは行わない
+    if (depth > 0) {
+      if (sampler.getNext() > russian_roulette_prob) {
+        break;
+      } else {
+        throughput /= russian_roulette_prob;
+      }
     }
 
     // レイが物体に当たったら
     IntersectInfo info;
     if (scene.intersect(ray, info)) {
+      // 最初の衝突情報をAOVとして書き込む
+      if (depth == 0) {
+        result.first_hit = true;
+        result.first_info = info;
+      }
+
       // 光源に当たったら寄与を追加
       if (info.hitPrimitive->isLight()) {
-        radiance += throughput * info.hitPrimitive->getLight()->Le(ray, info);
+        radiance +=
+            throughput * info.hitPrimitive->getLight()->Le(ray, info, lambda);
         break;
       }
 
       // BRDF Sampling
       Vec3 wi;
       Real cos, pdf;
-      Real brdf = info.hitPrimitive->sampleBRDF(
-          -ray.direction, info.hitNormal, ray.lambda, sampler, wi, cos, pdf);
+      const SampledSpectrum brdf = info.hitPrimitive->sampleBRDF(
+          -ray.direction, info.hitNormal, lambda, sampler, wi, cos, pdf);
+
+      // 最初の衝突点でサンプリングされた方向をAOVとして書き込む
+      if (depth == 0) {
+        result.first_wi = wi;
+      }
 
       // Throughputを更新
       throughput *= brdf * cos / pdf;
@@ -58,13 +73,16 @@ bool PT::integrate(unsigned int i, unsigned int j, const Scene& scene,
     }
     // レイが空に飛んでいったら
     else {
-      radiance += throughput * scene.sky->getRadiance(ray);
+      radiance += throughput * scene.sky->getRadiance(ray, lambda);
       break;
     }
   }
 
+  // 波長ごとのpdfで割り、波長数で平均する
+  // 打ち切られた波長はpdfが0なので寄与も0になる
   result.lambda = lambda;
-  result.phi = radiance * camera_cos / (lambda_pdf * camera_pdf);
+  result.phi = safeDivide(radiance, lambda.pdf) * camera_cos /
+               (camera_pdf * WAVELENGTH_SAMPLES);
   return true;
 }
 
@@ -0,0 +1,199 @@
+#include "integrator/wavefront.h"
+
+#include "material/diffuse.h"
+#include "material/glass.h"
+#include "material/mirror.h"
+
+namespace Prl2 {
+
+bool WavefrontPT::integrate(unsigned int i, unsigned int j, const Scene& scene,
+                            Sampler& sampler, IntegratorResult& result) const {
+  return pt.integrate(i, j, scene, sampler, result);
+}
+
+void WavefrontPT::integrateWave(const std::vector<PixelSample>& samples,
+                                const Scene& scene, Sampler& sampler,
+                                std::vector<IntegratorResult>& results,
+                                WaveWorkspace& workspace) const {
+  const unsigned int n = samples.size();
+  results.resize(n);
+
+  WaveWorkspace& paths = workspace;
+  paths.reset(n);
+  std::vector<unsigned int>& active = paths.active;
+
+  // Generate
+  // Primary Rayと波長をサンプリングする
+  for (unsigned int k = 0; k < n; ++k) {
+    results[k].clear();
+
+    const Vec2 pFilm =
+        scene.camera->sampleFilm(samples[k].i, samples[k].j, sampler);
+
+    Ray ray;
+    Real camera_cos, camera_pdf;
+    if (!scene.camera->generateRay(pFilm, sampler, ray, camera_cos,
+                                   camera_pdf)) {
+      continue;
+    }
+
+    paths.lambdas[k] = SampledWavelengths::sampleUniform(sampler.getNext());
+    ray.lambda = paths.lambdas[k].hero();
+    paths.rays[k] = ray;
+    paths.camera_weights[k] = camera_cos / camera_pdf;
+    active.push_back(k);
+  }
+
+  // ステージ間で使い回すキュー
+  std::vector<Ray>& extend_rays = paths.extend_rays;
+  std::vector<IntersectInfo>& extend_infos = paths.extend_infos;
+  std::vector<unsigned int>& miss_queue = paths.miss_queue;
+  std::vector<unsigned int>& light_queue = paths.light_queue;
+  auto& material_queues = paths.material_queues;
+
+  const Real russian_roulette_prob = 0.99f;  // ロシアンルーレットの確率
+  for (int depth = 0; depth < MAX_DEPTH && !active.empty(); ++depth) {
+    // ロシアンルーレット
+    // AOVを必ず書き込めるようにPrimary Rayでは行わない
+    if (depth > 0) {
+      unsigned int num_alive = 0;
+      for (const unsigned int k : active) {
+        if (sampler.getNext() > russian_roulette_prob) {
+          continue;
+        }
+        paths.throughputs[k] /= russian_roulette_prob;
+        active[num_alive++] = k;
+      }
+      active.resize(num_alive);
+    }
+
+    // Extend
+    // 追跡中のレイを詰めてまとめて衝突計算する
+    extend_rays.resize(active.size());
+    extend_infos.resize(active.size());
+    for (std::size_t idx = 0; idx < active.size(); ++idx) {
+      extend_rays[idx] = paths.rays[active[idx]];
+      results[active[idx]].rays.push_back(extend_rays[idx]);
+    }
+    scene.intersectBatch(active.size(), extend_rays.data(),
+                         extend_infos.data());
+
+    // 衝突結果によってキューに振り分ける
+    miss_queue.clear();
+    light_queue.clear();
+    for (std::vector<unsigned int>& queue : material_queues) {
+      queue.clear();
+    }
+    for (std::size_t idx = 0; idx < active.size(); ++idx) {
+      const unsigned int k = active[idx];
+      const IntersectInfo& info = extend_infos[idx];
+      if (info.hitPrimitive == nullptr) {
+        miss_queue.push_back(k);
+        continue;
+      }
+
+      paths.infos[k] = info;
+
+      // 最初の衝突情報をAOVとして書き込む
+      if (depth == 0) {
+        results[k].first_hit = true;
+        results[k].first_info = info;
+      }
+
+      if (info.hitPrimitive->isLight()) {
+        light_queue.push_back(k);
+      } else {
+        const MaterialType type =
+            info.hitPrimitive->getMaterial()->getType();
+        material_queues[static_cast<unsigned int>(type)].push_back(k);
+      }
+    }
+
+    // Sky
+    // レイが空に飛んでいったパスの寄与を追加する
+    for (const unsigned int k : miss_queue) {
+      paths.radiances[k] += paths.throughputs[k] *
+                            scene.sky->getRadiance(paths.rays[k],
+                                                   paths.lambdas[k]);
+    }
+
+    // Light
+    // 光源に当たったパスの寄与を追加する
+    for (const unsigned int k : light_queue) {
+      const IntersectInfo& info = paths.infos[k];
+      paths.radiances[k] +=
+          paths.throughputs[k] * info.hitPrimitive->getLight()->Le(
+                                     paths.rays[k], info, paths.lambdas[k]);
+    }
+
+    // Material
+    // Materialの種類ごとのステージでBRDF Samplingを行う
+    sampleMaterial<Diffuse>(
+        material_queues[static_cast<unsigned int>(MaterialType::Diffuse)],
+        depth, sampler, results, paths);
+    sampleMaterial<Mirror>(
+        material_queues[static_cast<unsigned int>(MaterialType::Mirror)],
+        depth, sampler, results, paths);
+    sampleMaterial<Glass>(
+        material_queues[static_cast<unsigned int>(MaterialType::Glass)],
+        depth, sampler, results, paths);
+
+    // 次のExtendではMaterialのステージを通ったパスだけを追跡する
+    active.clear();
+    for (const std::vector<unsigned int>& queue : material_queues) {
+      active.insert(active.end(), queue.begin(), queue.end());
+    }
+  }
+
+  // 波長ごとのpdfで割り、波長数で平均する
+  for (unsigned int k = 0; k < n; ++k) {
+    results[k].lambda = paths.lambdas[k];
+    results[k].phi = safeDivide(paths.radiances[k], paths.lambdas[k].pdf) *
+                     paths.camera_weights[k] /
+                     static_cast<Real>(WAVELENGTH_SAMPLES);
+  }
+}
+
+template <typename M>
+void WavefrontPT::sampleMaterial(const std::vector<unsigned int>& queue,
+                                 int depth, Sampler& sampler,
+                                 std::vector<IntegratorResult>& results,
+                                 WaveWorkspace& paths) const {
+  for (const unsigned int k : queue) {
+    const IntersectInfo& info = paths.infos[k];
+    Ray& ray = paths.rays[k];
+    const Vec3 wo = -ray.direction;
+
+    // Primitive::sampleBRDFと同じマテリアル座標系を使う
+    Vec3 s, n, t;
+    info.hitPrimitive->getMaterialFrame(wo, info.hitNormal, s, n, t);
+
+    MaterialArgs args;
+    args.lambda = paths.lambdas[k];
+    args.wo_local = worldToMaterial(wo, s, n, t);
+
+    // 種類が分かっているので仮想関数を介さずに呼び出す
+    const M* material =
+        static_cast<const M*>(info.hitPrimitive->getMaterial().get());
+    Real pdf;
+    const SampledSpectrum brdf =
+        material->M::sampleDirection(args, sampler, pdf);
+    const Real cos = absCosTheta(args.wi_local);
+    const Vec3 wi = materialToWorld(args.wi_local, s, n, t);
+    paths.lambdas[k] = args.lambda;
+
+    // 最初の衝突点でサンプリングされた方向をAOVとして書き込む
+    if (depth == 0) {
+      results[k].first_wi = wi;
+    }
+
+    // Throughputを更新
+    paths.throughputs[k] *= brdf * cos / pdf;
+
+    // レイを更新
+    ray.origin = info.hitPos;
+    ray.direction = wi;
+  }
+}
+
+}  // namespace Prl2
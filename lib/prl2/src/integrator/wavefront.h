@@ -0,0 +1,46 @@
+#ifndef _PRL2_WAVEFRONT_H
+#define _PRL2_WAVEFRONT_H
+
+#include "integrator/integrator.h"
+#include "integrator/pt.h"
+
+namespace Prl2 {
+
+// Wavefront方式のPath Tracingを実装するクラス
+// 1本ずつパスを追跡する代わりに、多数のパスの状態を配列(SoA)で保持し、
+// 衝突計算、空、光源、Materialの各ステージを全てのパスに対してまとめて行う
+// 衝突計算はIntersector::intersectBatchでまとめて行う
+// 物体に当たったパスはMaterialの種類ごとのキューに振り分け、
+// 種類ごとのステージで仮想関数を介さずにBRDF Samplingを行う
+// 推定値はPTと同じになるので、光源の直接サンプリングのステージは無い
+class WavefrontPT : public Integrator {
+ public:
+  WavefrontPT() noexcept {}
+
+  // 1つの画素サンプルはPTで計算する
+  bool integrate(unsigned int i, unsigned int j, const Scene& scene,
+                 Sampler& sampler, IntegratorResult& result) const override;
+
+  void integrateWave(const std::vector<PixelSample>& samples,
+                     const Scene& scene, Sampler& sampler,
+                     std::vector<IntegratorResult>& results,
+                     WaveWorkspace& workspace) const override;
+
+  bool isWavefront() const override { return true; };
+
+ private:
+  static constexpr int MAX_DEPTH = 100;  // 最大反射回数
+
+  PT pt;  // 1つの画素サンプルを計算するIntegrator
+
+  // queueのパスのBRDF Samplingをまとめて行い、次のレイを設定する
+  // queueのパスは全てMのMaterialに当たっている
+  template <typename M>
+  void sampleMaterial(const std::vector<unsigned int>& queue, int depth,
+                      Sampler& sampler, std::vector<IntegratorResult>& results,
+                      WaveWorkspace& paths) const;
+};
+
+}  // namespace Prl2
+
+#endif
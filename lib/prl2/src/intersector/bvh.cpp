@@ -0,0 +1,335 @@
+#include "intersector/bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <thread>
+
+namespace Prl2 {
+
+// 構築時のPrimitiveの面の情報
+struct BVHIntersector::PrimitiveInfo {
+  unsigned int index;  // primitivesでの番号
+  unsigned int face;   // 面のインデックス
+  Bounds3 bounds;      // バウンディングボックス
+  Vec3 centroid;       // バウンディングボックスの中心
+};
+
+// 構築時のBVHのノード
+struct BVHIntersector::BuildNode {
+  Bounds3 bounds;                          // バウンディングボックス
+  std::unique_ptr<BuildNode> children[2];  // 子ノード
+  unsigned int axis;                       // 分割軸
+  unsigned int primitives_offset;  // 葉ノード: Primitiveの開始位置
+  unsigned int num_primitives;     // 葉ノード: Primitive数
+};
+
+namespace {
+
+// SAHのビンの数
+constexpr int NUM_BINS = 16;
+
+// ノードを辿るコストに対するPrimitiveとの衝突計算のコストの比
+constexpr Real INTERSECT_COST = 1;
+constexpr Real TRAVERSAL_COST = 0.125f;
+
+// 子ノードを別スレッドで構築する最小のPrimitive数
+constexpr unsigned int PARALLEL_BUILD_THRESHOLD = 4096;
+
+// 走査に使うスタックの大きさ
+// スタックには根から現在のノードまでの各内部ノードの子を高々1つずつ積むので、
+// 葉ノードの深さがSTACK_SIZE以下なら溢れない
+constexpr int STACK_SIZE = 64;
+
+// 構築するBVHの最大の深さ
+// これより深くなる場合は分割せずに葉ノードにする
+constexpr unsigned int MAX_BUILD_DEPTH = STACK_SIZE;
+
+}  // namespace
+
+BVHIntersector::BVHIntersector(unsigned int _max_prims_in_node)
+    : max_prims_in_node(_max_prims_in_node) {}
+
+bool BVHIntersector::initialize() {
+  nodes.clear();
+  ordered_primitives.clear();
+  if (primitives.empty()) {
+    return true;
+  }
+
+  // 面ごとのバウンディングボックスを計算する
+  std::size_t num_faces = 0;
+  for (const auto& prim : primitives) {
+    num_faces += prim->getNumFaces();
+  }
+  std::vector<PrimitiveInfo> prim_info;
+  prim_info.reserve(num_faces);
+  for (unsigned int k = 0; k < primitives.size(); ++k) {
+    const unsigned int n = primitives[k]->getNumFaces();
+    for (unsigned int face = 0; face < n; ++face) {
+      PrimitiveInfo info;
+      info.index = k;
+      info.face = face;
+      info.bounds = primitives[k]->getFaceBounds(face);
+      info.centroid = info.bounds.center();
+      prim_info.push_back(info);
+    }
+  }
+  if (prim_info.empty()) {
+    return true;
+  }
+
+  // 構築
+  // buildはprim_infoを葉ノードの順に並べ替える
+  const std::unique_ptr<BuildNode> root =
+      build(prim_info, 0, prim_info.size(), 0);
+
+  ordered_primitives.resize(prim_info.size());
+  for (unsigned int k = 0; k < prim_info.size(); ++k) {
+    ordered_primitives[k] = {primitives[prim_info[k].index].get(),
+                             prim_info[k].face};
+  }
+
+  // 配列に並べる
+  flatten(*root);
+
+  return true;
+}
+
+std::unique_ptr<BVHIntersector::BuildNode> BVHIntersector::build(
+    std::vector<PrimitiveInfo>& prim_info, unsigned int start,
+    unsigned int end, unsigned int depth) const {
+  auto node = std::make_unique<BuildNode>();
+  const unsigned int n = end - start;
+
+  // バウンディングボックスと中心のバウンディングボックスを計算する
+  Bounds3 bounds = prim_info[start].bounds;
+  Bounds3 centroid_bounds(prim_info[start].centroid,
+                          prim_info[start].centroid);
+  for (unsigned int k = start + 1; k < end; ++k) {
+    bounds = mergeBounds(bounds, prim_info[k].bounds);
+    centroid_bounds = mergeBounds(centroid_bounds, prim_info[k].centroid);
+  }
+  node->bounds = bounds;
+
+  const auto makeLeaf = [&]() {
+    node->primitives_offset = start;
+    node->num_primitives = n;
+    return std::move(node);
+  };
+
+  // 中心が全て重なっている場合は分割できないので葉ノードにする
+  const int axis = centroid_bounds.maxExtent();
+  if (n == 1 || centroid_bounds.p1[axis] == centroid_bounds.p0[axis]) {
+    return makeLeaf();
+  }
+
+  // 走査のスタックが溢れないように、最大の深さに達したら葉ノードにする
+  if (depth >= MAX_BUILD_DEPTH) {
+    return makeLeaf();
+  }
+
+  // Binned SAH
+  // 中心の位置でビンに分け、ビンの境界で分割したときのコストを比べる
+  struct Bin {
+    unsigned int count = 0;
+    Bounds3 bounds;
+  };
+  Bin bins[NUM_BINS];
+  const auto binIndex = [&](const PrimitiveInfo& info) {
+    const int b = NUM_BINS * centroid_bounds.offset(info.centroid)[axis];
+    return std::min(b, NUM_BINS - 1);
+  };
+  for (unsigned int k = start; k < end; ++k) {
+    Bin& bin = bins[binIndex(prim_info[k])];
+    bin.bounds = bin.count == 0 ? prim_info[k].bounds
+                                : mergeBounds(bin.bounds, prim_info[k].bounds);
+    bin.count++;
+  }
+
+  // 左右から累積してビンの境界ごとのコストを計算する
+  Real cost[NUM_BINS - 1];
+  {
+    unsigned int count = 0;
+    Bounds3 b;
+    for (int i = 0; i < NUM_BINS - 1; ++i) {
+      if (bins[i].count > 0) {
+        b = count == 0 ? bins[i].bounds : mergeBounds(b, bins[i].bounds);
+        count += bins[i].count;
+      }
+      cost[i] = count == 0 ? 0 : count * b.surfaceArea();
+    }
+  }
+  {
+    unsigned int count = 0;
+    Bounds3 b;
+    for (int i = NUM_BINS - 1; i > 0; --i) {
+      if (bins[i].count > 0) {
+        b = count == 0 ? bins[i].bounds : mergeBounds(b, bins[i].bounds);
+        count += bins[i].count;
+      }
+      cost[i - 1] += count == 0 ? 0 : count * b.surfaceArea();
+    }
+  }
+
+  int min_bin = 0;
+  for (int i = 1; i < NUM_BINS - 1; ++i) {
+    if (cost[i] < cost[min_bin]) {
+      min_bin = i;
+    }
+  }
+  const Real split_cost =
+      TRAVERSAL_COST + INTERSECT_COST * cost[min_bin] / bounds.surfaceArea();
+  const Real leaf_cost = INTERSECT_COST * n;
+
+  // 分割しても安くならない場合は葉ノードにする
+  if (n <= max_prims_in_node && split_cost >= leaf_cost) {
+    return makeLeaf();
+  }
+
+  // 分割
+  const auto mid_it = std::partition(
+      prim_info.begin() + start, prim_info.begin() + end,
+      [&](const PrimitiveInfo& info) { return binIndex(info) <= min_bin; });
+  unsigned int mid = mid_it - prim_info.begin();
+  if (mid == start || mid == end) {
+    mid = start + n / 2;
+  }
+
+  // 子ノードを構築する
+  // 大きな部分木は左右を別スレッドで構築する(左右の範囲は重ならない)
+  node->axis = static_cast<unsigned int>(axis);
+  node->num_primitives = 0;
+  const unsigned int max_parallel_depth = static_cast<unsigned int>(
+      std::log2(std::max(std::thread::hardware_concurrency(), 1u)));
+  if (n >= PARALLEL_BUILD_THRESHOLD && depth < max_parallel_depth) {
+    auto left = std::async(std::launch::async, [&]() {
+      return build(prim_info, start, mid, depth + 1);
+    });
+    node->children[1] = build(prim_info, mid, end, depth + 1);
+    node->children[0] = left.get();
+  } else {
+    node->children[0] = build(prim_info, start, mid, depth + 1);
+    node->children[1] = build(prim_info, mid, end, depth + 1);
+  }
+
+  return node;
+}
+
+unsigned int BVHIntersector::flatten(const BuildNode& node) {
+  const unsigned int offset = nodes.size();
+  nodes.emplace_back();
+  nodes[offset].bounds = node.bounds;
+  nodes[offset].num_primitives = node.num_primitives;
+
+  if (node.num_primitives > 0) {
+    nodes[offset].primitives_offset = node.primitives_offset;
+  } else {
+    nodes[offset].axis = node.axis;
+    flatten(*node.children[0]);
+    const unsigned int second = flatten(*node.children[1]);
+    nodes[offset].second_child_offset = second;
+  }
+
+  return offset;
+}
+
+bool BVHIntersector::intersect(const Ray& ray, IntersectInfo& info) const {
+  if (nodes.empty()) {
+    return false;
+  }
+
+  const Vec3 dirInv = 1 / ray.direction;
+  const int dirIsNeg[3] = {dirInv.x() < 0, dirInv.y() < 0, dirInv.z() < 0};
+
+  bool hit = false;
+  Real t = ray.tmax;
+  IntersectInfo info_tmp;
+
+  unsigned int stack[STACK_SIZE];
+  int stack_size = 0;
+  unsigned int current = 0;
+  while (true) {
+    const LinearNode& node = nodes[current];
+    if (node.bounds.intersect(ray, dirInv, dirIsNeg, t)) {
+      if (node.num_primitives > 0) {
+        // 葉ノード
+        for (unsigned int k = 0; k < node.num_primitives; ++k) {
+          const PrimitiveRef& ref =
+              ordered_primitives[node.primitives_offset + k];
+          //衝突距離が最も小さいものを選ぶ
+          if (ref.primitive->intersectFace(ref.face, ray, info_tmp) &&
+              info_tmp.t < t) {
+            t = info_tmp.t;
+            info = info_tmp;
+            hit = true;
+          }
+        }
+        if (stack_size == 0) break;
+        current = stack[--stack_size];
+      } else {
+        // 内部ノード
+        // レイの方向から近い方の子を先に辿る
+        if (dirIsNeg[node.axis]) {
+          stack[stack_size++] = current + 1;
+          current = node.second_child_offset;
+        } else {
+          stack[stack_size++] = node.second_child_offset;
+          current = current + 1;
+        }
+      }
+    } else {
+      if (stack_size == 0) break;
+      current = stack[--stack_size];
+    }
+  }
+
+  return hit;
+}
+
+bool BVHIntersector::occluded(const Ray& ray, const Real& tmax) const {
+  if (nodes.empty()) {
+    return false;
+  }
+
+  const Vec3 dirInv = 1 / ray.direction;
+  const int dirIsNeg[3] = {dirInv.x() < 0, dirInv.y() < 0, dirInv.z() < 0};
+
+  unsigned int stack[STACK_SIZE];
+  int stack_size = 0;
+  unsigned int current = 0;
+  while (true) {
+    const LinearNode& node = nodes[current];
+    if (node.bounds.intersect(ray, dirInv, dirIsNeg, tmax)) {
+      if (node.num_primitives > 0) {
+        // 葉ノード
+        // どれか1つと衝突した時点で打ち切る
+        for (unsigned int k = 0; k < node.num_primitives; ++k) {
+          const PrimitiveRef& ref =
+              ordered_primitives[node.primitives_offset + k];
+          if (ref.primitive->occludedFace(ref.face, ray, tmax)) {
+            return true;
+          }
+        }
+        if (stack_size == 0) break;
+        current = stack[--stack_size];
+      } else {
+        // 内部ノード
+        if (dirIsNeg[node.axis]) {
+          stack[stack_size++] = current + 1;
+          current = node.second_child_offset;
+        } else {
+          stack[stack_size++] = node.second_child_offset;
+          current = current + 1;
+        }
+      }
+    } else {
+      if (stack_size == 0) break;
+      current = stack[--stack_size];
+    }
+  }
+
+  return false;
+}
+
+}  // namespace Prl2
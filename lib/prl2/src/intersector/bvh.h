@@ -0,0 +1,72 @@
+#ifndef _PRL2_BVH_H
+#define _PRL2_BVH_H
+
+#include <memory>
+#include <vector>
+
+#include "intersector/intersector.h"
+
+namespace Prl2 {
+
+// BVH(Bounding Volume Hierarchy)を使って衝突計算を行うクラス
+// Embreeを使わずに済むように全て自前で実装している
+// 構築はBinned SAHで行い、大きな部分木はスレッドを分けて並列に構築する
+// 構築後のノードは深さ優先順に1つの配列に並べ、左の子は常に直後に置く
+// メッシュのように複数の面を持つPrimitiveは面ごとに葉ノードに入れる
+class BVHIntersector : public Intersector {
+ public:
+  // max_prims_in_node: 葉ノードに入れるPrimitiveの最大数の目安
+  BVHIntersector(unsigned int _max_prims_in_node = 4);
+
+  bool initialize() override;
+
+  // 近い方の子から順に辿り、最も近い衝突を返す
+  bool intersect(const Ray& ray, IntersectInfo& info) const override;
+
+  // 最初に見つかった衝突で打ち切る
+  bool occluded(const Ray& ray, const Real& tmax) const override;
+
+  // BVHのノード数を返す
+  std::size_t getNumNodes() const { return nodes.size(); };
+
+ private:
+  struct BuildNode;
+  struct PrimitiveInfo;
+
+  // 葉ノードに入れるPrimitiveの面
+  struct PrimitiveRef {
+    const Primitive* primitive;  // Primitive
+    unsigned int face;           // 面のインデックス
+  };
+
+  // 配列に並べたBVHのノード
+  struct LinearNode {
+    Bounds3 bounds;  // バウンディングボックス
+    union {
+      unsigned int primitives_offset;    // 葉ノード: 面の開始位置
+      unsigned int second_child_offset;  // 内部ノード: 右の子の位置
+    };
+    unsigned int num_primitives;  // 葉ノードの面の数(内部ノードは0)
+    unsigned int axis;            // 内部ノードの分割軸
+  };
+
+  const unsigned int max_prims_in_node;  // 葉ノードのPrimitive数の目安
+
+  std::vector<LinearNode> nodes;  // BVHのノード
+  std::vector<PrimitiveRef>
+      ordered_primitives;  // 葉ノードの順に並べたPrimitiveの面
+
+  // [start, end)の面からBVHを構築する
+  // depthが浅い間は子ノードを別スレッドで構築する
+  std::unique_ptr<BuildNode> build(std::vector<PrimitiveInfo>& prim_info,
+                                   unsigned int start, unsigned int end,
+                                   unsigned int depth) const;
+
+  // BuildNodeを深さ優先順にnodesに並べる
+  // 並べたノードの位置を返す
+  unsigned int flatten(const BuildNode& node);
+};
+
+}  // namespace Prl2
+
+#endif
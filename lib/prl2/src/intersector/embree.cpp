@@ -1,64 +1,99 @@
 #include "intersector/embree.h"
 
+#include <limits>
+#include <map>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 namespace Prl2 {
 
 static void RTCErrorFunction(void* userPtr, RTCError code, const char* str) {
   fprintf(stderr, "error %d: %s", code, str);
 }
 
-static void RTCUserGeometryIntersect(
-    const RTCIntersectFunctionNArguments* args) {
-  const Primitive* prim =
-      reinterpret_cast<const Primitive*>(args->geometryUserPtr);
-
-  assert(args->N == 1);
-  if (!args->valid[0]) {
-    return;
-  }
+// ユーザー定義ジオメトリのコールバック
+// インスタンスの中から呼ばれるので、レイは既にShapeのローカル座標系に変換されている
+static void RTCShapeIntersect(const RTCIntersectFunctionNArguments* args) {
+  const Shape* shape = reinterpret_cast<const Shape*>(args->geometryUserPtr);
 
   RTCRayN* rayn = RTCRayHitN_RayN(args->rayhit, args->N);
   RTCHitN* hitn = RTCRayHitN_HitN(args->rayhit, args->N);
 
-  // compute ray
-  const float ox = RTCRayN_org_x(rayn, args->N, 0);
-  const float oy = RTCRayN_org_y(rayn, args->N, 0);
-  const float oz = RTCRayN_org_z(rayn, args->N, 0);
-  const float dx = RTCRayN_dir_x(rayn, args->N, 0);
-  const float dy = RTCRayN_dir_y(rayn, args->N, 0);
-  const float dz = RTCRayN_dir_z(rayn, args->N, 0);
-  const Ray ray(Vec3(ox, oy, oz), Vec3(dx, dy, dz));
+  // rtcIntersect1Mなどでは複数のレイがまとめて渡されることがある
+  for (unsigned int k = 0; k < args->N; ++k) {
+    if (!args->valid[k]) {
+      continue;
+    }
 
-  // intersect
-  IntersectInfo info;
-  bool is_hit = prim->intersect(ray, info);
+    // compute ray
+    const float ox = RTCRayN_org_x(rayn, args->N, k);
+    const float oy = RTCRayN_org_y(rayn, args->N, k);
+    const float oz = RTCRayN_org_z(rayn, args->N, k);
+    const float dx = RTCRayN_dir_x(rayn, args->N, k);
+    const float dy = RTCRayN_dir_y(rayn, args->N, k);
+    const float dz = RTCRayN_dir_z(rayn, args->N, k);
+    const Ray ray(Vec3(ox, oy, oz), Vec3(dx, dy, dz));
+
+    // intersect
+    // 既に見つかっている衝突より遠い場合は無視する
+    IntersectInfo info;
+    if (!shape->intersect(ray, info) ||
+        info.t >= RTCRayN_tfar(rayn, args->N, k)) {
+      continue;
+    }
 
-  // set intersect info
-  if (is_hit) {
-    RTCRayN_tfar(rayn, args->N, 0) = info.t;  // hit distance
+    // set intersect info
+    RTCRayN_tfar(rayn, args->N, k) = info.t;  // hit distance
 
-    // hit normal
-    RTCHitN_Ng_x(hitn, args->N, 0) = info.hitNormal.x();
-    RTCHitN_Ng_y(hitn, args->N, 0) = info.hitNormal.y();
-    RTCHitN_Ng_z(hitn, args->N, 0) = info.hitNormal.z();
+    // hit normal (local)
+    RTCHitN_Ng_x(hitn, args->N, k) = info.hitNormal.x();
+    RTCHitN_Ng_y(hitn, args->N, k) = info.hitNormal.y();
+    RTCHitN_Ng_z(hitn, args->N, k) = info.hitNormal.z();
 
     // uv
-    RTCHitN_u(hitn, args->N, 0) = info.uv.x();
-    RTCHitN_v(hitn, args->N, 0) = info.uv.y();
+    RTCHitN_u(hitn, args->N, k) = info.uv.x();
+    RTCHitN_v(hitn, args->N, k) = info.uv.y();
 
-    // geom_id and prim_id
-    RTCHitN_geomID(hitn, args->N, 0) = prim->getID();
-    RTCHitN_primID(hitn, args->N, 0) = args->primID;
-  } else {
-    RTCHitN_geomID(hitn, args->N, 0) = RTC_INVALID_GEOMETRY_ID;
+    // inst_id, geom_id and prim_id
+    RTCHitN_instID(hitn, args->N, k, 0) = args->context->instID[0];
+    RTCHitN_geomID(hitn, args->N, k) = args->geomID;
+    RTCHitN_primID(hitn, args->N, k) = args->primID;
+  }
+}
+
+static void RTCShapeOccluded(const RTCOccludedFunctionNArguments* args) {
+  const Shape* shape = reinterpret_cast<const Shape*>(args->geometryUserPtr);
+
+  RTCRayN* rayn = args->ray;
+
+  for (unsigned int k = 0; k < args->N; ++k) {
+    if (!args->valid[k]) {
+      continue;
+    }
+
+    // compute ray
+    const float ox = RTCRayN_org_x(rayn, args->N, k);
+    const float oy = RTCRayN_org_y(rayn, args->N, k);
+    const float oz = RTCRayN_org_z(rayn, args->N, k);
+    const float dx = RTCRayN_dir_x(rayn, args->N, k);
+    const float dy = RTCRayN_dir_y(rayn, args->N, k);
+    const float dz = RTCRayN_dir_z(rayn, args->N, k);
+    const Ray ray(Vec3(ox, oy, oz), Vec3(dx, dy, dz));
+
+    // occluded
+    // 衝突した場合はtfarを-infにするとEmbreeが探索を打ち切る
+    if (shape->occluded(ray, RTCRayN_tfar(rayn, args->N, k))) {
+      RTCRayN_tfar(rayn, args->N, k) = -std::numeric_limits<float>::infinity();
+    }
   }
 }
 
-static void RTCUserGeometryBound(const RTCBoundsFunctionArguments* args) {
-  const Primitive* prim =
-      reinterpret_cast<const Primitive*>(args->geometryUserPtr);
+static void RTCShapeBound(const RTCBoundsFunctionArguments* args) {
+  const Shape* shape = reinterpret_cast<const Shape*>(args->geometryUserPtr);
 
-  // compute bounds
-  const Bounds3 bounds = prim->getBounds();
+  // compute bounds (local)
+  const Bounds3 bounds = shape->getBounds();
 
   // set bounds
   RTCBounds* bounds_o = args->bounds_o;
@@ -83,28 +118,103 @@ EmbreeIntersector::EmbreeIntersector() {
 }
 
 EmbreeIntersector::~EmbreeIntersector() {
-  rtcReleaseDevice(device);
+  for (RTCScene prototype : prototypes) {
+    rtcReleaseScene(prototype);
+  }
   rtcReleaseScene(scene);
+  rtcReleaseDevice(device);
 }
 
 bool EmbreeIntersector::initialize() {
-  unsigned int geom_id = 0;
+  // 作り直す場合は前回のシーンを破棄する
+  for (RTCScene prototype : prototypes) {
+    rtcReleaseScene(prototype);
+  }
+  prototypes.clear();
+  rtcReleaseScene(scene);
+  scene = rtcNewScene(device);
+  geometries.clear();
+
+  // Triangleは同じTriangleMeshとTransformを持つものごとに1つのインスタンスにまとめる
+  // mapのキーの順序はポインタに依存するので、登録順は最初に現れた順にする
+  std::vector<std::vector<Primitive*>> groups;
+  std::map<std::pair<const TriangleMesh*, const Transform*>, std::size_t>
+      mesh_group_index;
+  // Meshは1つのPrimitiveで全ての面を持つので、それだけで1つのインスタンスにする
   for (const auto& prim : primitives) {
-    // create user defined geometry
-    RTCGeometry rtc_geometry = rtcNewGeometry(device, RTC_GEOMETRY_TYPE_USER);
-    rtcSetGeometryUserPrimitiveCount(rtc_geometry, 1);
-    rtcSetGeometryUserData(rtc_geometry, prim.get());
-    rtcSetGeometryIntersectFunction(rtc_geometry, RTCUserGeometryIntersect);
-    rtcSetGeometryBoundsFunction(rtc_geometry, RTCUserGeometryBound, nullptr);
+    const auto& geometry = prim->getGeometry();
+    const Triangle* triangle =
+        dynamic_cast<const Triangle*>(geometry->getShape().get());
+    if (triangle == nullptr) {
+      groups.push_back({prim.get()});
+      continue;
+    }
 
-    rtcCommitGeometry(rtc_geometry);
+    const auto key = std::make_pair(triangle->getMesh().get(),
+                                    geometry->getTransform().get());
+    const auto it = mesh_group_index.find(key);
+    if (it == mesh_group_index.end()) {
+      mesh_group_index.emplace(key, groups.size());
+      groups.push_back({prim.get()});
+    } else {
+      groups[it->second].push_back(prim.get());
+    }
+  }
+
+  // 同じShape、同じTriangleMeshの同じ面の集合は1つのプロトタイプを共有する
+  std::map<const Shape*, RTCScene> shape_prototypes;
+  std::map<std::pair<const TriangleMesh*, std::vector<unsigned int>>, RTCScene>
+      mesh_prototypes;
+  for (const auto& prims : groups) {
+    const auto& geometry = prims.front()->getGeometry();
+    const Shape* shape = geometry->getShape().get();
+
+    GeometryEntry entry;
+    entry.localToWorld = geometry->getTransform().get();
+    entry.primitives.assign(prims.begin(), prims.end());
 
-    // set geometry id
-    rtcAttachGeometry(scene, rtc_geometry);
-    prim->setID(geom_id);
+    RTCScene prototype;
+    const Mesh* mesh = dynamic_cast<const Mesh*>(shape);
+    const Triangle* triangle = dynamic_cast<const Triangle*>(shape);
+    if (mesh != nullptr) {
+      // 全ての面を持つプロトタイプはfacesを空にして区別する
+      entry.mesh = mesh->getMesh().get();
+      auto key = std::make_pair(entry.mesh, std::vector<unsigned int>());
+      const auto it = mesh_prototypes.find(key);
+      if (it == mesh_prototypes.end()) {
+        prototype = createMeshPrototype(*key.first, key.second);
+        mesh_prototypes.emplace(std::move(key), prototype);
+      } else {
+        prototype = it->second;
+      }
+    } else if (triangle == nullptr) {
+      const auto it = shape_prototypes.find(shape);
+      if (it == shape_prototypes.end()) {
+        prototype = createShapePrototype(shape);
+        shape_prototypes.emplace(shape, prototype);
+      } else {
+        prototype = it->second;
+      }
+    } else {
+      // primIDがentry.primitivesの番号になるようにPrimitiveの順に面を並べる
+      entry.mesh = triangle->getMesh().get();
+      for (const Primitive* prim : prims) {
+        entry.faces.push_back(static_cast<const Triangle*>(
+                                  prim->getGeometry()->getShape().get())
+                                  ->getFaceIndex());
+      }
 
-    rtcReleaseGeometry(rtc_geometry);
-    geom_id++;
+      auto key = std::make_pair(entry.mesh, entry.faces);
+      const auto it = mesh_prototypes.find(key);
+      if (it == mesh_prototypes.end()) {
+        prototype = createMeshPrototype(*key.first, key.second);
+        mesh_prototypes.emplace(std::move(key), prototype);
+      } else {
+        prototype = it->second;
+      }
+    }
+
+    attachInstance(prototype, prims, std::move(entry));
   }
 
   rtcCommitScene(scene);
@@ -112,9 +222,100 @@ bool EmbreeIntersector::initialize() {
   return true;
 }
 
-bool EmbreeIntersector::intersect(const Ray& ray, IntersectInfo& info) const {
-  // init ray hit
-  RTCRayHit rayhit;
+RTCScene EmbreeIntersector::createShapePrototype(const Shape* shape) {
+  // create user defined geometry
+  RTCGeometry rtc_geometry = rtcNewGeometry(device, RTC_GEOMETRY_TYPE_USER);
+  rtcSetGeometryUserPrimitiveCount(rtc_geometry, 1);
+  rtcSetGeometryUserData(rtc_geometry, const_cast<Shape*>(shape));
+  rtcSetGeometryIntersectFunction(rtc_geometry, RTCShapeIntersect);
+  rtcSetGeometryOccludedFunction(rtc_geometry, RTCShapeOccluded);
+  rtcSetGeometryBoundsFunction(rtc_geometry, RTCShapeBound, nullptr);
+  rtcCommitGeometry(rtc_geometry);
+
+  RTCScene prototype = rtcNewScene(device);
+  rtcAttachGeometry(prototype, rtc_geometry);
+  rtcReleaseGeometry(rtc_geometry);
+  rtcCommitScene(prototype);
+
+  prototypes.push_back(prototype);
+  return prototype;
+}
+
+RTCScene EmbreeIntersector::createMeshPrototype(
+    const TriangleMesh& mesh, const std::vector<unsigned int>& faces) {
+  // EmbreeにTriangleMeshの頂点配列をそのまま読ませる
+  static_assert(std::is_same<Real, float>::value &&
+                    sizeof(Vec3) == 4 * sizeof(float),
+                "Vec3 must be usable as an Embree FLOAT3 vertex");
+
+  RTCGeometry rtc_geometry =
+      rtcNewGeometry(device, RTC_GEOMETRY_TYPE_TRIANGLE);
+
+  // 頂点バッファ
+  // ローカル座標系のまま共有し、配置はインスタンスのTransformで行う
+  rtcSetSharedGeometryBuffer(rtc_geometry, RTC_BUFFER_TYPE_VERTEX, 0,
+                             RTC_FORMAT_FLOAT3, mesh.vertices.data(), 0,
+                             sizeof(Vec3), mesh.num_vertices);
+
+  // インデックスバッファ
+  // メッシュの全ての面を順番通りに使う場合はそのまま共有する
+  bool all_faces = faces.empty() || faces.size() == mesh.num_faces;
+  for (std::size_t k = 0; all_faces && k < faces.size(); ++k) {
+    all_faces = faces[k] == k;
+  }
+  if (all_faces) {
+    rtcSetSharedGeometryBuffer(rtc_geometry, RTC_BUFFER_TYPE_INDEX, 0,
+                               RTC_FORMAT_UINT3, mesh.indices.data(), 0,
+                               3 * sizeof(unsigned int), mesh.num_faces);
+  } else {
+    unsigned int* indices = static_cast<unsigned int*>(rtcSetNewGeometryBuffer(
+        rtc_geometry, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3,
+        3 * sizeof(unsigned int), faces.size()));
+    for (std::size_t k = 0; k < faces.size(); ++k) {
+      indices[3 * k] = mesh.indices[3 * faces[k]];
+      indices[3 * k + 1] = mesh.indices[3 * faces[k] + 1];
+      indices[3 * k + 2] = mesh.indices[3 * faces[k] + 2];
+    }
+  }
+  rtcCommitGeometry(rtc_geometry);
+
+  RTCScene prototype = rtcNewScene(device);
+  rtcAttachGeometry(prototype, rtc_geometry);
+  rtcReleaseGeometry(rtc_geometry);
+  rtcCommitScene(prototype);
+
+  prototypes.push_back(prototype);
+  return prototype;
+}
+
+void EmbreeIntersector::attachInstance(RTCScene prototype,
+                                       const std::vector<Primitive*>& prims,
+                                       GeometryEntry&& entry) {
+  RTCGeometry rtc_geometry =
+      rtcNewGeometry(device, RTC_GEOMETRY_TYPE_INSTANCE);
+  rtcSetGeometryInstancedScene(rtc_geometry, prototype);
+
+  // GeometryのTransformをそのまま使う
+  // Mat4は行優先なので先頭の3行が3x4の変換行列になる
+  rtcSetGeometryTransform(rtc_geometry, 0, RTC_FORMAT_FLOAT3X4_ROW_MAJOR,
+                          &entry.localToWorld->mat.m[0][0]);
+  rtcCommitGeometry(rtc_geometry);
+
+  // set instance id
+  const unsigned int inst_id = rtcAttachGeometry(scene, rtc_geometry);
+  for (Primitive* prim : prims) {
+    prim->setID(inst_id);
+  }
+  rtcReleaseGeometry(rtc_geometry);
+
+  if (geometries.size() <= inst_id) {
+    geometries.resize(inst_id + 1);
+  }
+  geometries[inst_id] = std::move(entry);
+}
+
+// RTCRayHitをレイで初期化する
+static void initRayHit(const Ray& ray, RTCRayHit& rayhit) {
   rayhit.ray.org_x = ray.origin.x();
   rayhit.ray.org_y = ray.origin.y();
   rayhit.ray.org_z = ray.origin.z();
@@ -127,20 +328,95 @@ bool EmbreeIntersector::intersect(const Ray& ray, IntersectInfo& info) const {
   rayhit.ray.flags = 0;
   rayhit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
   rayhit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
+}
+
+bool EmbreeIntersector::setIntersectInfo(const Ray& ray,
+                                         const RTCRayHit& rayhit,
+                                         IntersectInfo& info) const {
+  if (rayhit.hit.geomID == RTC_INVALID_GEOMETRY_ID) {
+    return false;
+  }
+
+  // 全てのPrimitiveはインスタンスとして登録している
+  const GeometryEntry& entry = geometries[rayhit.hit.instID[0]];
+
+  const unsigned int prim_id = rayhit.hit.primID;
+  const unsigned int face =
+      entry.faces.empty() ? prim_id : entry.faces[prim_id];
+
+  info.t = rayhit.ray.tfar;
+  info.hitPos = ray(info.t);
+  Vec3 n_local;
+  if (entry.mesh == nullptr) {
+    // ユーザー定義ジオメトリはコールバックで法線とUVを書き込んでいる
+    n_local = Vec3(rayhit.hit.Ng_x, rayhit.hit.Ng_y, rayhit.hit.Ng_z);
+    info.uv = Vec2(rayhit.hit.u, rayhit.hit.v);
+  } else {
+    // 三角形メッシュは重心座標から法線とUVを補間する
+    entry.mesh->getShadingInfo(face, rayhit.hit.u, rayhit.hit.v, n_local,
+                               info.uv);
+  }
+  info.hitNormal = normalize(entry.localToWorld->applyNormal(n_local));
+  info.hitPrimitive = entry.primitives.size() == 1
+                          ? entry.primitives[0]
+                          : entry.primitives[prim_id];
+  info.faceID = face;
+  return true;
+}
+
+bool EmbreeIntersector::intersect(const Ray& ray, IntersectInfo& info) const {
+  // init ray hit
+  RTCRayHit rayhit;
+  initRayHit(ray, rayhit);
 
   // intersect
   RTCIntersectContext context;
+  rtcInitIntersectContext(&context);
   rtcIntersect1(scene, &context, &rayhit);
 
-  if (rayhit.hit.geomID != RTC_INVALID_GEOMETRY_ID) {
-    info.t = rayhit.ray.tfar;
-    info.hitPos = ray(info.t);
-    info.hitNormal = Vec3(rayhit.hit.Ng_x, rayhit.hit.Ng_y, rayhit.hit.Ng_z);
-    info.uv = Vec2(rayhit.hit.u, rayhit.hit.v);
-    info.hitPrimitive = primitives[rayhit.hit.geomID].get();
-    return true;
-  } else {
-    return false;
+  return setIntersectInfo(ray, rayhit, info);
+}
+
+bool EmbreeIntersector::occluded(const Ray& ray, const Real& tmax) const {
+  // init ray
+  RTCRay rtc_ray;
+  rtc_ray.org_x = ray.origin.x();
+  rtc_ray.org_y = ray.origin.y();
+  rtc_ray.org_z = ray.origin.z();
+  rtc_ray.dir_x = ray.direction.x();
+  rtc_ray.dir_y = ray.direction.y();
+  rtc_ray.dir_z = ray.direction.z();
+  rtc_ray.tnear = ray.tmin;
+  rtc_ray.tfar = tmax;
+  rtc_ray.mask = 0;
+  rtc_ray.flags = 0;
+
+  // occluded
+  // 衝突した場合はtfarが-infになる
+  RTCIntersectContext context;
+  rtcInitIntersectContext(&context);
+  rtcOccluded1(scene, &context, &rtc_ray);
+
+  return rtc_ray.tfar < 0;
+}
+
+void EmbreeIntersector::intersectBatch(unsigned int n, const Ray* rays,
+                                       IntersectInfo* infos) const {
+  // RTCRayHitの配列はスレッドごとに使い回す
+  thread_local std::vector<RTCRayHit> rayhits;
+  rayhits.resize(n);
+  for (unsigned int k = 0; k < n; ++k) {
+    initRayHit(rays[k], rayhits[k]);
+  }
+
+  // intersect
+  RTCIntersectContext context;
+  rtcInitIntersectContext(&context);
+  rtcIntersect1M(scene, &context, rayhits.data(), n, sizeof(RTCRayHit));
+
+  for (unsigned int k = 0; k < n; ++k) {
+    infos[k] = IntersectInfo();
+    setIntersectInfo(rays[k], rayhits[k], infos[k]);
   }
 }
 
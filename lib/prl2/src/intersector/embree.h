@@ -2,10 +2,22 @@
 #define _PRL2_EMBREE_H
 #include "intersector/intersector.h"
 
+#include <vector>
+
 #include "embree3/rtcore.h"
+#include "shape/mesh.h"
+#include "shape/triangle.h"
 
 namespace Prl2 {
 
+// Embreeを使って衝突計算を行うクラス
+// 全てのPrimitiveはGeometryのTransformを使ったRTC_GEOMETRY_TYPE_INSTANCEとして登録し、
+// Shapeはローカル座標系のプロトタイプのシーンとして一度だけ作成する
+// Meshのプロトタイプは、TriangleMeshの頂点配列とインデックス配列を共有する
+// RTC_GEOMETRY_TYPE_TRIANGLEにする
+// 同じTriangleMeshとTransformを持つTriangleのPrimitiveは1つのインスタンスにまとめ、
+// 使われている面だけを持つRTC_GEOMETRY_TYPE_TRIANGLEをプロトタイプにする
+// それ以外のShapeのプロトタイプはRTC_GEOMETRY_TYPE_USERにする
 class EmbreeIntersector : public Intersector {
  public:
   EmbreeIntersector();
@@ -14,9 +26,48 @@ class EmbreeIntersector : public Intersector {
   virtual bool initialize() override;
   virtual bool intersect(const Ray& ray, IntersectInfo& info) const override;
 
+  // rtcOccluded1で衝突判定を行う
+  virtual bool occluded(const Ray& ray, const Real& tmax) const override;
+
+  // rtcIntersect1Mでまとめて衝突計算を行う
+  virtual void intersectBatch(unsigned int n, const Ray* rays,
+                              IntersectInfo* infos) const override;
+
  private:
   RTCDevice device;
   RTCScene scene;
+
+  std::vector<RTCScene> prototypes;  // インスタンスから参照するシーン
+
+  // インスタンスごとの情報
+  // primitivesが1つの場合は全てのprimIDがそのPrimitiveに対応する
+  // meshがnullptrの場合はユーザー定義ジオメトリ
+  // facesが空の場合はprimIDがそのまま面のインデックスになる
+  struct GeometryEntry {
+    const Transform* localToWorld;  // インスタンスのTransform
+    std::vector<const Primitive*> primitives;  // primIDごとのPrimitive
+    const TriangleMesh* mesh = nullptr;        // 三角形メッシュ
+    std::vector<unsigned int> faces;           // primIDごとの面のインデックス
+  };
+  std::vector<GeometryEntry> geometries;  // instIDごとの情報
+
+  // ShapeをRTC_GEOMETRY_TYPE_USERとして持つプロトタイプを作成する
+  RTCScene createShapePrototype(const Shape* shape);
+
+  // TriangleMeshのfacesの面をRTC_GEOMETRY_TYPE_TRIANGLEとして持つ
+  // プロトタイプを作成する
+  // facesが空の場合は全ての面を順番通りに持つ
+  RTCScene createMeshPrototype(const TriangleMesh& mesh,
+                               const std::vector<unsigned int>& faces);
+
+  // プロトタイプをentry.localToWorldで配置するインスタンスを作成する
+  void attachInstance(RTCScene prototype, const std::vector<Primitive*>& prims,
+                      GeometryEntry&& entry);
+
+  // RTCRayHitの結果をIntersectInfoに書き込む
+  // 衝突していない場合はfalseを返す
+  bool setIntersectInfo(const Ray& ray, const RTCRayHit& rayhit,
+                        IntersectInfo& info) const;
 };
 
 }  // namespace Prl2
@@ -24,6 +24,21 @@ class Intersector {
   //与えられたレイとの衝突計算を行う
   virtual bool intersect(const Ray& ray, IntersectInfo& info) const = 0;
 
+  // 与えられたレイがtmaxまでに何かに衝突するかだけを判定する
+  // 最も近い衝突を探す必要がないので、シャドウレイなどではintersectより速い
+  virtual bool occluded(const Ray& ray, const Real& tmax) const = 0;
+
+  // n本のレイとの衝突計算をまとめて行う
+  // 衝突しなかったレイのinfos[k].hitPrimitiveはnullptrになる
+  // 既定では1本ずつintersectを呼ぶ
+  virtual void intersectBatch(unsigned int n, const Ray* rays,
+                              IntersectInfo* infos) const {
+    for (unsigned int k = 0; k < n; ++k) {
+      infos[k] = IntersectInfo();
+      intersect(rays[k], infos[k]);
+    }
+  };
+
  protected:
   std::vector<std::shared_ptr<Primitive>> primitives;  // Primitiveの配列
 };
@@ -30,6 +30,16 @@ class LinearIntersector : public Intersector {
 
     return hit;
   };
+
+  bool occluded(const Ray& ray, const Real& tmax) const override {
+    //どれか1つと衝突した時点で打ち切る
+    for (const auto& prim : primitives) {
+      if (prim->occluded(ray, tmax)) {
+        return true;
+      }
+    }
+    return false;
+  };
 };
 
 }  // namespace Prl2
@@ -0,0 +1,66 @@
+#include "io/image-writer.h"
+
+#include <utility>
+
+namespace Prl2 {
+
+ImageWriter::~ImageWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  cond.notify_all();
+  if (worker.joinable()) {
+    worker.join();
+  }
+}
+
+void ImageWriter::enqueue(Job job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(std::move(job));
+
+    // スレッドは最初の書き出しで起動する
+    if (!worker.joinable()) {
+      worker = std::thread([this]() { run(); });
+    }
+  }
+  cond.notify_all();
+}
+
+void ImageWriter::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock, [this]() { return jobs.empty() && !running; });
+}
+
+bool ImageWriter::isBusy() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return !jobs.empty() || running;
+}
+
+void ImageWriter::run() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [this]() { return stop || !jobs.empty(); });
+      // 終了する場合も積まれた処理は全て書き出す
+      if (jobs.empty()) {
+        break;
+      }
+      job = std::move(jobs.front());
+      jobs.pop_front();
+      running = true;
+    }
+
+    job();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      running = false;
+    }
+    cond.notify_all();
+  }
+}
+
+}  // namespace Prl2
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef _PRL2_IMAGE_WRITER_H
+#define _PRL2_IMAGE_WRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace Prl2 {
+
+// 画像の書き出しを専用のスレッドで行うクラス
+// 呼び出し側は書き出す処理を積んだらすぐに戻る
+// 積まれた処理は積まれた順に1つずつ実行する
+// 破棄する時は残っている処理を全て終えてからスレッドを終了する
+class ImageWriter {
+ public:
+  // 書き出す処理
+  // 書き出す画像は処理の中に持たせる(呼び出し側のバッファを参照しない)
+  using Job = std::function<void()>;
+
+  ImageWriter(){};
+  ~ImageWriter();
+
+  ImageWriter(const ImageWriter&) = delete;
+  ImageWriter& operator=(const ImageWriter&) = delete;
+
+  // 書き出す処理を積む
+  void enqueue(Job job);
+
+  // 積まれた処理が全て終わるまで待つ
+  void wait();
+
+  // 書き出し中、または書き出し待ちの処理があるか
+  bool isBusy() const;
+
+ private:
+  mutable std::mutex mutex;
+  std::condition_variable cond;
+  std::thread worker;    // 書き出しを行うスレッド
+  std::deque<Job> jobs;  // 書き出し待ちの処理
+  bool running = false;  // 処理を実行中か
+  bool stop = false;     // スレッドを終了するか
+
+  // 専用のスレッドで実行するループ
+  void run();
+};
+
+}  // namespace Prl2
+
+#endif
\ No newline at end of file
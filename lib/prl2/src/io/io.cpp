@@ -1,6 +1,7 @@
 #include "io/io.h"
 
 #include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
@@ -9,56 +10,81 @@
 
 namespace Prl2 {
 
-void writePPM(const std::string& filename, size_t width, size_t height,
-              const std::vector<float>& rgb) {
-  std::ofstream file(filename);
-
-  file << "P3" << std::endl;
-  file << width << " " << height << std::endl;
-  file << "255" << std::endl;
-
-  for (size_t j = 0; j < height; ++j) {
-    for (size_t i = 0; i < width; ++i) {
-      const int r = std::clamp(
-          static_cast<int>(255 * rgb[3 * i + 3 * width * j + 0]), 0, 255);
-      const int g = std::clamp(
-          static_cast<int>(255 * rgb[3 * i + 3 * width * j + 1]), 0, 255);
-      const int b = std::clamp(
-          static_cast<int>(255 * rgb[3 * i + 3 * width * j + 2]), 0, 255);
-      file << r << " " << g << " " << b << std::endl;
-    }
+namespace {
+
+// [0, 1]の値を0-255に直す(NaNは0にする)
+inline unsigned char toByte(float v) {
+  const float c = v > 0 ? (v < 1 ? v : 1) : 0;
+  return static_cast<unsigned char>(255 * c);
+}
+
+// j行目のRGBを0-255にしてdstに書き込む
+void convertRowToBytes(const ImageView& image, std::size_t j,
+                       unsigned char* dst) {
+  const float* src = image.row(j);
+  for (std::size_t i = 0; i < image.width; ++i) {
+    dst[3 * i + 0] = toByte(src[image.pixel_stride * i + 0]);
+    dst[3 * i + 1] = toByte(src[image.pixel_stride * i + 1]);
+    dst[3 * i + 2] = toByte(src[image.pixel_stride * i + 2]);
   }
+}
 
-  std::cout << filename << " has been written out" << std::endl;
+// j行目のRGBを隙間なく並べてdstに書き込む
+void copyRow(const ImageView& image, std::size_t j, float* dst) {
+  const float* src = image.row(j);
+  for (std::size_t i = 0; i < image.width; ++i) {
+    dst[3 * i + 0] = src[image.pixel_stride * i + 0];
+    dst[3 * i + 1] = src[image.pixel_stride * i + 1];
+    dst[3 * i + 2] = src[image.pixel_stride * i + 2];
+  }
+}
 
-  file.close();
+// tinyexrの圧縮方式
+int toTinyEXRCompression(EXRCompression compression) {
+  switch (compression) {
+    case EXRCompression::None:
+      return TINYEXR_COMPRESSIONTYPE_NONE;
+    case EXRCompression::RLE:
+      return TINYEXR_COMPRESSIONTYPE_RLE;
+    case EXRCompression::ZIPS:
+      return TINYEXR_COMPRESSIONTYPE_ZIPS;
+    case EXRCompression::PIZ:
+      return TINYEXR_COMPRESSIONTYPE_PIZ;
+    default:
+      return TINYEXR_COMPRESSIONTYPE_ZIP;
+  }
+}
+
+}  // namespace
+
+void writePPM(const std::string& filename, const ImageView& image) {
+  std::ofstream file(filename, std::ios::binary);
+  file << "P6\n" << image.width << " " << image.height << "\n255\n";
+
+  // 1行ずつ変換してまとめて書き込む
+  std::vector<unsigned char> row(3 * image.width);
+  for (std::size_t j = 0; j < image.height; ++j) {
+    convertRowToBytes(image, j, row.data());
+    file.write(reinterpret_cast<const char*>(row.data()),
+               static_cast<std::streamsize>(row.size()));
+  }
+
+  if (!file) {
+    std::cerr << "Failed to save PPM file" << std::endl;
+    return;
+  }
+  std::cout << filename << " has been written out" << std::endl;
 }
 
-void writePNG(const std::string& filename, size_t width, size_t height,
-              const std::vector<float>& rgb) {
+void writePNG(const std::string& filename, const ImageView& image) {
   // RGBを0-255に直す
-  std::vector<unsigned char> image(3 * width * height);
-  for (size_t j = 0; j < height; ++j) {
-    for (size_t i = 0; i < width; ++i) {
-      // R
-      image[3 * i + 3 * width * j] = std::clamp(
-          static_cast<unsigned char>(255 * rgb[3 * i + 3 * width * j]),
-          static_cast<unsigned char>(0), static_cast<unsigned char>(255));
-
-      // G
-      image[3 * i + 3 * width * j + 1] = std::clamp(
-          static_cast<unsigned char>(255 * rgb[3 * i + 3 * width * j + 1]),
-          static_cast<unsigned char>(0), static_cast<unsigned char>(255));
-
-      // B
-      image[3 * i + 3 * width * j + 2] = std::clamp(
-          static_cast<unsigned char>(255 * rgb[3 * i + 3 * width * j + 2]),
-          static_cast<unsigned char>(0), static_cast<unsigned char>(255));
-    }
+  std::vector<unsigned char> bytes(3 * image.width * image.height);
+  for (std::size_t j = 0; j < image.height; ++j) {
+    convertRowToBytes(image, j, bytes.data() + 3 * image.width * j);
   }
 
-  if (!stbi_write_png(filename.c_str(), width, height, 3, image.data(),
-                      3 * sizeof(unsigned char) * width)) {
+  if (!stbi_write_png(filename.c_str(), image.width, image.height, 3,
+                      bytes.data(), 3 * sizeof(unsigned char) * image.width)) {
     std::cerr << "Failed to save PNG file" << std::endl;
   } else {
     std::cout << "Saved PNG file [" << filename << "]" << std::endl;
@@ -66,35 +92,36 @@ void writePNG(const std::string& filename, size_t width, size_t height,
 }
 
 // https://github.com/syoyo/tinyexr
-void writeEXR(const std::string& filename, size_t width, size_t height,
-              const std::vector<float>& rgb) {
+void writeEXR(const std::string& filename, const ImageView& image) {
   EXRHeader header;
   InitEXRHeader(&header);
 
-  EXRImage image;
-  InitEXRImage(&image);
+  EXRImage exr_image;
+  InitEXRImage(&exr_image);
 
-  image.num_channels = 3;
-
-  std::vector<float> images[3];
-  images[0].resize(width * height);
-  images[1].resize(width * height);
-  images[2].resize(width * height);
-
-  for (size_t i = 0; i < width * height; ++i) {
-    images[0][i] = rgb[3 * i + 0];
-    images[1][i] = rgb[3 * i + 1];
-    images[2][i] = rgb[3 * i + 2];
-  }
+  exr_image.num_channels = 3;
 
+  // tinyexrはチャンネルごとに分かれた配列を要求するので、
+  // 1つのバッファをB, G, Rの順に3つに区切って並べ替える
+  const std::size_t num_pixels = image.width * image.height;
+  std::vector<float> planes(3 * num_pixels);
   float* image_ptr[3];
-  image_ptr[0] = &(images[2].at(0));
-  image_ptr[1] = &(images[1].at(0));
-  image_ptr[2] = &(images[0].at(0));
+  image_ptr[0] = planes.data();
+  image_ptr[1] = planes.data() + num_pixels;
+  image_ptr[2] = planes.data() + 2 * num_pixels;
+  for (std::size_t j = 0; j < image.height; ++j) {
+    const float* src = image.row(j);
+    for (std::size_t i = 0; i < image.width; ++i) {
+      const std::size_t index = i + image.width * j;
+      image_ptr[0][index] = src[image.pixel_stride * i + 2];
+      image_ptr[1][index] = src[image.pixel_stride * i + 1];
+      image_ptr[2][index] = src[image.pixel_stride * i + 0];
+    }
+  }
 
-  image.images = reinterpret_cast<unsigned char**>(image_ptr);
-  image.width = width;
-  image.height = height;
+  exr_image.images = reinterpret_cast<unsigned char**>(image_ptr);
+  exr_image.width = image.width;
+  exr_image.height = image.height;
 
   header.num_channels = 3;
   header.channels = new EXRChannelInfo[header.num_channels];
@@ -113,52 +140,206 @@ void writeEXR(const std::string& filename, size_t width, size_t height,
   }
 
   const char* err = nullptr;
-  int ret = SaveEXRImageToFile(&image, &header, filename.c_str(), &err);
+  int ret = SaveEXRImageToFile(&exr_image, &header, filename.c_str(), &err);
+  delete[] header.channels;
+  delete[] header.pixel_types;
+  delete[] header.requested_pixel_types;
   if (ret != TINYEXR_SUCCESS) {
     fprintf(stderr, "Save EXR error: %s\n", err);
     FreeEXRErrorMessage(err);
     return;
   }
   printf("Saved EXR file. [%s] \n", filename.c_str());
+}
 
-  delete[] header.channels;
-  delete[] header.pixel_types;
-  delete[] header.requested_pixel_types;
+bool writeMultiLayerEXR(const std::string& filename,
+                        const std::vector<EXRLayer>& layers,
+                        const EXROptions& options) {
+  if (layers.empty()) {
+    std::cerr << "No layers to save" << std::endl;
+    return false;
+  }
+  const std::size_t width = layers.front().image.width;
+  const std::size_t height = layers.front().image.height;
+
+  // 書き出すチャンネル
+  struct Channel {
+    std::string name;       // チャンネル名
+    const EXRLayer* layer;  // 値を持つレイヤー
+    std::size_t index;      // 画素の中での位置
+  };
+  std::vector<Channel> channels;
+  for (const auto& layer : layers) {
+    if (layer.image.width != width || layer.image.height != height ||
+        layer.channels.size() > layer.image.pixel_stride) {
+      std::cerr << "Invalid EXR layer: " << layer.name << std::endl;
+      return false;
+    }
+    for (std::size_t c = 0; c < layer.channels.size(); ++c) {
+      const std::string name = layer.name.empty()
+                                   ? layer.channels[c]
+                                   : layer.name + "." + layer.channels[c];
+      channels.push_back({name, &layer, c});
+    }
+  }
+
+  // OpenEXRはチャンネルが名前順に並んでいることを前提にしている
+  std::sort(channels.begin(), channels.end(),
+            [](const Channel& a, const Channel& b) { return a.name < b.name; });
+  const std::size_t num_channels = channels.size();
+
+  EXRHeader header;
+  InitEXRHeader(&header);
+  std::vector<EXRChannelInfo> channel_infos(num_channels);
+  std::vector<int> pixel_types(num_channels, TINYEXR_PIXELTYPE_FLOAT);
+  std::vector<int> requested_pixel_types(num_channels);
+  for (std::size_t c = 0; c < num_channels; ++c) {
+    std::memset(&channel_infos[c], 0, sizeof(EXRChannelInfo));
+    strncpy(channel_infos[c].name, channels[c].name.c_str(), 255);
+    requested_pixel_types[c] = channels[c].layer->half
+                                   ? TINYEXR_PIXELTYPE_HALF
+                                   : TINYEXR_PIXELTYPE_FLOAT;
+  }
+  header.num_channels = num_channels;
+  header.channels = channel_infos.data();
+  header.pixel_types = pixel_types.data();
+  header.requested_pixel_types = requested_pixel_types.data();
+  header.compression_type = toTinyEXRCompression(options.compression);
+
+  EXRImage exr_image;
+  InitEXRImage(&exr_image);
+  exr_image.num_channels = num_channels;
+  exr_image.width = width;
+  exr_image.height = height;
+
+  // c番目のチャンネルの画素(i, j)の値
+  const auto value = [&](std::size_t c, std::size_t i, std::size_t j) {
+    const ImageView& image = channels[c].layer->image;
+    return image.row(j)[image.pixel_stride * i + channels[c].index];
+  };
+
+  // tinyexrはチャンネルごとに分かれた配列を要求するので、
+  // 1つのバッファをチャンネル(タイルの場合はタイルとチャンネル)ごとに区切って並べ替える
+  std::vector<float> buffer;
+  std::vector<float*> image_ptr;
+  std::vector<EXRTile> tiles;
+  if (options.tile_size == 0) {
+    buffer.resize(num_channels * width * height);
+    image_ptr.resize(num_channels);
+    for (std::size_t c = 0; c < num_channels; ++c) {
+      image_ptr[c] = buffer.data() + c * width * height;
+      for (std::size_t j = 0; j < height; ++j) {
+        for (std::size_t i = 0; i < width; ++i) {
+          image_ptr[c][i + width * j] = value(c, i, j);
+        }
+      }
+    }
+    exr_image.images = reinterpret_cast<unsigned char**>(image_ptr.data());
+  } else {
+    // タイルは画像より大きくできない
+    const std::size_t tile_x = std::min<std::size_t>(options.tile_size, width);
+    const std::size_t tile_y =
+        std::min<std::size_t>(options.tile_size, height);
+    const std::size_t num_tiles_x = (width + tile_x - 1) / tile_x;
+    const std::size_t num_tiles_y = (height + tile_y - 1) / tile_y;
+    const std::size_t num_tiles = num_tiles_x * num_tiles_y;
+    header.tiled = 1;
+    header.tile_size_x = tile_x;
+    header.tile_size_y = tile_y;
+    header.tile_level_mode = TINYEXR_TILE_ONE_LEVEL;
+    header.tile_rounding_mode = TINYEXR_TILE_ROUND_DOWN;
+
+    // 端のタイルも一辺tile_x, tile_yの配列に左上から詰める
+    const std::size_t tile_area = tile_x * tile_y;
+    buffer.resize(num_tiles * num_channels * tile_area);
+    image_ptr.resize(num_tiles * num_channels);
+    tiles.resize(num_tiles);
+    for (std::size_t t = 0; t < num_tiles; ++t) {
+      const std::size_t tx = t % num_tiles_x;
+      const std::size_t ty = t / num_tiles_x;
+      EXRTile& tile = tiles[t];
+      tile.offset_x = tx;
+      tile.offset_y = ty;
+      tile.level_x = 0;
+      tile.level_y = 0;
+      const std::size_t tile_width = std::min(tile_x, width - tile_x * tx);
+      const std::size_t tile_height = std::min(tile_y, height - tile_y * ty);
+      tile.width = tile_width;
+      tile.height = tile_height;
+      tile.images = reinterpret_cast<unsigned char**>(image_ptr.data() +
+                                                      num_channels * t);
+      for (std::size_t c = 0; c < num_channels; ++c) {
+        float* dst = buffer.data() + (num_channels * t + c) * tile_area;
+        image_ptr[num_channels * t + c] = dst;
+        for (std::size_t y = 0; y < tile_height; ++y) {
+          for (std::size_t x = 0; x < tile_width; ++x) {
+            dst[x + tile_x * y] =
+                value(c, tile_x * tx + x, tile_y * ty + y);
+          }
+        }
+      }
+    }
+    exr_image.tiles = tiles.data();
+    exr_image.num_tiles = num_tiles;
+  }
+
+  const char* err = nullptr;
+  const int ret =
+      SaveEXRImageToFile(&exr_image, &header, filename.c_str(), &err);
+  if (ret != TINYEXR_SUCCESS) {
+    fprintf(stderr, "Save EXR error: %s\n", err);
+    FreeEXRErrorMessage(err);
+    return false;
+  }
+  printf("Saved EXR file. [%s] \n", filename.c_str());
+  return true;
 }
 
-void writeHDR(const std::string& filename, size_t width, size_t height,
-              const std::vector<float>& rgb) {
-  if (!stbi_write_hdr(filename.c_str(), width, height, 3, rgb.data())) {
+void writeHDR(const std::string& filename, const ImageView& image) {
+  // stbi_write_hdrは隙間なく並んだ画像しか扱えないので、その場合だけ詰め直す
+  std::vector<float> packed;
+  const float* data = image.data;
+  if (!image.isPacked()) {
+    packed.resize(3 * image.width * image.height);
+    for (std::size_t j = 0; j < image.height; ++j) {
+      copyRow(image, j, packed.data() + 3 * image.width * j);
+    }
+    data = packed.data();
+  }
+
+  if (!stbi_write_hdr(filename.c_str(), image.width, image.height, 3, data)) {
     std::cerr << "Failed to save HDR file" << std::endl;
   } else {
     std::cout << "Saved HDR file [" << filename << "]" << std::endl;
   }
 }
 
-void writePFM(const std::string& filename, size_t width, size_t height,
-              const std::vector<float>& rgb) {
-  // 逆さにした画像を生成
-  std::vector<float> image(3 * width * height);
-  for (size_t j = 0; j < height; ++j) {
-    const size_t j2 = height - (j + 1);
-    for (size_t i = 0; i < width; ++i) {
-      image[3 * i + 3 * width * j] = rgb[3 * i + 3 * width * j2];
-      image[3 * i + 3 * width * j + 1] = rgb[3 * i + 3 * width * j2 + 1];
-      image[3 * i + 3 * width * j + 2] = rgb[3 * i + 3 * width * j2 + 2];
+void writePFM(const std::string& filename, const ImageView& image) {
+  std::ofstream file(filename, std::ios::binary);
+  file << "PF\n" << image.width << " " << image.height << "\n-1.0\n";
+
+  // PFMは下の行から並べるので、逆順に1行ずつ書き込む
+  // 行の中で画素が隙間なく並んでいればコピーせずに書き込む
+  std::vector<float> row;
+  if (!image.isRowPacked()) {
+    row.resize(3 * image.width);
+  }
+  const auto row_bytes =
+      static_cast<std::streamsize>(3 * sizeof(float) * image.width);
+  for (std::size_t j = image.height; j-- > 0;) {
+    const float* src = image.row(j);
+    if (!image.isRowPacked()) {
+      copyRow(image, j, row.data());
+      src = row.data();
     }
+    file.write(reinterpret_cast<const char*>(src), row_bytes);
   }
 
-  // PFMの生成
-  std::ofstream file(filename, std::ios::binary);
-  file << "PF" << std::endl;
-  file << width << " " << height << std::endl;
-  file << "-1.0" << std::endl;
-  file.write(reinterpret_cast<const char*>(image.data()),
-             static_cast<std::streamsize>(sizeof(float) * image.size()));
-
+  if (!file) {
+    std::cerr << "Failed to save PFM file" << std::endl;
+    return;
+  }
   std::cout << filename << " has been written out" << std::endl;
-
-  file.close();
 }
 
 }  // namespace Prl2
\ No newline at end of file
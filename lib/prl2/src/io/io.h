@@ -1,30 +1,91 @@
 #ifndef _PRL2_IO_H
 #define _PRL2_IO_H
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
 namespace Prl2 {
 
-// RGBの配列からPPM画像を保存する
-void writePPM(const std::string& filename, size_t width, size_t height,
-              const std::vector<float>& rgb);
+// 書き出すRGB画像を参照するビュー
+// 画素(i, j)のRGBはdata[pixel_stride * i + row_stride * j + (0, 1, 2)]
+// レイヤーのバッファをコピーせずにそのまま書き出すために使う
+struct ImageView {
+  const float* data;         // 先頭の画素
+  std::size_t width;         // 横幅
+  std::size_t height;        // 縦幅
+  std::size_t pixel_stride;  // 隣の画素までの要素数
+  std::size_t row_stride;    // 次の行までの要素数
 
-// RGBの配列からPNG画像を保存する
-void writePNG(const std::string& filename, size_t width, size_t height,
-              const std::vector<float>& rgb);
+  // RGBが隙間なく並んだ画像
+  ImageView(const float* _data, std::size_t _width, std::size_t _height)
+      : ImageView(_data, _width, _height, 3, 3 * _width){};
 
-// RGBの配列からEXR画像を保存する
-void writeEXR(const std::string& filename, size_t width, size_t height,
-              const std::vector<float>& rgb);
+  ImageView(const float* _data, std::size_t _width, std::size_t _height,
+            std::size_t _pixel_stride, std::size_t _row_stride)
+      : data(_data),
+        width(_width),
+        height(_height),
+        pixel_stride(_pixel_stride),
+        row_stride(_row_stride){};
 
-// RGBの配列からHDR画像を保存する
-void writeHDR(const std::string& filename, size_t width, size_t height,
-              const std::vector<float>& rgb);
+  // RGBが隙間なく並んだ画像
+  ImageView(const std::vector<float>& rgb, std::size_t _width,
+            std::size_t _height)
+      : ImageView(rgb.data(), _width, _height){};
 
-// RGBの配列からPFM画像を保存する
-void writePFM(const std::string& filename, size_t width, size_t height,
-              const std::vector<float>& rgb);
+  // j行目の先頭の画素
+  const float* row(std::size_t j) const { return data + row_stride * j; };
+
+  // 行の中で画素が隙間なく並んでいるか
+  bool isRowPacked() const { return pixel_stride == 3; };
+
+  // 画像全体で画素が隙間なく並んでいるか
+  bool isPacked() const {
+    return isRowPacked() && row_stride == 3 * width;
+  };
+};
+
+// RGBの画像からバイナリ(P6)のPPM画像を保存する
+void writePPM(const std::string& filename, const ImageView& image);
+
+// RGBの画像からPNG画像を保存する
+void writePNG(const std::string& filename, const ImageView& image);
+
+// RGBの画像からEXR画像を保存する
+void writeEXR(const std::string& filename, const ImageView& image);
+
+// EXRの圧縮方式
+enum class EXRCompression { None, RLE, ZIPS, ZIP, PIZ };
+
+// 1つのEXRにまとめて書き出すレイヤー
+// チャンネル名は"レイヤー名.チャンネル名"(レイヤー名が空ならチャンネル名のみ)
+// channels[c]にはimageの各画素のc番目の値を書き出す
+struct EXRLayer {
+  std::string name;                   // レイヤー名
+  std::vector<std::string> channels;  // チャンネル名
+  ImageView image;                    // 画素の値
+  bool half;                          // HALFで保存するか(falseならFLOAT)
+};
+
+// EXRの書き出しの設定
+struct EXROptions {
+  EXRCompression compression = EXRCompression::ZIP;  // 圧縮方式
+  unsigned int tile_size = 64;  // タイルの一辺の長さ[px](0ならスキャンライン)
+};
+
+// 複数のレイヤーを1つのEXR画像の別々のチャンネルとしてまとめて保存する
+// 全てのレイヤーは同じサイズである必要がある
+// タイルの圧縮はtinyexrが複数のスレッドで行う
+bool writeMultiLayerEXR(const std::string& filename,
+                        const std::vector<EXRLayer>& layers,
+                        const EXROptions& options);
+
+// RGBの画像からHDR画像を保存する
+void writeHDR(const std::string& filename, const ImageView& image);
+
+// RGBの画像からPFM画像を保存する
+void writePFM(const std::string& filename, const ImageView& image);
 
 }  // namespace Prl2
 
@@ -0,0 +1,89 @@
+#include "io/mapped-file.h"
+
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PRL2_HAS_MMAP
+#endif
+
+namespace Prl2 {
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const std::string& filename) {
+  close();
+
+#ifdef PRL2_HAS_MMAP
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    return false;
+  }
+  length = static_cast<std::size_t>(st.st_size);
+
+  // 空のファイルはマップできないので、マップせずに空として扱う
+  if (length > 0) {
+    void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      // 先頭から順に読むことをカーネルに伝えて先読みさせる
+      madvise(p, length, MADV_SEQUENTIAL);
+      ptr = static_cast<const char*>(p);
+      mapped = true;
+    }
+  }
+
+  // マップした後はファイルディスクリプタは不要
+  ::close(fd);
+  if (mapped || length == 0) {
+    return true;
+  }
+
+  // マップできないファイル(対応していないファイルシステムなど)は読み込む
+  length = 0;
+#endif
+  return readFile(filename);
+}
+
+bool MappedFile::readFile(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return false;
+  }
+  const std::streamoff size = file.tellg();
+  if (size < 0) {
+    return false;
+  }
+  file.seekg(0);
+  buffer.resize(static_cast<std::size_t>(size));
+  file.read(buffer.data(), static_cast<std::streamsize>(size));
+  if (!file) {
+    buffer.clear();
+    return false;
+  }
+  ptr = buffer.data();
+  length = buffer.size();
+  return true;
+}
+
+void MappedFile::close() {
+#ifdef PRL2_HAS_MMAP
+  if (mapped) {
+    munmap(const_cast<char*>(ptr), length);
+  }
+#endif
+  buffer.clear();
+  ptr = nullptr;
+  length = 0;
+  mapped = false;
+}
+
+}  // namespace Prl2
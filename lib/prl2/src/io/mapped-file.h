@@ -0,0 +1,44 @@
+#ifndef _PRL2_MAPPED_FILE_H
+#define _PRL2_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Prl2 {
+
+// ファイルを読み取り専用でメモリにマップするクラス
+// ファイルの内容をコピーせずにそのまま参照できる
+// mmapが使えない環境やマップに失敗した場合はファイル全体をメモリに読み込む
+class MappedFile {
+ public:
+  MappedFile() : ptr(nullptr), length(0){};
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // ファイルをマップする
+  // 開けなかった場合はfalseを返す
+  bool open(const std::string& filename);
+
+  // マップを解除する
+  void close();
+
+  const char* data() const { return ptr; };
+  std::size_t size() const { return length; };
+
+ private:
+  const char* ptr;      // ファイルの先頭
+  std::size_t length;   // ファイルのバイト数
+  bool mapped = false;  // mmapでマップしているか
+
+  std::vector<char> buffer;  // mmapが使えない場合に読み込む領域
+
+  // ファイル全体をbufferに読み込む
+  bool readFile(const std::string& filename);
+};
+
+}  // namespace Prl2
+
+#endif
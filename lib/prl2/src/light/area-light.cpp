@@ -6,25 +6,61 @@ AreaLight::AreaLight(const SPD& _spd,
                      const std::shared_ptr<Geometry>& _geometry)
     : Light(_spd), geometry(_geometry) {}
 
-Real AreaLight::Le(const Ray& ray, const IntersectInfo& info) const {
+SampledSpectrum AreaLight::Le(const Ray& ray, const IntersectInfo& info,
+                              const SampledWavelengths& lambda) const {
   if (dot(-ray.direction, info.hitNormal) > 0) {
-    return spd.sample(ray.lambda);
+    return spd.sample(lambda);
   } else {
-    return 0;
+    return SampledSpectrum(0);
   }
 }
 
 void AreaLight::samplePoint(const IntersectInfo& info, Sampler& sampler,
-                            Vec3& p, Real& pdf) const {
+                            Vec3& p, Vec3& n, Real& pdf) const {
   // 点をサンプリング
-  Vec3 n;
   Real pdf_area;
   geometry->samplePoint(sampler, p, n, pdf_area);
 
+  pdf = toSolidAnglePdf(info, p, n, pdf_area);
+}
+
+void AreaLight::sampleFace(unsigned int face, const IntersectInfo& info,
+                           Sampler& sampler, Vec3& p, Vec3& n,
+                           Real& pdf) const {
+  Real pdf_area;
+  geometry->sampleFace(face, sampler, p, n, pdf_area);
+
+  pdf = toSolidAnglePdf(info, p, n, pdf_area);
+}
+
+Real AreaLight::getPower() const {
+  return PI * integrateRadiance() * geometry->getArea();
+}
+
+LightBounds AreaLight::getLightBounds(unsigned int face) const {
+  LightBounds ret;
+  ret.bounds = geometry->getFaceBounds(face);
+  ret.phi = PI * integrateRadiance() * geometry->getFaceArea(face);
+  ret.cone = geometry->getFaceNormalCone(face);
+  ret.cos_theta_e = 0;
+  ret.two_sided = false;
+  return ret;
+}
+
+Real AreaLight::integrateRadiance() const {
+  Real radiance = 0;
+  for (std::size_t i = 0; i < SPD::LAMBDA_SAMPLES; ++i) {
+    radiance += spd.phi[i];
+  }
+  return radiance * SPD::LAMBDA_INTERVAL;
+}
+
+Real AreaLight::toSolidAnglePdf(const IntersectInfo& info, const Vec3& p,
+                                const Vec3& n, const Real& pdf_area) {
   // 面積に関するpdfを立体角に関するpdfに変換
   const Real r_2 = length2(p - info.hitPos);
   const Real cos = std::abs(dot(normalize(info.hitPos - p), n));
-  pdf = r_2 / cos * pdf_area;
+  return r_2 / cos * pdf_area;
 }
 
 }  // namespace Prl2
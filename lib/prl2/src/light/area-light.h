@@ -13,13 +13,35 @@ class AreaLight : public Light {
  public:
   AreaLight(const SPD& _spd, const std::shared_ptr<Geometry>& _geometry);
 
-  Real Le(const Ray& ray, const IntersectInfo& info) const override;
+  SampledSpectrum Le(const Ray& ray, const IntersectInfo& info,
+                     const SampledWavelengths& lambda) const override;
 
   void samplePoint(const IntersectInfo& info, Sampler& sampler, Vec3& p,
-                   Real& pdf) const override;
+                   Vec3& n, Real& pdf) const override;
+
+  // 拡散光源の放射束 π * ∫L(λ)dλ * 面積
+  Real getPower() const override;
+
+  unsigned int getNumFaces() const override {
+    return geometry->getNumFaces();
+  };
+
+  // 表側の半球に放射する
+  LightBounds getLightBounds(unsigned int face) const override;
+
+  void sampleFace(unsigned int face, const IntersectInfo& info,
+                  Sampler& sampler, Vec3& p, Vec3& n,
+                  Real& pdf) const override;
 
  private:
   std::shared_ptr<Geometry> geometry;  // Geometry
+
+  // 分光放射輝度を波長で積分した値
+  Real integrateRadiance() const;
+
+  // 面積に関するpdfを、infoの点から見た立体角に関するpdfに変換する
+  static Real toSolidAnglePdf(const IntersectInfo& info, const Vec3& p,
+                              const Vec3& n, const Real& pdf_area);
 };
 
 }  // namespace Prl2
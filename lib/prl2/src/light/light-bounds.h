@@ -0,0 +1,120 @@
+#ifndef _PRL2_LIGHT_BOUNDS_H
+#define _PRL2_LIGHT_BOUNDS_H
+
+#include <algorithm>
+#include <cmath>
+
+#include "core/bounds3.h"
+#include "core/direction-cone.h"
+#include "core/type.h"
+#include "core/vec3.h"
+
+namespace Prl2 {
+
+// 光源(またはその集合)の位置、向き、放射束を囲むもの
+// Light BVHで、ある点への寄与の上限の目安を計算するのに使う
+// Conty Estevez and Kulla, "Importance Sampling of Many Lights with Adaptive
+// Tree Splitting" (2018)
+struct LightBounds {
+  Bounds3 bounds;      // 位置のバウンディングボックス
+  Real phi;            // 放射束
+  DirectionCone cone;  // 法線を全て含む円錐
+  Real cos_theta_e;    // 法線から放射する方向までの最大の角度の余弦
+  bool two_sided;      // 両面から放射するか
+
+  LightBounds() : phi(0), cos_theta_e(1), two_sided(false) {}
+
+  // 点pで法線nを持つ点への寄与の上限の目安を返す
+  // nが0の場合は受け取る側の向きを考えない
+  Real importance(const Vec3& p, const Vec3& n) const {
+    // 中心までの距離の2乗
+    // 中に入っている場合に大きくなりすぎないように、対角線の長さで下から抑える
+    const Vec3 pc = bounds.center();
+    const Real radius2 = 0.25f * length2(bounds.p1 - bounds.p0);
+    const Real d2 = std::max(length2(p - pc), std::sqrt(radius2));
+
+    // 中心から見たpの方向と法線の円錐の軸との角度
+    const Vec3 wi = normalize(p - pc);
+    Real cos_theta_w = dot(cone.w, wi);
+    if (two_sided) {
+      cos_theta_w = std::abs(cos_theta_w);
+    }
+    const Real sin_theta_w = safeSqrt(1 - sq(cos_theta_w));
+
+    // pから見たバウンディングボックスを囲む球の広がり
+    Real cos_theta_b = -1;
+    if (length2(p - pc) > radius2) {
+      cos_theta_b = safeSqrt(1 - radius2 / length2(p - pc));
+    }
+    const Real sin_theta_b = safeSqrt(1 - sq(cos_theta_b));
+
+    // 円錐とバウンディングボックスの広がりを差し引いた角度
+    // cos(max(0, θw - θo - θb))
+    const Real cos_theta_o = cone.cos_theta;
+    const Real sin_theta_o = safeSqrt(1 - sq(cos_theta_o));
+    const Real cos_theta_x = cosSubClamped(sin_theta_w, cos_theta_w,
+                                           sin_theta_o, cos_theta_o);
+    const Real sin_theta_x = sinSubClamped(sin_theta_w, cos_theta_w,
+                                           sin_theta_o, cos_theta_o);
+    const Real cos_theta_p = cosSubClamped(sin_theta_x, cos_theta_x,
+                                           sin_theta_b, cos_theta_b);
+    if (cos_theta_p <= cos_theta_e) {
+      return 0;
+    }
+
+    Real result = phi * cos_theta_p / d2;
+
+    // 受け取る側の余弦の上限
+    if (n.x() != 0 || n.y() != 0 || n.z() != 0) {
+      const Real cos_theta_i = std::abs(dot(wi, n));
+      const Real sin_theta_i = safeSqrt(1 - sq(cos_theta_i));
+      result *= cosSubClamped(sin_theta_i, cos_theta_i, sin_theta_b,
+                              cos_theta_b);
+    }
+
+    return std::max(result, Real(0));
+  };
+
+ private:
+  static Real sq(const Real& x) { return x * x; };
+  static Real safeSqrt(const Real& x) {
+    return std::sqrt(std::max(x, Real(0)));
+  };
+
+  // cos(max(0, a - b))
+  static Real cosSubClamped(const Real& sin_a, const Real& cos_a,
+                            const Real& sin_b, const Real& cos_b) {
+    if (cos_a > cos_b) {
+      return 1;
+    }
+    return cos_a * cos_b + sin_a * sin_b;
+  };
+
+  // sin(max(0, a - b))
+  static Real sinSubClamped(const Real& sin_a, const Real& cos_a,
+                            const Real& sin_b, const Real& cos_b) {
+    if (cos_a > cos_b) {
+      return 0;
+    }
+    return sin_a * cos_b - cos_a * sin_b;
+  };
+};
+
+// 2つのLightBoundsを両方とも含むLightBoundsを返す
+inline LightBounds mergeLightBounds(const LightBounds& a,
+                                    const LightBounds& b) {
+  if (a.phi == 0) return b;
+  if (b.phi == 0) return a;
+
+  LightBounds ret;
+  ret.bounds = mergeBounds(a.bounds, b.bounds);
+  ret.phi = a.phi + b.phi;
+  ret.cone = mergeCones(a.cone, b.cone);
+  ret.cos_theta_e = std::min(a.cos_theta_e, b.cos_theta_e);
+  ret.two_sided = a.two_sided || b.two_sided;
+  return ret;
+}
+
+}  // namespace Prl2
+
+#endif
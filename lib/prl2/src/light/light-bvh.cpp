@@ -0,0 +1,181 @@
+#include "light/light-bvh.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace Prl2 {
+
+// 構築時の光源の面の情報
+struct LightBVH::BuildRef {
+  LightRef ref;        // 光源の面
+  LightBounds bounds;  // LightBounds
+  Vec3 centroid;       // バウンディングボックスの中心
+};
+
+void LightBVH::build(const std::vector<const Light*>& lights) {
+  nodes.clear();
+  refs.clear();
+  trails.clear();
+  trail_offsets.clear();
+
+  // 放射しない面は選ばれることが無いので入れない
+  std::vector<BuildRef> build_refs;
+  trail_offsets.resize(lights.size() + 1);
+  for (unsigned int k = 0; k < lights.size(); ++k) {
+    trail_offsets[k] = trails.size();
+    const unsigned int num_faces = lights[k]->getNumFaces();
+    trails.resize(trails.size() + num_faces, 0);
+    for (unsigned int face = 0; face < num_faces; ++face) {
+      BuildRef build_ref;
+      build_ref.ref = {lights[k], face};
+      build_ref.bounds = lights[k]->getLightBounds(face);
+      build_ref.centroid = build_ref.bounds.bounds.center();
+      if (build_ref.bounds.phi > 0) {
+        build_refs.push_back(build_ref);
+      }
+    }
+  }
+  trail_offsets[lights.size()] = trails.size();
+
+  if (build_refs.empty()) {
+    return;
+  }
+
+  refs.reserve(build_refs.size());
+  build(build_refs, 0, build_refs.size(), 1, 0);
+}
+
+unsigned int LightBVH::build(std::vector<BuildRef>& build_refs,
+                             unsigned int start, unsigned int end,
+                             uint64_t trail, unsigned int depth) {
+  const unsigned int offset = nodes.size();
+  nodes.emplace_back();
+
+  // 葉ノード
+  if (end - start == 1) {
+    const LightRef& ref = build_refs[start].ref;
+    nodes[offset].bounds = build_refs[start].bounds;
+    nodes[offset].index = refs.size();
+    nodes[offset].is_leaf = true;
+    refs.push_back(ref);
+    trails[trail_offsets[ref.light->getIndex()] + ref.face] = trail;
+    return offset;
+  }
+
+  // 中心の広がりが最も大きい軸の中央で分ける
+  // 常に半分に分けるので深さはlog2(面の数)程度になり、経路は64bitに収まる
+  Bounds3 centroid_bounds(build_refs[start].centroid,
+                          build_refs[start].centroid);
+  for (unsigned int k = start + 1; k < end; ++k) {
+    centroid_bounds = mergeBounds(centroid_bounds, build_refs[k].centroid);
+  }
+  const int axis = centroid_bounds.maxExtent();
+  const unsigned int mid = start + (end - start) / 2;
+  std::nth_element(build_refs.begin() + start, build_refs.begin() + mid,
+                   build_refs.begin() + end,
+                   [axis](const BuildRef& a, const BuildRef& b) {
+                     return a.centroid[axis] < b.centroid[axis];
+                   });
+
+  // 子ノードを構築する
+  // 経路の終わりを表す最上位の1の位置に進む方向を書き、その1つ上に1を置く
+  const uint64_t top = uint64_t(1) << depth;
+  const uint64_t left_trail = (trail & ~top) | (top << 1);
+  const uint64_t right_trail = trail | (top << 1);
+  build(build_refs, start, mid, left_trail, depth + 1);
+  const unsigned int second =
+      build(build_refs, mid, end, right_trail, depth + 1);
+
+  nodes[offset].bounds =
+      mergeLightBounds(nodes[offset + 1].bounds, nodes[second].bounds);
+  nodes[offset].index = second;
+  nodes[offset].is_leaf = false;
+  return offset;
+}
+
+const Light* LightBVH::sample(const IntersectInfo& info, Real u,
+                              unsigned int& face, Real& pdf) const {
+  if (nodes.empty()) {
+    return nullptr;
+  }
+
+  const Vec3& p = info.hitPos;
+  const Vec3& n = info.hitNormal;
+
+  // 根の寄与が0なら光源は選ばない
+  if (nodes[0].bounds.importance(p, n) == 0) {
+    return nullptr;
+  }
+
+  pdf = 1;
+  unsigned int current = 0;
+  while (!nodes[current].is_leaf) {
+    // 子ノードの寄与に比例して進む方を選ぶ
+    const unsigned int left = current + 1;
+    const unsigned int right = nodes[current].index;
+    const Real importance_left = nodes[left].bounds.importance(p, n);
+    const Real importance_right = nodes[right].bounds.importance(p, n);
+    const Real sum = importance_left + importance_right;
+    if (sum == 0) {
+      return nullptr;
+    }
+
+    // 選んだ後はuを[0, 1)に引き伸ばして使い回す
+    const Real p_left = importance_left / sum;
+    if (u < p_left) {
+      current = left;
+      pdf *= p_left;
+      u = std::min(u / p_left, Real(1) - std::numeric_limits<Real>::epsilon());
+    } else {
+      current = right;
+      pdf *= 1 - p_left;
+      u = std::min((u - p_left) / (1 - p_left),
+                   Real(1) - std::numeric_limits<Real>::epsilon());
+    }
+  }
+
+  const LightRef& ref = refs[nodes[current].index];
+  face = ref.face;
+  return ref.light;
+}
+
+Real LightBVH::getPdf(const IntersectInfo& info, const Light* light,
+                      unsigned int face) const {
+  // 木に入っていない面は選ばれない
+  const uint64_t trail = trails[trail_offsets[light->getIndex()] + face];
+  if (trail == 0) {
+    return 0;
+  }
+
+  const Vec3& p = info.hitPos;
+  const Vec3& n = info.hitNormal;
+  if (nodes[0].bounds.importance(p, n) == 0) {
+    return 0;
+  }
+
+  // 根から葉までsampleと同じ確率を掛けていく
+  Real pdf = 1;
+  unsigned int current = 0;
+  for (uint64_t t = trail; t != 1; t >>= 1) {
+    const unsigned int left = current + 1;
+    const unsigned int right = nodes[current].index;
+    const Real importance_left = nodes[left].bounds.importance(p, n);
+    const Real importance_right = nodes[right].bounds.importance(p, n);
+    const Real sum = importance_left + importance_right;
+    if (sum == 0) {
+      return 0;
+    }
+
+    if (t & 1) {
+      current = right;
+      pdf *= importance_right / sum;
+    } else {
+      current = left;
+      pdf *= importance_left / sum;
+    }
+  }
+
+  return pdf;
+}
+
+}  // namespace Prl2
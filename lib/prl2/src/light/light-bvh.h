@@ -0,0 +1,70 @@
+#ifndef _PRL2_LIGHT_BVH_H
+#define _PRL2_LIGHT_BVH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "core/isect.h"
+#include "light/light-bounds.h"
+#include "light/light.h"
+
+namespace Prl2 {
+
+// 光源の面を葉に持つBVH
+// 各ノードのLightBoundsから衝突点への寄与の上限の目安を計算し、
+// それに比例する確率で子ノードを辿って光源の面を1つ選ぶ
+// 遠い光源や衝突点に背を向けている光源はほとんど選ばれなくなる
+class LightBVH {
+ public:
+  LightBVH(){};
+
+  // 光源の表から構築する
+  // lights[k]->getIndex()はkであること
+  void build(const std::vector<const Light*>& lights);
+
+  // infoの点に対して光源の面を1つ選ぶ
+  // u: [0, 1)の乱数, face: 選んだ面, pdf: 選ぶ確率
+  // 寄与する光源が無い場合はnullptrを返す
+  const Light* sample(const IntersectInfo& info, Real u, unsigned int& face,
+                      Real& pdf) const;
+
+  // infoの点に対してlightのface番目の面が選ばれる確率を返す
+  Real getPdf(const IntersectInfo& info, const Light* light,
+              unsigned int face) const;
+
+  bool empty() const { return nodes.empty(); };
+
+ private:
+  // 葉ノードに入れる光源の面
+  struct LightRef {
+    const Light* light;  // 光源
+    unsigned int face;   // 面のインデックス
+  };
+
+  // 配列に並べたノード
+  // 左の子は常に直後に置く
+  struct Node {
+    LightBounds bounds;  // LightBounds
+    unsigned int index;  // 葉ノード: refsの番号, 内部ノード: 右の子の位置
+    bool is_leaf;        // 葉ノードか
+  };
+
+  std::vector<Node> nodes;     // ノード
+  std::vector<LightRef> refs;  // 光源の面
+
+  // 光源の面の葉ノードまでの経路
+  // 下位ビットから順に、0なら左、1なら右の子に進む
+  // 最上位の1は経路の終わりを表す
+  std::vector<uint64_t> trails;
+  std::vector<unsigned int> trail_offsets;  // 光源ごとのtrailsの開始位置
+
+  struct BuildRef;
+
+  // [start, end)の面からノードを構築し、その位置を返す
+  unsigned int build(std::vector<BuildRef>& build_refs, unsigned int start,
+                     unsigned int end, uint64_t trail, unsigned int depth);
+};
+
+}  // namespace Prl2
+
+#endif
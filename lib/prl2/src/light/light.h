@@ -5,7 +5,9 @@
 
 #include "core/isect.h"
 #include "core/ray.h"
+#include "core/sampled-spectrum.h"
 #include "core/spectrum.h"
+#include "light/light-bounds.h"
 #include "sampler/sampler.h"
 
 namespace Prl2 {
@@ -17,15 +19,43 @@ class Light {
  public:
   Light(const SPD& _spd);
 
-  // 光源上の点から出る分光放射輝度を返す
-  virtual Real Le(const Ray& ray, const IntersectInfo& info) const = 0;
+  // 光源上の点から出る分光放射輝度を波長ごとに返す
+  virtual SampledSpectrum Le(const Ray& ray, const IntersectInfo& info,
+                             const SampledWavelengths& lambda) const = 0;
 
   // 光源上の点をサンプリングする
+  // p: 光源上の点, n: pでの法線, pdf: 立体角に関するpdf
   virtual void samplePoint(const IntersectInfo& info, Sampler& sampler, Vec3& p,
-                           Real& pdf) const = 0;
+                           Vec3& n, Real& pdf) const = 0;
+
+  // 光源全体から出る放射束を返す
+  // 光源の選択確率に使うので、正確でなくても正の値であれば良い
+  virtual Real getPower() const = 0;
+
+  // 面の数を返す
+  // メッシュの光源はLight BVHで面ごとに選べるようにする
+  virtual unsigned int getNumFaces() const { return 1; };
+
+  // face番目の面のLightBoundsを返す
+  virtual LightBounds getLightBounds(unsigned int face) const = 0;
+
+  // face番目の面上の点をサンプリングする
+  // p: 光源上の点, n: pでの法線, pdf: 立体角に関するpdf
+  virtual void sampleFace(unsigned int face, const IntersectInfo& info,
+                          Sampler& sampler, Vec3& p, Vec3& n,
+                          Real& pdf) const {
+    samplePoint(info, sampler, p, n, pdf);
+  };
+
+  // Sceneの光源の表での番号を取得する
+  unsigned int getIndex() const { return index; };
+  // Sceneの光源の表での番号をセットする (for Scene::initScene)
+  void setIndex(unsigned int _index) { index = _index; };
 
  protected:
   SPD spd;  // 分光放射束
+
+  unsigned int index = 0;  // Sceneの光源の表での番号
 };
 
 }  // namespace Prl2
@@ -2,10 +2,10 @@
 
 namespace Prl2 {
 
-Diffuse::Diffuse(const SPD& _spd) : spd(_spd) {}
+Diffuse::Diffuse(const SPD& _spd) : spd(_spd), albedo(_spd.toRGB()) {}
 
-Real Diffuse::sampleDirection(MaterialArgs& interaction, Sampler& sampler,
-                              Real& pdf) const {
+SampledSpectrum Diffuse::sampleDirection(MaterialArgs& interaction,
+                                         Sampler& sampler, Real& pdf) const {
   // Cosine Weighted Hemisphere Sampling
   const Vec2 u = sampler.getNext2D();
   interaction.wi_local = sampleCosineHemisphere(u);
@@ -15,12 +15,24 @@ Real Diffuse::sampleDirection(MaterialArgs& interaction, Sampler& sampler,
   return INV_PI * spd.sample(interaction.lambda);
 }
 
-Real Diffuse::BRDF(const MaterialArgs& interaction) const {
+// sampleDirectionは法線側の半球しかサンプリングしないので、
+// 反対側の方向はBRDFもpdfも0にしてMISの重みと整合させる
+SampledSpectrum Diffuse::BRDF(const MaterialArgs& interaction) const {
+  if (cosTheta(interaction.wi_local) <= 0) {
+    return SampledSpectrum(0);
+  }
   return INV_PI * spd.sample(interaction.lambda);
 }
 
+Real Diffuse::getPdf(const MaterialArgs& interaction) const {
+  if (cosTheta(interaction.wi_local) <= 0) {
+    return 0;
+  }
+  return INV_PI * cosTheta(interaction.wi_local);
+}
+
 RGB Diffuse::albedoRGB(const MaterialArgs& interaction) const {
-  return spd.toRGB();
+  return albedo;
 }
 
 }  // namespace Prl2
\ No newline at end of file
@@ -12,15 +12,20 @@ class Diffuse : public Material {
  public:
   Diffuse(const SPD& _spd);
 
-  Real sampleDirection(MaterialArgs& interaction, Sampler& sampler,
-                       Real& pdf) const override;
+  SampledSpectrum sampleDirection(MaterialArgs& interaction, Sampler& sampler,
+                                  Real& pdf) const override;
 
-  Real BRDF(const MaterialArgs& interaction) const override;
+  SampledSpectrum BRDF(const MaterialArgs& interaction) const override;
+
+  Real getPdf(const MaterialArgs& interaction) const override;
+
+  MaterialType getType() const override { return MaterialType::Diffuse; };
 
   RGB albedoRGB(const MaterialArgs& interaction) const override;
 
  private:
-  SPD spd;  //分光反射率
+  SPD spd;           //分光反射率
+  const RGB albedo;  // 分光反射率をRGBにしたもの(AOV用に事前計算する)
 };
 
 }  // namespace Prl2
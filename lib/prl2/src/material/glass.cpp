@@ -3,12 +3,15 @@
 namespace Prl2 {
 
 Glass::Glass(const SellmeierEquation& _sellmeier, const SPD& _spd)
-    : sellmeier(_sellmeier), spd(_spd) {}
+    : sellmeier(_sellmeier), spd(_spd), albedo(_spd.toRGB()) {}
+
+SampledSpectrum Glass::sampleDirection(MaterialArgs& interaction,
+                                       Sampler& sampler, Real& pdf) const {
+  // 屈折方向が波長ごとに異なるので、Hero Wavelengthだけを追跡する
+  interaction.lambda.terminateSecondary();
 
-Real Glass::sampleDirection(MaterialArgs& interaction, Sampler& sampler,
-                            Real& pdf) const {
   const bool is_entering = cosTheta(interaction.wo_local) > 0;
-  const Real glass_ior = sellmeier.ior(interaction.lambda);
+  const Real glass_ior = sellmeier.ior(interaction.lambda.hero());
 
   const Vec3 normal = is_entering ? Vec3(0, 1, 0) : Vec3(0, -1, 0);
   const Real ior1 = is_entering ? 1.0 : glass_ior;
@@ -43,10 +46,14 @@ Real Glass::sampleDirection(MaterialArgs& interaction, Sampler& sampler,
   }
 }
 
-Real Glass::BRDF(const MaterialArgs& interaction) const { return 0; }
+SampledSpectrum Glass::BRDF(const MaterialArgs& interaction) const {
+  return SampledSpectrum(0);
+}
+
+Real Glass::getPdf(const MaterialArgs& interaction) const { return 0; }
 
 RGB Glass::albedoRGB(const MaterialArgs& interaction) const {
-  return spd.toRGB();
+  return albedo;
 }
 
 }  // namespace Prl2
\ No newline at end of file
@@ -34,16 +34,25 @@ class Glass : public Material {
  public:
   Glass(const SellmeierEquation& _sellmeier, const SPD& _spd);
 
-  Real sampleDirection(MaterialArgs& interaction, Sampler& sampler,
-                       Real& pdf) const override;
+  SampledSpectrum sampleDirection(MaterialArgs& interaction, Sampler& sampler,
+                                  Real& pdf) const override;
 
-  Real BRDF(const MaterialArgs& interaction) const override;
+  SampledSpectrum BRDF(const MaterialArgs& interaction) const override;
+
+  Real getPdf(const MaterialArgs& interaction) const override;
+
+  MaterialType getType() const override { return MaterialType::Glass; };
+
+  bool isDelta() const override { return true; };
+
+  bool isTransmissive() const override { return true; };
 
   RGB albedoRGB(const MaterialArgs& interaction) const override;
 
  private:
   const SellmeierEquation sellmeier;  //セルマイヤーの式
   const SPD spd;                      // 分光反射率
+  const RGB albedo;                   // RGBにした反射率
 };
 
 }  // namespace Prl2
@@ -3,6 +3,7 @@
 
 #include "core/isect.h"
 #include "core/ray.h"
+#include "core/sampled-spectrum.h"
 #include "core/spectrum.h"
 #include "core/type.h"
 #include "core/vec3.h"
@@ -52,10 +53,15 @@ inline bool refract(const Vec3& wi, Vec3& wt, const Vec3& n, const Real& ior1,
   return true;
 }
 
+// Materialの種類
+// WavefrontPTは種類ごとに別のステージでまとめてBRDF Samplingを行う
+enum class MaterialType { Diffuse, Mirror, Glass };
+constexpr unsigned int NUM_MATERIAL_TYPES = 3;
+
 struct MaterialArgs {
-  Vec3 wo_local;  // マテリアル座標系の出射ベクトル
-  Vec3 wi_local;  // マテリアル座標系の入射ベクトル
-  Real lambda;    // 波長
+  Vec3 wo_local;              // マテリアル座標系の出射ベクトル
+  Vec3 wi_local;              // マテリアル座標系の入射ベクトル
+  SampledWavelengths lambda;  // パスが運ぶ波長
 };
 
 // Materialを表現するクラス
@@ -66,11 +72,29 @@ class Material {
   Material(){};
 
   //マテリアル座標系で次のレイの方向をサンプリングする
-  //評価した分光反射率を返り値とする
-  virtual Real sampleDirection(MaterialArgs& interaction, Sampler& sampler,
-                               Real& pdf) const = 0;
+  //評価した分光反射率を波長ごとに返り値とする
+  //方向が波長に依存する場合はinteraction.lambdaのHero Wavelength以外を打ち切る
+  virtual SampledSpectrum sampleDirection(MaterialArgs& interaction,
+                                          Sampler& sampler,
+                                          Real& pdf) const = 0;
+
+  virtual SampledSpectrum BRDF(const MaterialArgs& interaction) const = 0;
+
+  // sampleDirectionでinteraction.wi_localがサンプリングされる確率密度
+  // 鏡面反射のようにデルタ関数で表される場合は0を返す
+  virtual Real getPdf(const MaterialArgs& interaction) const = 0;
+
+  // Materialの種類を返す
+  virtual MaterialType getType() const = 0;
+
+  // 鏡面反射のようにBRDFがデルタ関数で表されるか
+  // trueの場合はBRDFが常に0になるので、光源や空の直接サンプリングを行わない
+  virtual bool isDelta() const { return false; };
 
-  virtual Real BRDF(const MaterialArgs& interaction) const = 0;
+  // 屈折のように法線の表と裏で振る舞いが変わるか
+  // falseの場合は両面とも同じように反射するものとして、
+  // Primitiveが法線を出射方向の側に向けてからマテリアル座標系を作る
+  virtual bool isTransmissive() const { return false; };
 
   // 反射率をRGBで返す
   virtual RGB albedoRGB(const MaterialArgs& interaction) const = 0;
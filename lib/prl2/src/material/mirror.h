@@ -10,15 +10,22 @@ class Mirror : public Material {
  public:
   Mirror(const SPD& _spd);
 
-  Real sampleDirection(MaterialArgs& interaction, Sampler& sampler,
-                       Real& pdf) const override;
+  SampledSpectrum sampleDirection(MaterialArgs& interaction, Sampler& sampler,
+                                  Real& pdf) const override;
 
-  Real BRDF(const MaterialArgs& interaction) const override;
+  SampledSpectrum BRDF(const MaterialArgs& interaction) const override;
+
+  Real getPdf(const MaterialArgs& interaction) const override;
+
+  MaterialType getType() const override { return MaterialType::Mirror; };
+
+  bool isDelta() const override { return true; };
 
   RGB albedoRGB(const MaterialArgs& interaction) const override;
 
  private:
-  const SPD spd;  // 分光反射率
+  const SPD spd;     // 分光反射率
+  const RGB albedo;  // RGBにした反射率
 };
 
 }  // namespace Prl2
@@ -1,26 +1,77 @@
 #include "parallel/parallel.h"
 
 #include <algorithm>
+#include <chrono>
+#include <deque>
 #include <functional>
 #include <future>
+#include <mutex>
 #include <thread>
 
 #include "ThreadPool.h"
 
 namespace Prl2 {
 
+namespace {
+
+// 画像上の矩形領域 [x0, x1) x [y0, y1)
+struct Tile {
+  unsigned int x0;
+  unsigned int y0;
+  unsigned int x1;
+  unsigned int y1;
+};
+
+// スレッドごとに持つタイルのDeque
+// 持ち主は先頭から、他のスレッドは末尾から取り出す
+struct TileQueue {
+  std::mutex mutex;
+  std::deque<Tile> tiles;
+
+  bool popFront(Tile& tile) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tiles.empty()) {
+      return false;
+    }
+    tile = tiles.front();
+    tiles.pop_front();
+    return true;
+  }
+
+  bool popBack(Tile& tile) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tiles.empty()) {
+      return false;
+    }
+    tile = tiles.back();
+    tiles.pop_back();
+    return true;
+  }
+};
+
+}  // namespace
+
 Parallel::Parallel()
-    : pool(ThreadPool(std::max(1U, std::thread::hardware_concurrency()))) {}
+    : num_threads(std::max(1U, std::thread::hardware_concurrency())),
+      pool(num_threads),
+      tail_idle_time(0) {}
+
+Parallel::Parallel(unsigned int max_threads)
+    : num_threads(std::max(
+          1U, std::min(max_threads, std::thread::hardware_concurrency()))),
+      pool(num_threads),
+      tail_idle_time(0) {}
 
 void Parallel::parallelFor1D(const std::function<void(unsigned int)>& job,
                              unsigned int nChunks, unsigned int n) {
   std::vector<std::future<void>> results;
 
-  const unsigned int chunkSize = n / nChunks;
+  // 余りが出ないように切り上げる
+  const unsigned int chunkSize = (n + nChunks - 1) / nChunks;
   for (unsigned int chunk_id = 0; chunk_id < nChunks; ++chunk_id) {
-    results.push_back(pool.enqueue([chunk_id, chunkSize, job] {
+    results.push_back(pool.enqueue([chunk_id, chunkSize, n, job] {
       const unsigned int start_i = chunk_id * chunkSize;
-      const unsigned int end_i = (chunk_id + 1) * chunkSize;
+      const unsigned int end_i = std::min((chunk_id + 1) * chunkSize, n);
       for (unsigned int i = start_i; i < end_i; ++i) {
         job(i);
       }
@@ -36,30 +87,103 @@ void Parallel::parallelFor2D(
     const std::function<void(unsigned int, unsigned int)>& job,
     unsigned int nChunks_x, unsigned int nChunks_y, unsigned int nx,
     unsigned int ny) {
-  std::vector<std::future<void>> results;
+  parallelFor2D(
+      [&job](unsigned int x, unsigned int y, unsigned int) { job(x, y); },
+      nChunks_x, nChunks_y, nx, ny);
+}
+
+void Parallel::parallelFor2D(
+    const std::function<void(unsigned int, unsigned int, unsigned int)>& job,
+    unsigned int nChunks_x, unsigned int nChunks_y, unsigned int nx,
+    unsigned int ny) {
+  parallelForTile2D(
+      [&job](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1,
+             unsigned int thread_id) {
+        for (unsigned int y = y0; y < y1; ++y) {
+          for (unsigned int x = x0; x < x1; ++x) {
+            job(x, y, thread_id);
+          }
+        }
+      },
+      nChunks_x, nChunks_y, nx, ny);
+}
 
-  const unsigned int chunkSize_x = nx / nChunks_x;
-  const unsigned int chunkSize_y = ny / nChunks_y;
-  for (unsigned int chunk_y = 0; chunk_y < nChunks_y; ++chunk_y) {
-    for (unsigned int chunk_x = 0; chunk_x < nChunks_x; ++chunk_x) {
-      results.push_back(
-          pool.enqueue([chunk_x, chunk_y, chunkSize_x, chunkSize_y, job] {
-            const unsigned int start_x = chunk_x * chunkSize_x;
-            const unsigned int end_x = (chunk_x + 1) * chunkSize_x;
-            const unsigned int start_y = chunk_y * chunkSize_y;
-            const unsigned int end_y = (chunk_y + 1) * chunkSize_y;
-            for (unsigned int y = start_y; y < end_y; ++y) {
-              for (unsigned int x = start_x; x < end_x; ++x) {
-                job(x, y);
-              }
-            }
-          }));
+void Parallel::parallelForTile2D(
+    const std::function<void(unsigned int, unsigned int, unsigned int,
+                             unsigned int, unsigned int)>& job,
+    unsigned int nChunks_x, unsigned int nChunks_y, unsigned int nx,
+    unsigned int ny) {
+  if (nx == 0 || ny == 0) {
+    return;
+  }
+
+  // タイルの大きさ
+  // 余りが出ないように切り上げる
+  const unsigned int tiles_x = std::clamp(nChunks_x, 1U, nx);
+  const unsigned int tiles_y = std::clamp(nChunks_y, 1U, ny);
+  const unsigned int tileSize_x = (nx + tiles_x - 1) / tiles_x;
+  const unsigned int tileSize_y = (ny + tiles_y - 1) / tiles_y;
+
+  // タイルをスレッドごとのDequeに順番に配る
+  // 隣り合うタイルは別のスレッドに配られるので、重いタイルが一箇所に固まりにくい
+  std::vector<TileQueue> queues(num_threads);
+  unsigned int tile_id = 0;
+  for (unsigned int y0 = 0; y0 < ny; y0 += tileSize_y) {
+    for (unsigned int x0 = 0; x0 < nx; x0 += tileSize_x) {
+      const Tile tile{x0, y0, std::min(x0 + tileSize_x, nx),
+                      std::min(y0 + tileSize_y, ny)};
+      queues[tile_id % num_threads].tiles.push_back(tile);
+      tile_id++;
     }
   }
 
+  // 各スレッドが仕事を終えた時刻
+  using Clock = std::chrono::steady_clock;
+  std::vector<Clock::time_point> finish_times(num_threads);
+
+  std::vector<std::future<void>> results;
+  for (unsigned int thread_id = 0; thread_id < num_threads; ++thread_id) {
+    results.push_back(pool.enqueue([&, thread_id] {
+      Tile tile;
+      while (true) {
+        // 自分のDequeから取り出す
+        bool found = queues[thread_id].popFront(tile);
+
+        // 自分のDequeが空なら他のスレッドから盗む
+        for (unsigned int k = 1; !found && k < num_threads; ++k) {
+          found = queues[(thread_id + k) % num_threads].popBack(tile);
+        }
+
+        // 全てのDequeが空なら終了
+        // タイルは途中で追加されないので、ここで終わってよい
+        if (!found) {
+          break;
+        }
+
+        job(tile.x0, tile.y0, tile.x1, tile.y1, thread_id);
+      }
+      finish_times[thread_id] = Clock::now();
+    }));
+  }
+
   for (auto&& result : results) {
     result.get();
   }
+
+  // 末尾の待ち時間を計算
+  const Clock::time_point end_time =
+      *std::max_element(finish_times.begin(), finish_times.end());
+  float idle_time = 0;
+  for (const auto& finish_time : finish_times) {
+    idle_time +=
+        std::chrono::duration<float, std::milli>(end_time - finish_time)
+            .count();
+  }
+  tail_idle_time = idle_time / num_threads;
 }
 
-}  // namespace Prl2
\ No newline at end of file
+unsigned int Parallel::getNumThreads() const { return num_threads; }
+
+float Parallel::getTailIdleTime() const { return tail_idle_time; }
+
+}  // namespace Prl2
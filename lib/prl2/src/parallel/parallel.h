@@ -11,6 +11,9 @@ class Parallel {
  public:
   Parallel();
 
+  // スレッド数をmax_threads以下にする
+  explicit Parallel(unsigned int max_threads);
+
   // For文を並列実行する
   // job: 並列化する対象の関数
   // nChunks: ループ分割数
@@ -19,19 +22,50 @@ class Parallel {
                      unsigned int nChunks, unsigned int n);
 
   // 二重For文を並列実行する
+  // 画像をタイルに分割し、スレッドごとのDequeに配る
+  // 自分のDequeが空になったスレッドは他のスレッドのDequeからタイルを盗む
+  // 割り切れない場合も端のタイルを小さくして全ての(x, y)を処理する
   // job: 並列化する対象の関数
-  // nChunks_x: X方向のループ分割数
-  // nChunks_y: Y方向のループ分割数
+  // nChunks_x: X方向のタイル数
+  // nChunks_y: Y方向のタイル数
   // nx: X方向のループ数
   // ny: Y方向のループ数
   void parallelFor2D(const std::function<void(unsigned int, unsigned int)>& job,
                      unsigned int nChunks_x, unsigned int nChunks_y,
                      unsigned int nx, unsigned int ny);
 
+  // 二重For文を並列実行する
+  // jobには(x, y)に加えて実行中のスレッド番号[0, getNumThreads())が渡される
+  // スレッドごとに作業領域を持たせたい場合に使う
+  void parallelFor2D(
+      const std::function<void(unsigned int, unsigned int, unsigned int)>& job,
+      unsigned int nChunks_x, unsigned int nChunks_y, unsigned int nx,
+      unsigned int ny);
+
+  // 画像をタイルに分割して並列実行する
+  // jobにはタイルの範囲[x0, x1) x [y0, y1)と実行中のスレッド番号が渡される
+  // タイル内の画素をまとめて処理したい場合に使う
+  // タイルの分割とスケジューリングはparallelFor2Dと同じ
+  void parallelForTile2D(
+      const std::function<void(unsigned int, unsigned int, unsigned int,
+                               unsigned int, unsigned int)>& job,
+      unsigned int nChunks_x, unsigned int nChunks_y, unsigned int nx,
+      unsigned int ny);
+
+  // スレッド数を入手する
+  unsigned int getNumThreads() const;
+
+  // 直前のparallelFor2D(parallelForTile2D)で各スレッドが仕事を終えてから
+  // 全体が終わるまで待っていた時間の平均を入手する[ms]
+  float getTailIdleTime() const;
+
  private:
-  ThreadPool pool;
+  const unsigned int num_threads;  // スレッド数
+  ThreadPool pool;                 // Thread Pool
+
+  float tail_idle_time;  // 直前のparallelFor2Dの末尾の待ち時間[ms]
 };
 
 }  // namespace Prl2
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,150 @@
+#include "postprocess/denoiser.h"
+
+#include <iostream>
+#include <utility>
+
+namespace Prl2 {
+
+Denoiser::~Denoiser() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  cond.notify_all();
+  if (worker.joinable()) {
+    worker.join();
+  }
+}
+
+bool Denoiser::denoiseAsync(unsigned int _width, unsigned int _height,
+                            const InputWriter& writer) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (state != State::Idle) {
+      return false;
+    }
+    state = State::Writing;
+
+    // スレッドは最初のデノイズで起動する
+    if (!worker.joinable()) {
+      worker = std::thread([this]() { run(); });
+    }
+  }
+
+  // 専用のスレッドはWritingの間はバッファに触らないので、ロックせずに書き込む
+  const std::size_t size = 3 * static_cast<std::size_t>(_width) * _height;
+  width = _width;
+  height = _height;
+  color.resize(size);
+  albedo.resize(size);
+  normal.resize(size);
+  output.resize(size);
+  writer(color.data(), albedo.data(), normal.data());
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    state = State::Running;
+  }
+  cond.notify_all();
+  return true;
+}
+
+void Denoiser::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  cond.wait(lock, [this]() { return state == State::Idle; });
+}
+
+bool Denoiser::readResult(
+    unsigned int _width, unsigned int _height,
+    const std::function<void(const Real* rgb)>& reader) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (result.empty() || result_width != _width || result_height != _height) {
+    return false;
+  }
+  reader(result.data());
+  return true;
+}
+
+void Denoiser::setResult(unsigned int _width, unsigned int _height,
+                         std::vector<Real> rgb) {
+  std::lock_guard<std::mutex> lock(mutex);
+  result = std::move(rgb);
+  result_width = _width;
+  result_height = _height;
+}
+
+bool Denoiser::isBusy() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return state != State::Idle;
+}
+
+void Denoiser::run() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [this]() { return stop || state == State::Running; });
+      if (stop) {
+        break;
+      }
+    }
+
+    execute();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      result = output;
+      result_width = width;
+      result_height = height;
+      state = State::Idle;
+    }
+    cond.notify_all();
+  }
+
+  // OIDNのオブジェクトは作成したスレッドで解放する
+  if (filter != nullptr) {
+    oidnReleaseFilter(filter);
+  }
+  if (device != nullptr) {
+    oidnReleaseDevice(device);
+  }
+}
+
+void Denoiser::execute() {
+  // https://github.com/OpenImageDenoise/oidn
+  // Create an Intel Open Image Denoise device
+  if (device == nullptr) {
+    device = oidnNewDevice(OIDN_DEVICE_TYPE_DEFAULT);
+    oidnCommitDevice(device);
+
+    // Create a denoising filter
+    filter = oidnNewFilter(device, "RT");  // generic ray tracing filter
+    oidnSetFilter1b(filter, "hdr", true);  // image is HDR
+  }
+
+  // バッファは画像サイズが変わった場合だけ設定し直す
+  // 設定し直すとコミットでフィルターが作り直されるため
+  if (width != filter_width || height != filter_height) {
+    oidnSetSharedFilterImage(filter, "color", color.data(), OIDN_FORMAT_FLOAT3,
+                             width, height, 0, 0, 0);
+    oidnSetSharedFilterImage(filter, "albedo", albedo.data(),
+                             OIDN_FORMAT_FLOAT3, width, height, 0, 0, 0);
+    oidnSetSharedFilterImage(filter, "normal", normal.data(),
+                             OIDN_FORMAT_FLOAT3, width, height, 0, 0, 0);
+    oidnSetSharedFilterImage(filter, "output", output.data(),
+                             OIDN_FORMAT_FLOAT3, width, height, 0, 0, 0);
+    oidnCommitFilter(filter);
+    filter_width = width;
+    filter_height = height;
+  }
+
+  // Filter the image
+  oidnExecuteFilter(filter);
+
+  // Check for errors
+  const char* errorMessage;
+  if (oidnGetDeviceError(device, &errorMessage) != OIDN_ERROR_NONE) {
+    std::cerr << "Error: " << errorMessage << std::endl;
+  }
+}
+
+}  // namespace Prl2
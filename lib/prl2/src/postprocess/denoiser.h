@@ -0,0 +1,100 @@
+#ifndef _PRL2_DENOISER_H
+#define _PRL2_DENOISER_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "core/type.h"
+
+#include "OpenImageDenoise/oidn.h"
+
+namespace Prl2 {
+
+// OIDNによるデノイズを行うクラス
+// デバイスとフィルターは最初のデノイズで作成し、以降は使い回す
+// 画像サイズが変わった場合だけバッファを設定し直す
+// デノイズは専用のスレッドで行い、呼び出し側は入力を書き込んだらすぐに戻る
+// OIDNの呼び出しは全て専用のスレッドから行う
+class Denoiser {
+ public:
+  // 入力を書き込む関数
+  // color, albedo, normalにそれぞれ3 * width * height個の値を書き込む
+  using InputWriter = std::function<void(Real* color, Real* albedo,
+                                         Real* normal)>;
+
+  Denoiser(){};
+  ~Denoiser();
+
+  Denoiser(const Denoiser&) = delete;
+  Denoiser& operator=(const Denoiser&) = delete;
+
+  // 入力をwriterで書き込み、バックグラウンドでデノイズを開始する
+  // writerは呼び出したスレッドで実行されるので、その時点の画像が入力になる
+  // 前のデノイズが終わっていない場合は何もせずにfalseを返す
+  bool denoiseAsync(unsigned int width, unsigned int height,
+                    const InputWriter& writer);
+
+  // 実行中のデノイズが終わるまで待つ
+  void wait();
+
+  // 最後に終わったデノイズの結果をreaderに渡す
+  // 結果のサイズがwidth x heightと違う場合は古い結果とみなして渡さない
+  // readerはロックを取ったまま呼ぶので、結果をコピーせずに読める
+  // 結果を渡した場合はtrueを返す
+  bool readResult(unsigned int width, unsigned int height,
+                  const std::function<void(const Real* rgb)>& reader) const;
+
+  // 外部でデノイズした結果(3 * width * height個)を最後の結果として設定する
+  void setResult(unsigned int width, unsigned int height,
+                 std::vector<Real> rgb);
+
+  // デノイズを実行中か
+  bool isBusy() const;
+
+ private:
+  // 状態
+  enum class State {
+    Idle,     // 何もしていない
+    Writing,  // 呼び出し側が入力を書き込んでいる
+    Running,  // デノイズ中
+  };
+
+  mutable std::mutex mutex;
+  std::condition_variable cond;
+  std::thread worker;  // デノイズを行うスレッド
+  State state = State::Idle;
+  bool stop = false;  // スレッドを終了するか
+
+  // OIDN
+  OIDNDevice device = nullptr;
+  OIDNFilter filter = nullptr;
+  unsigned int filter_width = 0;   // フィルターに設定したバッファの横幅
+  unsigned int filter_height = 0;  // フィルターに設定したバッファの縦幅
+
+  // 入力と出力のバッファ(フィルターが直接参照する)
+  // 画像サイズが変わらない限りアドレスは変わらない
+  unsigned int width = 0;
+  unsigned int height = 0;
+  std::vector<Real> color;
+  std::vector<Real> albedo;
+  std::vector<Real> normal;
+  std::vector<Real> output;
+
+  // 最後に終わったデノイズの結果
+  std::vector<Real> result;
+  unsigned int result_width = 0;
+  unsigned int result_height = 0;
+
+  // 専用のスレッドで実行するループ
+  void run();
+
+  // デノイズを実行する
+  void execute();
+};
+
+}  // namespace Prl2
+
+#endif
@@ -0,0 +1,165 @@
+#include "postprocess/postprocess.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace Prl2 {
+
+namespace {
+
+inline uint32_t floatBits(float x) {
+  uint32_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  return bits;
+}
+
+inline float bitsFloat(uint32_t bits) {
+  float x;
+  std::memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+// log2(x)
+// x = m * 2^eとし、mを[1/√2, √2)に収めてから
+// t = (m - 1) / (m + 1)についてのlog(m) = 2 * atanh(t)の級数で計算する
+// 0以下や非正規化数は扱えないので、ビット列を整数として比べて
+// 正規化数の最小値で止める(浮動小数点の比較だと分岐が残りベクトル化されない)
+inline float log2Approx(float x) {
+  const uint32_t bits = static_cast<uint32_t>(
+      std::max(static_cast<int32_t>(floatBits(x)), 0x00800000));
+  int32_t e = static_cast<int32_t>(bits >> 23) - 127;
+  float m = bitsFloat((bits & 0x007fffff) | 0x3f800000);
+  const int32_t large = m > 1.41421356f;
+  m *= 1.0f - 0.5f * static_cast<float>(large);
+  e += large;
+
+  const float t = (m - 1) / (m + 1);
+  const float t2 = t * t;
+  const float p =
+      t * (2.0f + t2 * (2.0f / 3 + t2 * (2.0f / 5 + t2 * (2.0f / 7))));
+  return static_cast<float>(e) + p * 1.44269504f;
+}
+
+// 2^y
+// y = i + f (|f| <= 0.5)とし、2^fをTaylor展開で計算する
+// yを[-126, 127]に収める際も分岐しないように絶対値で最大、最小を取る
+inline float exp2Approx(float y) {
+  y = 0.5f * (y - 126.0f + std::abs(y + 126.0f));
+  y = 0.5f * (y + 127.0f - std::abs(y - 127.0f));
+  // y + 126.5 > 0なので切り捨てで四捨五入になる
+  const int32_t i = static_cast<int32_t>(y + 126.5f) - 126;
+  const float f = (y - static_cast<float>(i)) * 0.693147181f;
+  const float p =
+      1.0f +
+      f * (1.0f +
+           f * (1.0f / 2 +
+                f * (1.0f / 6 +
+                     f * (1.0f / 24 + f * (1.0f / 120 + f * (1.0f / 720))))));
+  return p * bitsFloat(static_cast<uint32_t>(i + 127) << 23);
+}
+
+// x <= 0の場合は0を掛けて消す
+inline float powApprox(float x, float y) {
+  const float v = exp2Approx(y * log2Approx(x));
+  return v * static_cast<float>(x > 0);
+}
+
+}  // namespace
+
+float fastPow(float x, float y) { return powApprox(x, y); }
+
+namespace {
+
+// 設定ごとに分岐を外に出したループ
+template <bool DIVIDE, bool TONE_MAPPING, bool GAMMA_CORRECTION>
+void postProcessLoop(const Real* __restrict in,
+                     const unsigned int* __restrict samples, unsigned int n,
+                     float inv_exposure2, float inv_gamma,
+                     float* __restrict out) {
+  // 添字をsize_tにしないとオーバーフローの可能性から連続アクセスと判定されない
+  for (std::size_t k = 0; k < n; ++k) {
+    float r = in[3 * k + 0];
+    float g = in[3 * k + 1];
+    float b = in[3 * k + 2];
+
+    // サンプル数で割る
+    // サンプル数が0の画素(まだサンプリングしていない画素)は0にする
+    // サンプル数は整数なので、min(n, 1) / max(n, 1)はn = 0で0、それ以外で1 / n
+    // 分岐にしないのはベクトル化を妨げないため
+    if (DIVIDE) {
+      const float count = static_cast<float>(samples[k]);
+      const float scale = std::min(count, 1.0f) / std::max(count, 1.0f);
+      r *= scale;
+      g *= scale;
+      b *= scale;
+    }
+
+    // Reinhard Tone Mapping
+    // reinhardToneMapping(L) / Lを約分して計算するので、L = 0でも割らない
+    if (TONE_MAPPING) {
+      const float luminance = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+      const float s = (1 + luminance * inv_exposure2) / (1 + luminance);
+      r *= s;
+      g *= s;
+      b *= s;
+    }
+
+    // ガンマ補正
+    if (GAMMA_CORRECTION) {
+      r = powApprox(r, inv_gamma);
+      g = powApprox(g, inv_gamma);
+      b = powApprox(b, inv_gamma);
+    }
+
+    out[3 * k + 0] = r;
+    out[3 * k + 1] = g;
+    out[3 * k + 2] = b;
+  }
+}
+
+template <bool DIVIDE, bool TONE_MAPPING>
+void postProcessLoop(const Real* in, const unsigned int* samples,
+                     unsigned int n, bool gamma_correction,
+                     float inv_exposure2, float inv_gamma, float* out) {
+  if (gamma_correction) {
+    postProcessLoop<DIVIDE, TONE_MAPPING, true>(in, samples, n, inv_exposure2,
+                                                inv_gamma, out);
+  } else {
+    postProcessLoop<DIVIDE, TONE_MAPPING, false>(in, samples, n,
+                                                 inv_exposure2, inv_gamma, out);
+  }
+}
+
+template <bool DIVIDE>
+void postProcessLoop(const Real* in, const unsigned int* samples,
+                     unsigned int n, bool tone_mapping, bool gamma_correction,
+                     float inv_exposure2, float inv_gamma, float* out) {
+  if (tone_mapping) {
+    postProcessLoop<DIVIDE, true>(in, samples, n, gamma_correction,
+                                  inv_exposure2, inv_gamma, out);
+  } else {
+    postProcessLoop<DIVIDE, false>(in, samples, n, gamma_correction,
+                                   inv_exposure2, inv_gamma, out);
+  }
+}
+
+}  // namespace
+
+void postProcess(const Real* in, const unsigned int* samples, unsigned int n,
+                 const PostProcessSettings& settings, float* out) {
+  const float inv_exposure2 = 1 / (settings.exposure * settings.exposure);
+  const float inv_gamma = 1 / settings.gamma;
+  const bool gamma_correction = settings.gamma != 1;
+  if (samples != nullptr) {
+    postProcessLoop<true>(in, samples, n, settings.tone_mapping,
+                          gamma_correction, inv_exposure2, inv_gamma, out);
+  } else {
+    postProcessLoop<false>(in, samples, n, settings.tone_mapping,
+                           gamma_correction, inv_exposure2, inv_gamma, out);
+  }
+}
+
+}  // namespace Prl2
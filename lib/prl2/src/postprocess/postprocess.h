@@ -0,0 +1,28 @@
+#ifndef _PRL2_POSTPROCESS_H
+#define _PRL2_POSTPROCESS_H
+
+#include "core/type.h"
+
+namespace Prl2 {
+
+// 画像を読み出す時の変換の設定
+struct PostProcessSettings {
+  bool tone_mapping = false;  // Reinhard Tone Mappingを行うか
+  Real exposure = 1;          // 露光(Tone Mapping)
+  Real gamma = 1;             // ガンマ値(1ならガンマ補正を行わない)
+};
+
+// n画素のRGBを変換してoutに書き込む
+// サンプル数での除算、Tone Mapping、ガンマ補正を1回の走査でまとめて行う
+// samplesがnullptrでなければ、画素ごとにsamplesの値で割る
+// ループは分岐を含まないので、コンパイラの自動ベクトル化が効く
+void postProcess(const Real* in, const unsigned int* samples, unsigned int n,
+                 const PostProcessSettings& settings, float* out);
+
+// x^yを近似計算する(x <= 0の場合は0を返す)
+// log2とexp2を多項式で近似し、相対誤差は1e-5程度
+float fastPow(float x, float y);
+
+}  // namespace Prl2
+
+#endif
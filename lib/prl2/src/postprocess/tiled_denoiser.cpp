@@ -0,0 +1,260 @@
+#include "postprocess/tiled_denoiser.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "OpenImageDenoise/oidn.h"
+
+namespace Prl2 {
+
+namespace {
+
+// 1次元のタイルの範囲
+struct TileSpan {
+  unsigned int core0, core1;    // 余白を除いた範囲
+  unsigned int input0, input1;  // 余白を含めてデノイズする範囲
+  unsigned int blend0, blend1;  // 結果を書き出す範囲
+};
+
+// size[px]を長さtile_sizeのタイルに分割する
+// 入力の範囲は全てのタイルで同じ長さになるように画像の内側にずらす
+// こうするとフィルターの設定を全てのタイルで使い回せる
+std::vector<TileSpan> splitSpans(unsigned int size, unsigned int tile_size,
+                                 unsigned int overlap, unsigned int half) {
+  const unsigned int input_size = std::min(tile_size + 2 * overlap, size);
+  std::vector<TileSpan> spans;
+  for (unsigned int core0 = 0; core0 < size; core0 += tile_size) {
+    TileSpan span;
+    span.core0 = core0;
+    span.core1 = std::min(core0 + tile_size, size);
+    const int input0 = static_cast<int>(core0) - static_cast<int>(overlap);
+    span.input0 = static_cast<unsigned int>(
+        std::clamp(input0, 0, static_cast<int>(size - input_size)));
+    span.input1 = span.input0 + input_size;
+    span.blend0 = span.core0 > 0 ? span.core0 - half : 0;
+    span.blend1 = std::min(span.core1 + half, size);
+    spans.push_back(span);
+  }
+  return spans;
+}
+
+// タイルの境界で隣のタイルと混ぜる重み
+// 境界をまたぐ幅2 * halfの帯で線形に変化させ、隣のタイルと合計が1になるようにする
+Real blendWeight(unsigned int x, const TileSpan& span, unsigned int size,
+                 unsigned int half) {
+  const Real p = x + 0.5f;
+  Real w = 1;
+  if (span.core0 > 0) {
+    w *= half > 0 ? std::clamp((p - (span.core0 - Real(half))) / (2 * half),
+                               Real(0), Real(1))
+                  : Real(x >= span.core0);
+  }
+  if (span.core1 < size) {
+    w *= half > 0 ? std::clamp(((span.core1 + Real(half)) - p) / (2 * half),
+                               Real(0), Real(1))
+                  : Real(x < span.core1);
+  }
+  return w;
+}
+
+}  // namespace
+
+TiledDenoiser::TiledDenoiser(unsigned int _tile_size, unsigned int _overlap,
+                             unsigned int _max_memory_mb)
+    : tile_size(std::max(_tile_size, 1U)),
+      overlap(_overlap),
+      max_memory_mb(_max_memory_mb) {}
+
+unsigned int TiledDenoiser::getTileBufferMemoryMB() const {
+  // color, albedo, normal, outputの4枚
+  const std::size_t input_size = tile_size + 2 * overlap;
+  const std::size_t bytes = 4 * 3 * sizeof(Real) * input_size * input_size;
+  return static_cast<unsigned int>((bytes + (1 << 20) - 1) >> 20);
+}
+
+unsigned int TiledDenoiser::getNumWorkers() const {
+  if (max_memory_mb == 0) {
+    return 1;
+  }
+  const unsigned int per_worker =
+      getTileBufferMemoryMB() + MIN_FILTER_MEMORY_MB;
+  return std::clamp(max_memory_mb / per_worker, 1U,
+                    std::max(std::thread::hardware_concurrency(), 1U));
+}
+
+bool TiledDenoiser::denoise(unsigned int width, unsigned int height,
+                            const TileReader& reader,
+                            const TileWriter& writer) const {
+  // 混ぜる帯の半分の幅
+  // 帯が重ならないようにタイルの半分以下にする
+  const unsigned int half = std::min(overlap / 2, tile_size / 2);
+  const std::vector<TileSpan> spans_x =
+      splitSpans(width, tile_size, overlap, half);
+  const std::vector<TileSpan> spans_y =
+      splitSpans(height, tile_size, overlap, half);
+  const unsigned int num_tiles = spans_x.size() * spans_y.size();
+  if (num_tiles == 0) {
+    return true;
+  }
+
+  const unsigned int num_workers = std::min(getNumWorkers(), num_tiles);
+  const unsigned int num_threads =
+      std::max(std::thread::hardware_concurrency(), 1U);
+
+  std::atomic<unsigned int> next_tile(0);
+  std::atomic<bool> failed(false);
+  std::mutex writer_mutex;
+
+  // タイルを順に取り出してデノイズする
+  // デバイスとフィルターはスレッドごとに作り、全てのタイルで使い回す
+  const auto work = [&]() {
+    OIDNDevice device = oidnNewDevice(OIDN_DEVICE_TYPE_DEFAULT);
+    if (num_workers > 1) {
+      const unsigned int worker_threads =
+          std::max(num_threads / num_workers, 1U);
+      oidnSetDevice1i(device, "numThreads",
+                      static_cast<int>(worker_threads));
+    }
+    oidnCommitDevice(device);
+
+    OIDNFilter filter = oidnNewFilter(device, "RT");
+    oidnSetFilter1b(filter, "hdr", true);
+    if (max_memory_mb > 0) {
+      const unsigned int filter_memory_mb =
+          std::max(max_memory_mb / num_workers, getTileBufferMemoryMB()) -
+          getTileBufferMemoryMB();
+      oidnSetFilter1i(
+          filter, "maxMemoryMB",
+          static_cast<int>(std::max(filter_memory_mb, MIN_FILTER_MEMORY_MB)));
+    }
+
+    // 入力の範囲は全てのタイルで同じ大きさ
+    const unsigned int tw = spans_x[0].input1 - spans_x[0].input0;
+    const unsigned int th = spans_y[0].input1 - spans_y[0].input0;
+    std::vector<Real> color(3 * tw * th);
+    std::vector<Real> albedo(3 * tw * th);
+    std::vector<Real> normal(3 * tw * th);
+    std::vector<Real> output(3 * tw * th);
+    std::vector<Real> blended;
+    oidnSetSharedFilterImage(filter, "color", color.data(), OIDN_FORMAT_FLOAT3,
+                             tw, th, 0, 0, 0);
+    oidnSetSharedFilterImage(filter, "albedo", albedo.data(),
+                             OIDN_FORMAT_FLOAT3, tw, th, 0, 0, 0);
+    oidnSetSharedFilterImage(filter, "normal", normal.data(),
+                             OIDN_FORMAT_FLOAT3, tw, th, 0, 0, 0);
+    oidnSetSharedFilterImage(filter, "output", output.data(),
+                             OIDN_FORMAT_FLOAT3, tw, th, 0, 0, 0);
+    oidnCommitFilter(filter);
+
+    for (unsigned int tile = next_tile++; tile < num_tiles && !failed;
+         tile = next_tile++) {
+      const TileSpan& sx = spans_x[tile % spans_x.size()];
+      const TileSpan& sy = spans_y[tile / spans_x.size()];
+
+      reader(sx.input0, sy.input0, sx.input1, sy.input1, color.data(),
+             albedo.data(), normal.data());
+      oidnExecuteFilter(filter);
+
+      const char* errorMessage;
+      if (oidnGetDeviceError(device, &errorMessage) != OIDN_ERROR_NONE) {
+        std::cerr << "Error: " << errorMessage << std::endl;
+        failed = true;
+        break;
+      }
+
+      // 書き出す範囲を切り出して重みを掛ける
+      const unsigned int bw = sx.blend1 - sx.blend0;
+      const unsigned int bh = sy.blend1 - sy.blend0;
+      blended.resize(3 * bw * bh);
+      for (unsigned int j = 0; j < bh; ++j) {
+        const unsigned int y = sy.blend0 + j;
+        const Real wy = blendWeight(y, sy, height, half);
+        for (unsigned int i = 0; i < bw; ++i) {
+          const unsigned int x = sx.blend0 + i;
+          const Real w = wy * blendWeight(x, sx, width, half);
+          const unsigned int src =
+              3 * ((x - sx.input0) + tw * (y - sy.input0));
+          blended[3 * (i + bw * j) + 0] = w * output[src + 0];
+          blended[3 * (i + bw * j) + 1] = w * output[src + 1];
+          blended[3 * (i + bw * j) + 2] = w * output[src + 2];
+        }
+      }
+
+      // 隣のタイルと書き出す範囲が重なるので1つずつ書き出す
+      std::lock_guard<std::mutex> lock(writer_mutex);
+      writer(sx.blend0, sy.blend0, sx.blend1, sy.blend1, blended.data());
+    }
+
+    oidnReleaseFilter(filter);
+    oidnReleaseDevice(device);
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned int k = 0; k < num_workers; ++k) {
+    workers.emplace_back(work);
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  return !failed;
+}
+
+bool PFMTileWriter::open(const std::string& filename, unsigned int _width,
+                         unsigned int _height) {
+  width = _width;
+  height = _height;
+
+  // ヘッダと0で埋めた画素を書き込む
+  {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      return false;
+    }
+    out << "PF" << std::endl;
+    out << width << " " << height << std::endl;
+    out << "-1.0" << std::endl;
+    data_offset = out.tellp();
+
+    const std::vector<float> row(3 * width, 0);
+    for (unsigned int j = 0; j < height; ++j) {
+      out.write(reinterpret_cast<const char*>(row.data()),
+                static_cast<std::streamsize>(sizeof(float) * row.size()));
+    }
+    if (!out) {
+      return false;
+    }
+  }
+
+  file.open(filename, std::ios::binary | std::ios::in | std::ios::out);
+  return file.good();
+}
+
+void PFMTileWriter::add(unsigned int x0, unsigned int y0, unsigned int x1,
+                        unsigned int y1, const Real* rgb) {
+  // PFMは下の行から並ぶので行ごとに読み込んで足し、書き戻す
+  std::vector<float> row(3 * (x1 - x0));
+  const std::streamsize bytes =
+      static_cast<std::streamsize>(sizeof(float) * row.size());
+  for (unsigned int y = y0; y < y1; ++y) {
+    const std::streamoff pixel =
+        (height - 1 - y) * static_cast<std::streamoff>(width) + x0;
+    const std::streamoff offset =
+        data_offset + static_cast<std::streamoff>(sizeof(float)) * 3 * pixel;
+    file.seekg(offset);
+    file.read(reinterpret_cast<char*>(row.data()), bytes);
+    for (std::size_t k = 0; k < row.size(); ++k) {
+      row[k] += rgb[3 * (x1 - x0) * (y - y0) + k];
+    }
+    file.seekp(offset);
+    file.write(reinterpret_cast<const char*>(row.data()), bytes);
+  }
+}
+
+void PFMTileWriter::close() { file.close(); }
+
+}  // namespace Prl2
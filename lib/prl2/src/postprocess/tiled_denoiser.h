@@ -0,0 +1,87 @@
+#ifndef _PRL2_TILED_DENOISER_H
+#define _PRL2_TILED_DENOISER_H
+
+#include <fstream>
+#include <functional>
+#include <string>
+
+#include "core/type.h"
+
+namespace Prl2 {
+
+// 画像をタイルに分割してOIDNでデノイズするクラス
+// 大きな画像でもメモリ使用量がタイルの大きさと同時に処理するタイル数で決まる
+//
+// 各タイルは周囲にoverlap[px]の余白を付けてデノイズし、
+// 余白の内側半分は隣のタイルと線形に重みを変えて混ぜる(残りは文脈として使うだけ)
+// 重みはどの画素でも合計が1になるので、結果は出力先に足し込むだけでよい
+class TiledDenoiser {
+ public:
+  // 入力を読み込む関数
+  // 範囲[x0, x1) x [y0, y1)の画素をcolor, albedo, normalに行ごとに書き込む
+  using TileReader = std::function<void(
+      unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1,
+      Real* color, Real* albedo, Real* normal)>;
+
+  // 結果を書き出す関数
+  // 範囲[x0, x1) x [y0, y1)の画素に重みを掛けた値rgbが行ごとに渡されるので、
+  // 出力先に足し込む(出力先は0で初期化しておく)
+  // 呼び出しは1つずつ行われる
+  using TileWriter = std::function<void(unsigned int x0, unsigned int y0,
+                                        unsigned int x1, unsigned int y1,
+                                        const Real* rgb)>;
+
+  // tile_size: タイルの一辺の長さ[px](余白を除く)
+  // overlap: タイルの余白の幅[px]
+  // max_memory_mb: 全体で使うメモリの上限[MB](0なら制限せずにタイルを1つずつ処理)
+  TiledDenoiser(unsigned int _tile_size, unsigned int _overlap,
+                unsigned int _max_memory_mb = 0);
+
+  // width x heightの画像をデノイズする
+  // エラーが起きた場合はfalseを返す
+  bool denoise(unsigned int width, unsigned int height,
+               const TileReader& reader, const TileWriter& writer) const;
+
+  // 同時に処理するタイルの数を入手する
+  unsigned int getNumWorkers() const;
+
+ private:
+  const unsigned int tile_size;      // タイルの一辺の長さ[px]
+  const unsigned int overlap;        // タイルの余白の幅[px]
+  const unsigned int max_memory_mb;  // メモリの上限[MB]
+
+  // OIDNのフィルターに最低限割り当てるメモリ[MB]
+  static constexpr unsigned int MIN_FILTER_MEMORY_MB = 256;
+
+  // 1つのタイルの入出力のバッファの大きさ[MB]
+  unsigned int getTileBufferMemoryMB() const;
+};
+
+// デノイズの結果をPFM画像としてファイルに直接足し込むクラス
+// 画像全体をメモリに置かずに、TiledDenoiserの結果をタイルごとに書き出せる
+class PFMTileWriter {
+ public:
+  PFMTileWriter(){};
+
+  // 0で埋めたwidth x heightのPFM画像を作成する
+  bool open(const std::string& filename, unsigned int width,
+            unsigned int height);
+
+  // 範囲[x0, x1) x [y0, y1)にrgbを足し込む
+  void add(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1,
+           const Real* rgb);
+
+  void close();
+
+  bool good() const { return file.good(); };
+
+ private:
+  std::fstream file;
+  std::streamoff data_offset = 0;  // 画素データの先頭
+  unsigned int width = 0;
+  unsigned int height = 0;
+};
+
+}  // namespace Prl2
+
+#endif
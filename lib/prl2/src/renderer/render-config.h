@@ -4,8 +4,10 @@
 #include <atomic>
 #include <string>
 
+#include "camera/film.h"
 #include "core/type.h"
 #include "core/vec3.h"
+#include "io/io.h"
 
 namespace Prl2 {
 
@@ -33,8 +35,20 @@ enum class SkyType { Uniform, Hosek, IBL };
 // Cameraの種類
 enum class CameraType { Pinhole, Environment, ThinLens };
 
+// Intersectorの種類
+// EmbreeはEmbreeを見つけてビルドした(PRL2_USE_EMBREEが定義されている)場合だけ使える
+enum class IntersectorType { Embree, BVH };
+
+// 既定のIntersectorの種類
+#ifdef PRL2_USE_EMBREE
+constexpr IntersectorType DEFAULT_INTERSECTOR_TYPE = IntersectorType::Embree;
+#else
+constexpr IntersectorType DEFAULT_INTERSECTOR_TYPE = IntersectorType::BVH;
+#endif
+
 // Integratorの種類
-enum class IntegratorType { PT, NEE };
+// WavefrontはPTと同じ推定をタイル単位でまとめて行う
+enum class IntegratorType { PT, NEE, Wavefront };
 
 // レンダリングの設定を表すクラス
 // 画像のサイズ、サンプル数、カメラの種類、シーンファイルの種類などを設定する
@@ -47,10 +61,42 @@ struct RenderConfig {
   bool render_interactive =
       false;  // 画面全体を描画してからサンプルを蓄積するか
 
+  // Adaptive Sampling
+  // 画素ごとの相対誤差に応じてサンプルを配分する(render_interactive=falseの場合)
+  // 画面全体のサンプル数はsamples x 画素数のまま変わらない
+  bool render_adaptive = false;            // Adaptive Samplingを行うか
+  unsigned int adaptive_min_samples = 16;  // 1パスあたりの画素の平均サンプル数
+  Real adaptive_threshold =
+      0.01f;  // 相対誤差がこの値を下回った画素はサンプリングを止める
+
+  // Denoise
+  unsigned int denoise_interval =
+      0;  // Interactive時にデノイズするパスの間隔(0ならデノイズしない)
+  // 大きな画像はタイルに分割してデノイズする(denoise, denoiseToFile)
+  unsigned int denoise_tile_size =
+      0;  // タイルの一辺の長さ[px](0なら画像全体を一度にデノイズする)
+  unsigned int denoise_tile_overlap = 128;  // タイルの余白の幅[px]
+  unsigned int denoise_max_memory_mb =
+      0;  // タイルのデノイズに使うメモリの上限[MB](0ならタイルを1つずつ処理)
+
   // Output
   LayerType layer_type = LayerType::Render;  // 出力レイヤーの種類
   ImageType image_type = ImageType::PPM;     // 出力画像形式
 
+  // Multi-Layer EXR(saveAllLayers)
+  EXRCompression exr_compression = EXRCompression::ZIP;  // 圧縮方式
+  unsigned int exr_tile_size =
+      64;  // タイルの一辺の長さ[px](0ならスキャンライン)
+
+  // AOV
+  // 無効にしたレイヤーはレンダリング中に計算されず、0のままになる
+  bool aov_albedo = true;    // Albedo Layerを計算するか(Denoiseで使う)
+  bool aov_normal = true;    // Normal Layerを計算するか(Denoiseで使う)
+  bool aov_uv = true;        // UV Layerを計算するか
+  bool aov_position = true;  // Position Layerを計算するか
+  bool aov_depth = true;     // Depth Layerを計算するか
+  bool aov_sample = true;    // Sample Layerを計算するか
+
   // Post Process
   Real exposure = 1.0;                // 露光
   Real gamma = 2.2;                   // ガンマ値
@@ -63,6 +109,8 @@ struct RenderConfig {
   unsigned int height = 512;     //画像の縦幅[px]
   Real width_length = 0.0251f;   //フィルムの横幅[m]
   Real height_length = 0.0251f;  //フィルムの縦幅[m]
+  FilmType film_type =
+      FilmType::Spectral;  // フィルムの種類(分光情報が不要ならCIEXYZで省メモリ)
 
   // Camera
   CameraType camera_type = CameraType::Pinhole;  // カメラの種類
@@ -79,7 +127,12 @@ struct RenderConfig {
       1.0f;  // フィルム面からピントが合う面までの距離
 
   // Scene
-  std::string scene_file;  //シーンファイル
+  std::string scene_file;   //シーンファイル
+  bool scene_cache = true;  // シーンキャッシュを使うか
+
+  // Intersector
+  IntersectorType intersector_type =
+      DEFAULT_INTERSECTOR_TYPE;  // Intersectorの種類
 
   // Sky
   SkyType sky_type = SkyType::Uniform;  // 空の種類
@@ -99,7 +152,7 @@ struct RenderConfig {
   std::string sampler_type;  // Samplerの種類
 
   // Integrator
-  IntegratorType integrator_type;  // Integratorの種類
+  IntegratorType integrator_type = IntegratorType::PT;  // Integratorの種類
 
   // Renderer
   unsigned int samples = 10;  //サンプル数
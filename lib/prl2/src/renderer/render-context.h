@@ -0,0 +1,41 @@
+#ifndef _PRL2_RENDER_CONTEXT_H
+#define _PRL2_RENDER_CONTEXT_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "integrator/integrator.h"
+#include "sampler/sampler.h"
+
+namespace Prl2 {
+
+// レンダリングスレッドごとに持つ作業領域
+// スレッドごとに一度だけ作成し、画素やサンプルごとに作り直さずに使い回す
+// 他のスレッドとキャッシュラインを共有しないようにアラインする
+struct alignas(64) RenderContext {
+  RenderContext(std::unique_ptr<Sampler>&& _sampler)
+      : sampler(std::move(_sampler)), num_samples(0), num_nan(0){};
+
+  // 統計をクリアする
+  void clearStats() {
+    num_samples.store(0, std::memory_order_relaxed);
+    num_nan = 0;
+  };
+
+  std::unique_ptr<Sampler> sampler;  // 画素ごとにシードを設定し直すSampler
+  IntegratorResult result;  // Integratorの結果(Pathの配列の容量を使い回す)
+
+  std::vector<PixelSample>
+      wave_samples;  // Wavefrontでまとめて計算する画素サンプル
+  std::vector<IntegratorResult> wave_results;  // Wavefrontの結果
+  WaveWorkspace wave_workspace;  // Wavefrontのパスの状態とキュー
+
+  std::atomic<uint64_t> num_samples;  // 計算したサンプル数(Progress用)
+  uint64_t num_nan;                   // NaNが検出されたサンプル数
+};
+
+}  // namespace Prl2
+
+#endif
@@ -4,7 +4,6 @@ namespace Prl2 {
 
 RenderLayer::RenderLayer(const RenderConfig& config) {
   render_sRGB.resize(3 * config.width * config.height, 0);
-  denoised_sRGB.resize(3 * config.width * config.height, 0);
   albedo_sRGB.resize(3 * config.width * config.height, 0);
   normal_sRGB.resize(3 * config.width * config.height, 0);
   uv_sRGB.resize(3 * config.width * config.height, 0);
@@ -12,11 +11,11 @@ RenderLayer::RenderLayer(const RenderConfig& config) {
   position_sRGB.resize(3 * config.width * config.height, 0);
   samples.resize(config.width * config.height, 1);
   sample_sRGB.resize(3 * config.width * config.height, 0);
+  render_moment.resize(config.width * config.height, 0);
 }
 
 void RenderLayer::resize(unsigned int width, unsigned int height) {
   render_sRGB.resize(3 * width * height, 0);
-  denoised_sRGB.resize(3 * width * height, 0);
   albedo_sRGB.resize(3 * width * height, 0);
   normal_sRGB.resize(3 * width * height, 0);
   uv_sRGB.resize(3 * width * height, 0);
@@ -24,11 +23,11 @@ void RenderLayer::resize(unsigned int width, unsigned int height) {
   position_sRGB.resize(3 * width * height, 0);
   samples.resize(width * height, 1);
   sample_sRGB.resize(3 * width * height, 0);
+  render_moment.resize(width * height, 0);
 }
 
 void RenderLayer::clear() {
   std::fill(render_sRGB.begin(), render_sRGB.end(), 0);
-  std::fill(denoised_sRGB.begin(), denoised_sRGB.end(), 0);
   std::fill(albedo_sRGB.begin(), albedo_sRGB.end(), 0);
   std::fill(normal_sRGB.begin(), normal_sRGB.end(), 0);
   std::fill(uv_sRGB.begin(), uv_sRGB.end(), 0);
@@ -36,6 +35,7 @@ void RenderLayer::clear() {
   std::fill(position_sRGB.begin(), position_sRGB.end(), 0);
   std::fill(samples.begin(), samples.end(), 1);
   std::fill(sample_sRGB.begin(), sample_sRGB.end(), 0);
+  std::fill(render_moment.begin(), render_moment.end(), 0);
 }
 
 void RenderLayer::clearPixel(unsigned int i, unsigned int j, unsigned int width,
@@ -44,10 +44,6 @@ void RenderLayer::clearPixel(unsigned int i, unsigned int j, unsigned int width,
   render_sRGB[3 * i + 3 * width * j + 1] = 0;
   render_sRGB[3 * i + 3 * width * j + 2] = 0;
 
-  denoised_sRGB[3 * i + 3 * width * j] = 0;
-  denoised_sRGB[3 * i + 3 * width * j + 1] = 0;
-  denoised_sRGB[3 * i + 3 * width * j + 2] = 0;
-
   albedo_sRGB[3 * i + 3 * width * j] = 0;
   albedo_sRGB[3 * i + 3 * width * j + 1] = 0;
   albedo_sRGB[3 * i + 3 * width * j + 2] = 0;
@@ -73,6 +69,8 @@ void RenderLayer::clearPixel(unsigned int i, unsigned int j, unsigned int width,
   sample_sRGB[3 * i + 3 * width * j] = 0;
   sample_sRGB[3 * i + 3 * width * j + 1] = 0;
   sample_sRGB[3 * i + 3 * width * j + 2] = 0;
+
+  render_moment[i + width * j] = 0;
 }
 
 }  // namespace Prl2
\ No newline at end of file
@@ -27,7 +27,6 @@ struct RenderLayer {
                   unsigned int height);
 
   std::vector<Real> render_sRGB;  // レンダリング結果をsRGBにしたものを格納する
-  std::vector<Real> denoised_sRGB;  // デノイズされたsRGBを格納する
   std::vector<Real> albedo_sRGB;  // AlbedoをsRGBにしたものを格納する
   std::vector<Real> normal_sRGB;  // 法線をsRGBにしたものを格納する
   std::vector<Real> uv_sRGB;  // UV座標をsRGBにしたものを格納する
@@ -36,6 +35,8 @@ struct RenderLayer {
   std::vector<unsigned int> samples;  // サンプル数を格納する
   std::vector<Real>
       sample_sRGB;  // 最初のサンプリング方向をsRGBにしたものを格納する
+  std::vector<Real>
+      render_moment;  // サンプルの輝度(Y)の2乗和を格納する(Adaptive Sampling用)
 };
 
 }  // namespace Prl2
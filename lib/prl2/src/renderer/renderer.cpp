@@ -1,5 +1,8 @@
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <iostream>
+#include <utility>
 
 #include "camera/environment.h"
 #include "camera/pinhole.h"
@@ -8,9 +11,10 @@
 #include "integrator/ao.h"
 #include "integrator/nee.h"
 #include "integrator/pt.h"
+#include "integrator/wavefront.h"
 #include "light/light.h"
 #include "parallel/parallel.h"
-#include "postprocess/tone_mapping.h"
+#include "postprocess/postprocess.h"
 #include "renderer/renderer.h"
 #include "renderer/scene-loader.h"
 #include "sampler/random.h"
@@ -18,8 +22,6 @@
 #include "sky/ibl_sky.h"
 #include "sky/uniform_sky.h"
 
-#include "OpenImageDenoise/oidn.h"
-
 namespace Prl2 {
 
 void Renderer::loadConfig(const RenderConfig& _config) {
@@ -31,6 +33,12 @@ void Renderer::loadConfig(const RenderConfig& _config) {
 
   // シーンファイルの読み込み
   if (!config.scene_file.empty()) {
+    scene.primitives.clear();
+    if (!loadSceneFromObj(config.scene_file, scene, config.scene_cache,
+                          config.intersector_type)) {
+      std::cerr << "failed to load scene file: " << config.scene_file
+                << std::endl;
+    }
   }
 
   // Skyの設定
@@ -54,114 +62,140 @@ void Renderer::loadConfig(const RenderConfig& _config) {
     sampler = std::make_shared<RandomSampler>();
   }
 
+  // レンダリングスレッドごとの作業領域の設定
+  initRenderContexts();
+
   // Integratorの設定
-  /*
-  if (!config.integrator_type.empty()) {
-    if (config.integrator_type == "PT") {
-      integrator = std::make_shared<PT>();
-    } else {
-      std::cerr << "invalid integrator type" << std::endl;
-      std::exit(EXIT_FAILURE);
-    }
-  } else {
-    integrator = std::make_shared<PT>();
+  setIntegratorType(config.integrator_type);
+}
+
+void Renderer::initRenderContexts() {
+  contexts.clear();
+  for (unsigned int k = 0; k < pool.getNumThreads(); ++k) {
+    contexts.push_back(std::make_unique<RenderContext>(sampler->clone(k)));
   }
-  */
-  integrator = std::make_shared<PT>();
 }
 
 void Renderer::renderPixel(unsigned int i, unsigned int j,
-                           Sampler& pixel_sampler) {
-  // Primary Rayで計算できるものを計算
-  {
-    Vec2 pFilm = scene.camera->sampleFilm(i, j, pixel_sampler);
-    Ray ray;
-    ray.lambda = 550;
-    Real camera_cos, camera_pdf;
-    if (scene.camera->generateRay(pFilm, pixel_sampler, ray, camera_cos,
-                                  camera_pdf)) {
-      IntersectInfo info;
-      if (scene.intersector->intersect(ray, info)) {
-        // Normal LayerにsRGBを加算
-        layer.normal_sRGB[3 * i + 3 * config.width * j + 0] +=
-            0.5f * (info.hitNormal.x() + 1.0f);
-        layer.normal_sRGB[3 * i + 3 * config.width * j + 1] +=
-            0.5f * (info.hitNormal.y() + 1.0f);
-        layer.normal_sRGB[3 * i + 3 * config.width * j + 2] +=
-            0.5f * (info.hitNormal.z() + 1.0f);
-
-        // UV LayerにsRGBを加算
-        layer.uv_sRGB[3 * i + 3 * config.width * j + 0] += info.uv.x();
-        layer.uv_sRGB[3 * i + 3 * config.width * j + 1] += info.uv.y();
-        layer.uv_sRGB[3 * i + 3 * config.width * j + 2] += 0;
-
-        // Depth LayerにsRGBを加算
-        layer.depth_sRGB[3 * i + 3 * config.width * j + 0] += info.t;
-        layer.depth_sRGB[3 * i + 3 * config.width * j + 1] += info.t;
-        layer.depth_sRGB[3 * i + 3 * config.width * j + 2] += info.t;
-
-        // Position LayerにsRGBを加算
-        layer.position_sRGB[3 * i + 3 * config.width * j + 0] +=
-            info.hitPos.x();
-        layer.position_sRGB[3 * i + 3 * config.width * j + 1] +=
-            info.hitPos.y();
-        layer.position_sRGB[3 * i + 3 * config.width * j + 2] +=
-            info.hitPos.z();
-
-        // Sample LayerにsRGBを格納
-        Vec3 wi;
-        Real cos, pdf;
-        info.hitPrimitive->sampleBRDF(-ray.direction, info.hitNormal,
-                                      ray.lambda, pixel_sampler, wi, cos, pdf);
-        layer.sample_sRGB[3 * i + 3 * config.width * j + 0] +=
-            0.5f * (wi.x() + 1.0f);
-        layer.sample_sRGB[3 * i + 3 * config.width * j + 1] +=
-            0.5f * (wi.y() + 1.0f);
-        layer.sample_sRGB[3 * i + 3 * config.width * j + 2] +=
-            0.5f * (wi.z() + 1.0f);
-
-        // Albedo Layerの計算
-        MaterialArgs args;
-        args.lambda = ray.lambda;
-        const RGB albedo = info.hitPrimitive->getMaterial()->albedoRGB(args);
-        const Real albedo_max =
-            std::max(std::max(albedo.x(), albedo.y()), albedo.z());
-        layer.albedo_sRGB[3 * i + 3 * config.width * j + 0] +=
-            albedo.x() / albedo_max;
-        layer.albedo_sRGB[3 * i + 3 * config.width * j + 1] +=
-            albedo.y() / albedo_max;
-        layer.albedo_sRGB[3 * i + 3 * config.width * j + 2] +=
-            albedo.z() / albedo_max;
+                           RenderContext& context) {
+  IntegratorResult& result = context.result;
+  result.clear();
+  if (integrator->integrate(i, j, scene, *context.sampler, result)) {
+    splatSample(i, j, result, context);
+  }
+}
+
+void Renderer::splatSample(unsigned int i, unsigned int j,
+                           const IntegratorResult& result,
+                           RenderContext& context) {
+  if (!result.phi.hasNaN()) {
+    // フィルムに波長ごとの分光放射束を加算
+    // 打ち切られた波長は加算しない
+    Real y = 0;
+    for (unsigned int k = 0; k < WAVELENGTH_SAMPLES; ++k) {
+      if (result.lambda.pdf[k] == 0) {
+        continue;
       }
+      scene.camera->film->addPixel(i, j, result.lambda[k], result.phi[k]);
+
+      if (config.render_adaptive) {
+        y += SPD::toXYZ(result.lambda[k], result.phi[k]).y();
+      }
+    }
+
+    // 輝度の2乗和を加算(Adaptive Sampling用)
+    if (config.render_adaptive) {
+      layer.render_moment[i + config.width * j] += y * y;
     }
+  } else {
+    context.num_nan++;
   }
 
-  IntegratorResult result;
-  if (integrator->integrate(i, j, scene, pixel_sampler, result)) {
-    if (!std::isnan(result.phi)) {
-      // フィルムに分光放射束を加算
-      scene.camera->film->addPixel(i, j, result.lambda, result.phi);
-    } else {
-      std::cerr << "nan detected at (" << i << ", " << j << ")" << std::endl;
+  // Integratorが書き込んだ最初の衝突情報からAOVを計算
+  // 有効になっていないレイヤーは計算しない
+  if (result.first_hit) {
+    const IntersectInfo& info = result.first_info;
+    const unsigned int index = 3 * i + 3 * config.width * j;
+
+    // Normal LayerにsRGBを加算
+    if (config.aov_normal) {
+      layer.normal_sRGB[index + 0] += 0.5f * (info.hitNormal.x() + 1.0f);
+      layer.normal_sRGB[index + 1] += 0.5f * (info.hitNormal.y() + 1.0f);
+      layer.normal_sRGB[index + 2] += 0.5f * (info.hitNormal.z() + 1.0f);
+    }
+
+    // UV LayerにsRGBを加算
+    if (config.aov_uv) {
+      layer.uv_sRGB[index + 0] += info.uv.x();
+      layer.uv_sRGB[index + 1] += info.uv.y();
+    }
+
+    // Depth LayerにsRGBを加算
+    if (config.aov_depth) {
+      layer.depth_sRGB[index + 0] += info.t;
+      layer.depth_sRGB[index + 1] += info.t;
+      layer.depth_sRGB[index + 2] += info.t;
+    }
+
+    // Position LayerにsRGBを加算
+    if (config.aov_position) {
+      layer.position_sRGB[index + 0] += info.hitPos.x();
+      layer.position_sRGB[index + 1] += info.hitPos.y();
+      layer.position_sRGB[index + 2] += info.hitPos.z();
+    }
+
+    // Sample LayerにsRGBを加算
+    // Integratorが実際にサンプリングした方向を使う
+    if (config.aov_sample) {
+      const Vec3& wi = result.first_wi;
+      layer.sample_sRGB[index + 0] += 0.5f * (wi.x() + 1.0f);
+      layer.sample_sRGB[index + 1] += 0.5f * (wi.y() + 1.0f);
+      layer.sample_sRGB[index + 2] += 0.5f * (wi.z() + 1.0f);
+    }
+
+    // Albedo LayerにsRGBを加算
+    if (config.aov_albedo) {
+      MaterialArgs args;
+      args.lambda = result.lambda;
+      const RGB albedo = info.hitPrimitive->getMaterial()->albedoRGB(args);
+      const Real albedo_max =
+          std::max(std::max(albedo.x(), albedo.y()), albedo.z());
+      layer.albedo_sRGB[index + 0] += albedo.x() / albedo_max;
+      layer.albedo_sRGB[index + 1] += albedo.y() / albedo_max;
+      layer.albedo_sRGB[index + 2] += albedo.z() / albedo_max;
     }
   }
 
-  // Render LayerにsRGBを書き込み
-  const RGB rgb = scene.camera->film->getPixel(i, j).toRGB();
+  // Render LayerのsRGBは画素のサンプリングが終わった時にまとめて計算する
+}
+
+void Renderer::resolveRenderPixel(unsigned int i, unsigned int j) {
+  const RGB rgb = scene.camera->film->getRGB(i, j);
   layer.render_sRGB[3 * i + 3 * config.width * j] = rgb.x();
   layer.render_sRGB[3 * i + 3 * config.width * j + 1] = rgb.y();
   layer.render_sRGB[3 * i + 3 * config.width * j + 2] = rgb.z();
 }
 
 void Renderer::render(const std::atomic<bool>& cancel) {
-  // Progressを初期化
-  num_rendered_pixels = 0;
+  // レンダリング中はレイヤーを読むデノイズを他のスレッドから開始させない
+  std::unique_lock<std::mutex> render_lock(render_mutex);
+
+  // Progress, 統計を初期化
+  for (const auto& context : contexts) {
+    context->clearStats();
+  }
 
   // 時間計測
   decltype(std::chrono::system_clock::now()) start_time, finish_time;
 
+  // 画素ごとの誤差に応じてサンプル数を配分する場合
+  if (!config.render_interactive && config.render_adaptive) {
+    start_time = std::chrono::system_clock::now();
+    renderAdaptive(cancel);
+    finish_time = std::chrono::system_clock::now();
+  }
   // 画素ごとにサンプリングを繰り返す場合
-  if (!config.render_interactive) {
+  else if (!config.render_interactive) {
     // レイヤーを初期化
     layer.clear();
 
@@ -176,62 +210,50 @@ void Renderer::render(const std::atomic<bool>& cancel) {
     }
 
     start_time = std::chrono::system_clock::now();
-    pool.parallelFor2D(
-        [&](unsigned int i, unsigned int j) {
-          // Samplerを画素ごとに用意する
-          const std::unique_ptr<Sampler> pixel_sampler =
-              sampler->clone(i + config.width * j);
-
-          //サンプリングを繰り返す
-          for (unsigned int k = 0; k < config.samples; ++k) {
-            if (cancel) {
-              break;
-            }
-
-            renderPixel(i, j, *pixel_sampler);
-
-            // Progressを加算
-            num_rendered_pixels += 1;
-          }
-        },
-        config.render_tiles_x, config.render_tiles_y, config.width,
-        config.height);
+    if (integrator->isWavefront()) {
+      renderWavefront(cancel);
+    } else {
+      renderProgressive(cancel);
+    }
     finish_time = std::chrono::system_clock::now();
   }
   // 1回のサンプリングで画面全体を描画する場合
   // Interactiveに操作する場合に向いている
   else {
-    // Samplerを画素ごとに用意する
-    std::vector<std::unique_ptr<Sampler>> samplers(config.width *
-                                                   config.height);
-    for (unsigned int j = 0; j < config.height; ++j) {
-      for (unsigned int i = 0; i < config.width; ++i) {
-        samplers[i + config.width * j] = sampler->clone(i + config.width * j);
-      }
-    }
+    // Samplerの状態を画素ごとに保存する配列を用意する
+    sampler_states.resize(config.width * config.height);
 
     start_time = std::chrono::system_clock::now();
     for (unsigned int k = 1; k <= config.samples; ++k) {
       pool.parallelFor2D(
-          [&](unsigned int i, unsigned int j) {
+          [&](unsigned int i, unsigned int j, unsigned int thread_id) {
+            // 最低でも1回は描画してからキャンセルする
+            // 見た目が良くなる
+            if (k > 1 && cancel) {
+              return;
+            }
+
+            // スレッドの作業領域を取得する
+            RenderContext& context = *contexts[thread_id];
+            const unsigned int index = i + config.width * j;
+
             // Layer, Filmの初期化
             // 各スレッドでkが異なる可能性があるので、ここで初期化処理を行うと見た目が綺麗になる
+            // Samplerは最初のサンプルでシードを設定し、以降は保存した状態から再開する
             if (k == 1) {
               layer.clearPixel(i, j, config.width, config.height);
               scene.camera->film->clearPixel(i, j);
+              context.sampler->setSeed(index);
+            } else {
+              context.sampler->setState(sampler_states[index]);
             }
 
-            // 最低でも1回は描画してからキャンセルする
-            // 見た目が良くなる
-            if (k > 1 && cancel) {
-              return;
-            }
+            renderPixel(i, j, context);
 
-            // 画素ごとに用意したSamplerの取得
-            const std::unique_ptr<Sampler>& pixel_sampler =
-                samplers[i + config.width * j];
+            // このパスの画素のサンプリングが終わったのでsRGBに変換する
+            resolveRenderPixel(i, j);
 
-            renderPixel(i, j, *pixel_sampler);
+            sampler_states[index] = context.sampler->getState();
 
             // サンプル数を加算
             // サンプル数は1で初期化されているので次のIterationから加算する
@@ -240,7 +262,7 @@ void Renderer::render(const std::atomic<bool>& cancel) {
             }
 
             // Progressを加算
-            num_rendered_pixels += 1;
+            context.num_samples.fetch_add(1, std::memory_order_relaxed);
           },
           config.render_tiles_x, config.render_tiles_y, config.width,
           config.height);
@@ -248,52 +270,486 @@ void Renderer::render(const std::atomic<bool>& cancel) {
       if (cancel) {
         break;
       }
+
+      // 一定のパスごとにバックグラウンドでデノイズする
+      // 前のデノイズが終わっていなければ飛ばし、レンダリングは止めない
+      if (config.denoise_interval > 0 && k % config.denoise_interval == 0) {
+        denoiseAsync();
+      }
+
+      // 要求されたデノイズもパスの区切りで開始する
+      submitRequestedDenoise();
     }
     finish_time = std::chrono::system_clock::now();
+
+    // 最後のパスの結果をデノイズする
+    if (config.denoise_interval > 0 && !cancel) {
+      denoiser.wait();
+      denoiseAsync();
+    }
   }
 
   // レンダリングに要した時間をセット
   rendering_time = std::chrono::duration_cast<std::chrono::milliseconds>(
                        finish_time - start_time)
                        .count();
+
+  // NaNが検出されたサンプル数を報告
+  uint64_t num_nan = 0;
+  for (const auto& context : contexts) {
+    num_nan += context->num_nan;
+  }
+  if (num_nan > 0) {
+    std::cerr << "nan detected in " << num_nan << " samples" << std::endl;
+  }
+
+  // レンダリング中に要求されたデノイズを開始する
+  render_lock.unlock();
+  processDenoiseRequest();
+}
+
+void Renderer::renderProgressive(const std::atomic<bool>& cancel) {
+  pool.parallelFor2D(
+      [&](unsigned int i, unsigned int j, unsigned int thread_id) {
+        // スレッドの作業領域を取得し、Samplerのシードを画素ごとに設定し直す
+        RenderContext& context = *contexts[thread_id];
+        context.sampler->setSeed(i + config.width * j);
+
+        //サンプリングを繰り返す
+        for (unsigned int k = 0; k < config.samples; ++k) {
+          if (cancel) {
+            break;
+          }
+
+          renderPixel(i, j, context);
+
+          // Progressを加算
+          context.num_samples.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // 画素のサンプリングが終わったのでsRGBに変換する
+        resolveRenderPixel(i, j);
+      },
+      config.render_tiles_x, config.render_tiles_y, config.width,
+      config.height);
+}
+
+void Renderer::renderWavefront(const std::atomic<bool>& cancel) {
+  pool.parallelForTile2D(
+      [&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1,
+          unsigned int thread_id) {
+        // スレッドの作業領域を取得し、Samplerのシードをタイルごとに設定し直す
+        RenderContext& context = *contexts[thread_id];
+        context.sampler->setSeed(x0 + config.width * y0);
+
+        // 1回に追跡するパスの数がWAVE_SIZEを超えないように、
+        // WAVE_SIZEより多くの画素を持つタイルは画素を分けてから
+        // 画素ごとのサンプルをまとめる
+        const unsigned int tile_width = x1 - x0;
+        const unsigned int num_pixels = tile_width * (y1 - y0);
+        const unsigned int batch_pixels = std::min(num_pixels, WAVE_SIZE);
+        const unsigned int wave_samples =
+            std::min(WAVE_SIZE / batch_pixels, config.samples);
+
+        for (unsigned int p0 = 0; p0 < num_pixels && !cancel;
+             p0 += batch_pixels) {
+          const unsigned int p1 = std::min(p0 + batch_pixels, num_pixels);
+          for (unsigned int s = 0; s < config.samples; s += wave_samples) {
+            if (cancel) {
+              break;
+            }
+
+            // 画素サンプルを並べる
+            const unsigned int s_end =
+                std::min(s + wave_samples, config.samples);
+            context.wave_samples.clear();
+            for (unsigned int k = s; k < s_end; ++k) {
+              for (unsigned int p = p0; p < p1; ++p) {
+                context.wave_samples.push_back(
+                    {x0 + p % tile_width, y0 + p / tile_width});
+              }
+            }
+
+            integrator->integrateWave(context.wave_samples, scene,
+                                      *context.sampler, context.wave_results,
+                                      context.wave_workspace);
+
+            for (std::size_t k = 0; k < context.wave_samples.size(); ++k) {
+              splatSample(context.wave_samples[k].i,
+                          context.wave_samples[k].j, context.wave_results[k],
+                          context);
+            }
+
+            // Progressを加算
+            context.num_samples.fetch_add(context.wave_samples.size(),
+                                          std::memory_order_relaxed);
+          }
+        }
+
+        // タイルのサンプリングが終わったのでsRGBに変換する
+        for (unsigned int j = y0; j < y1; ++j) {
+          for (unsigned int i = x0; i < x1; ++i) {
+            resolveRenderPixel(i, j);
+          }
+        }
+      },
+      config.render_tiles_x, config.render_tiles_y, config.width,
+      config.height);
+}
+
+void Renderer::renderAdaptive(const std::atomic<bool>& cancel) {
+  const unsigned int num_pixels = config.width * config.height;
+
+  // レイヤー、フィルムを初期化
+  layer.clear();
+  scene.camera->film->clear();
+
+  // パスをまたいでサンプリングを再開するため、Samplerの状態を画素ごとに保存する
+  sampler_states.resize(num_pixels);
+
+  // 画面全体のサンプル数は一様に配分した場合と同じにする
+  const uint64_t budget = static_cast<uint64_t>(config.samples) * num_pixels;
+  uint64_t used = 0;
+
+  // 最初のパスでは全ての画素に同じ数のサンプルを配分する
+  // 残りを誤差に応じて配分できるように、最初のパスは予算の半分までにする
+  const unsigned int pass_size = std::max(
+      1U, std::min(config.adaptive_min_samples, config.samples / 2));
+  std::vector<unsigned int> pass_samples(num_pixels, pass_size);
+  std::vector<Real> pixel_errors(num_pixels);
+  std::vector<Real> errors(num_pixels);
+
+  // 1パスで1つの画素に配分するサンプル数の上限
+  // 1つの画素(Firefly)がパスのサンプルのほとんどを1スレッドで消費しないようにする
+  const unsigned int max_pixel_samples = ADAPTIVE_MAX_PASS_FACTOR * pass_size;
+
+  for (unsigned int pass = 0;; ++pass) {
+    pool.parallelFor2D(
+        [&](unsigned int i, unsigned int j, unsigned int thread_id) {
+          const unsigned int index = i + config.width * j;
+          const unsigned int n = pass_samples[index];
+          if (n == 0) {
+            return;
+          }
+
+          // スレッドの作業領域を取得する
+          // Samplerは最初のパスでシードを設定し、以降は保存した状態から再開する
+          RenderContext& context = *contexts[thread_id];
+          if (pass == 0) {
+            context.sampler->setSeed(index);
+          } else {
+            context.sampler->setState(sampler_states[index]);
+          }
+
+          unsigned int k = 0;
+          for (; k < n && !cancel; ++k) {
+            renderPixel(i, j, context);
+
+            // Progressを加算
+            context.num_samples.fetch_add(1, std::memory_order_relaxed);
+          }
+
+          sampler_states[index] = context.sampler->getState();
+
+          // キャンセルされた場合は配分より少ないので、実際のサンプル数にする
+          pass_samples[index] = k;
+
+          // サンプル数は1で初期化されているので、最初のパスでは上書きする
+          if (pass == 0) {
+            layer.samples[index] = std::max(k, 1U);
+          } else {
+            layer.samples[index] += k;
+          }
+
+          // 画素のサンプリングが終わったのでsRGBに変換する
+          resolveRenderPixel(i, j);
+        },
+        config.render_tiles_x, config.render_tiles_y, config.width,
+        config.height);
+
+    // 実際に計算したサンプル数を加算する
+    for (unsigned int index = 0; index < num_pixels; ++index) {
+      used += pass_samples[index];
+    }
+
+    // 要求されたデノイズはパスの区切りで開始する
+    submitRequestedDenoise();
+
+    if (cancel || used >= budget) {
+      break;
+    }
+
+    // 相対誤差を計算する
+    for (unsigned int j = 0; j < config.height; ++j) {
+      for (unsigned int i = 0; i < config.width; ++i) {
+        pixel_errors[i + config.width * j] = computeRelativeError(i, j);
+      }
+    }
+
+    // 少ないサンプルが全て同じ値(0など)だった画素は分散が0と推定されるので、
+    // 周囲3x3画素の誤差の最大値をその画素の誤差とする
+    // 閾値を下回った画素は収束したとみなしてサンプリングを止める
+    Real error_sum = 0;
+    for (unsigned int j = 0; j < config.height; ++j) {
+      for (unsigned int i = 0; i < config.width; ++i) {
+        Real error = 0;
+        for (unsigned int y = j > 0 ? j - 1 : 0;
+             y <= std::min(j + 1, config.height - 1); ++y) {
+          for (unsigned int x = i > 0 ? i - 1 : 0;
+               x <= std::min(i + 1, config.width - 1); ++x) {
+            error = std::max(error, pixel_errors[x + config.width * y]);
+          }
+        }
+        errors[i + config.width * j] =
+            error < config.adaptive_threshold ? 0 : error;
+        error_sum += errors[i + config.width * j];
+      }
+    }
+    if (error_sum == 0) {
+      break;
+    }
+
+    // 次のパスのサンプルを相対誤差に比例して配分する
+    const uint64_t pass_budget = std::min(
+        budget - used, static_cast<uint64_t>(pass_size) * num_pixels);
+    std::fill(pass_samples.begin(), pass_samples.end(), 0);
+
+    // 配分が上限を超える画素は上限で止め、残りを他の画素に配り直す
+    // 上限で止めた画素の誤差は0にして、以降の配分から外す
+    uint64_t remaining = pass_budget;
+    double remaining_error = error_sum;
+    while (remaining_error > 0) {
+      uint64_t capped = 0;
+      double capped_error = 0;
+      for (unsigned int index = 0; index < num_pixels; ++index) {
+        if (errors[index] > 0 && static_cast<double>(remaining) *
+                                         errors[index] / remaining_error >=
+                                     max_pixel_samples) {
+          pass_samples[index] = max_pixel_samples;
+          capped += max_pixel_samples;
+          capped_error += errors[index];
+          errors[index] = 0;
+        }
+      }
+      if (capped == 0) {
+        break;
+      }
+      remaining -= capped;
+      remaining_error -= capped_error;
+    }
+
+    // 切り捨てた端数は次の画素に繰り越し、合計がpass_budgetを超えないようにする
+    uint64_t pass_total = pass_budget - remaining;
+    double carry = 0;
+    for (unsigned int index = 0; index < num_pixels && remaining_error > 0;
+         ++index) {
+      if (errors[index] == 0) {
+        continue;
+      }
+      carry += static_cast<double>(remaining) * errors[index] / remaining_error;
+      const uint64_t n = std::min<uint64_t>(
+          {static_cast<uint64_t>(carry), max_pixel_samples,
+           pass_budget - pass_total});
+      carry -= static_cast<double>(n);
+      pass_samples[index] = static_cast<unsigned int>(n);
+      pass_total += n;
+    }
+    if (pass_total == 0) {
+      break;
+    }
+  }
+}
+
+Real Renderer::computeRelativeError(unsigned int i, unsigned int j) const {
+  const unsigned int index = i + config.width * j;
+  const Real n = layer.samples[index];
+
+  // 輝度の平均と分散から、平均の標準誤差を求める
+  const Real mean = scene.camera->film->getXYZ(i, j).y() / n;
+  const Real variance =
+      std::max(layer.render_moment[index] / n - mean * mean, Real(0));
+  const Real standard_error = std::sqrt(variance / n);
+
+  // 暗い画素で誤差が発散しないように分母に小さな値を足す
+  return standard_error / (mean + 1e-3f);
 }
 
 void Renderer::denoise() {
-  // https://github.com/OpenImageDenoise/oidn
-  // Create an Intel Open Image Denoise device
-  OIDNDevice device = oidnNewDevice(OIDN_DEVICE_TYPE_DEFAULT);
-  oidnCommitDevice(device);
-
-  // Create a denoising filter
-  OIDNFilter filter =
-      oidnNewFilter(device, "RT");  // generic ray tracing filter
-  oidnSetSharedFilterImage(filter, "color", layer.render_sRGB.data(),
-                           OIDN_FORMAT_FLOAT3, config.width, config.height, 0,
-                           0, 0);
-  oidnSetSharedFilterImage(filter, "albedo", layer.albedo_sRGB.data(),
-                           OIDN_FORMAT_FLOAT3, config.width, config.height, 0,
-                           0,
-                           0);  // optional
-  oidnSetSharedFilterImage(filter, "normal", layer.normal_sRGB.data(),
-                           OIDN_FORMAT_FLOAT3, config.width, config.height, 0,
-                           0, 0);  // optional
-  oidnSetSharedFilterImage(filter, "output", layer.denoised_sRGB.data(),
-                           OIDN_FORMAT_FLOAT3, config.width, config.height, 0,
-                           0, 0);
-  oidnSetFilter1b(filter, "hdr", true);  // image is HDR
-  oidnCommitFilter(filter);
-
-  // Filter the image
-  oidnExecuteFilter(filter);
-
-  // Check for errors
-  const char* errorMessage;
-  if (oidnGetDeviceError(device, &errorMessage) != OIDN_ERROR_NONE)
-    printf("Error: %s\n", errorMessage);
-
-  // Cleanup
-  oidnReleaseFilter(filter);
-  oidnReleaseDevice(device);
+  // 実行中のデノイズがあれば終わるまで待ってから開始する
+  denoiser.wait();
+
+  if (config.denoise_tile_size > 0) {
+    std::vector<Real> denoised(3 * config.width * config.height, 0);
+    denoiseTiled([&](unsigned int x0, unsigned int y0, unsigned int x1,
+                     unsigned int y1, const Real* rgb) noexcept {
+      for (unsigned int j = y0; j < y1; ++j) {
+        for (unsigned int i = x0; i < x1; ++i) {
+          const unsigned int src = 3 * ((i - x0) + (x1 - x0) * (j - y0));
+          const unsigned int dst = 3 * (i + config.width * j);
+          denoised[dst + 0] += rgb[src + 0];
+          denoised[dst + 1] += rgb[src + 1];
+          denoised[dst + 2] += rgb[src + 2];
+        }
+      }
+    });
+    denoiser.setResult(config.width, config.height, std::move(denoised));
+    return;
+  }
+
+  denoiseAsync();
+  denoiser.wait();
+}
+
+bool Renderer::denoiseAsync() {
+  return denoiser.denoiseAsync(
+      config.width, config.height,
+      [&](Real* color, Real* albedo, Real* normal) {
+        writeDenoiseInput(0, 0, config.width, config.height, color, albedo,
+                          normal);
+      });
+}
+
+void Renderer::requestDenoise() {
+  denoise_requested = true;
+  processDenoiseRequest();
+}
+
+void Renderer::submitRequestedDenoise() {
+  if (denoise_requested.exchange(false)) {
+    denoiseAsync();
+  }
+}
+
+void Renderer::processDenoiseRequest() {
+  // レンダリング中ならレンダリングスレッドが要求を引き継ぐ
+  // renderはロックを手放した後にもう一度要求を確認するので、要求は失われない
+  std::unique_lock<std::mutex> lock(render_mutex, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return;
+  }
+  submitRequestedDenoise();
+}
+
+bool Renderer::denoiseToFile(const std::string& filename) {
+  denoiser.wait();
+
+  PFMTileWriter file;
+  if (!file.open(filename, config.width, config.height)) {
+    std::cerr << "failed to open " << filename << std::endl;
+    return false;
+  }
+  const bool ok = denoiseTiled([&](unsigned int x0, unsigned int y0,
+                                   unsigned int x1, unsigned int y1,
+                                   const Real* rgb) {
+    file.add(x0, y0, x1, y1, rgb);
+  });
+  if (!ok || !file.good()) {
+    std::cerr << "failed to write " << filename << std::endl;
+    return false;
+  }
+  file.close();
+
+  std::cout << filename << " has been written out" << std::endl;
+  return true;
+}
+
+bool Renderer::denoiseTiled(const TiledDenoiser::TileWriter& writer) {
+  // タイルの大きさが0の場合は画像全体を1つのタイルとする
+  const unsigned int tile_size =
+      config.denoise_tile_size > 0
+          ? config.denoise_tile_size
+          : std::max(config.width, config.height);
+  const TiledDenoiser tiled_denoiser(tile_size, config.denoise_tile_overlap,
+                                     config.denoise_max_memory_mb);
+  return tiled_denoiser.denoise(
+      config.width, config.height,
+      [&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1,
+          Real* color, Real* albedo, Real* normal) {
+        writeDenoiseInput(x0, y0, x1, y1, color, albedo, normal);
+      },
+      writer);
+}
+
+void Renderer::writeDenoiseInput(unsigned int x0, unsigned int y0,
+                                 unsigned int x1, unsigned int y1, Real* color,
+                                 Real* albedo, Real* normal) const {
+  for (unsigned int j = y0; j < y1; ++j) {
+    for (unsigned int i = x0; i < x1; ++i) {
+      const unsigned int src = 3 * (i + config.width * j);
+      const unsigned int dst = 3 * ((i - x0) + (x1 - x0) * (j - y0));
+
+      // まだサンプリングされていない画素は0にする
+      const unsigned int samples = layer.samples[i + config.width * j];
+      if (samples == 0) {
+        for (unsigned int c = 0; c < 3; ++c) {
+          color[dst + c] = 0;
+          albedo[dst + c] = 0;
+          normal[dst + c] = 0;
+        }
+        continue;
+      }
+
+      const Real inv_samples = 1.0f / samples;
+      for (unsigned int c = 0; c < 3; ++c) {
+        color[dst + c] = layer.render_sRGB[src + c] * inv_samples;
+        albedo[dst + c] = layer.albedo_sRGB[src + c] * inv_samples;
+        normal[dst + c] =
+            2.0f * layer.normal_sRGB[src + c] * inv_samples - 1.0f;
+      }
+    }
+  }
+}
+
+unsigned int Renderer::getDenoiseInterval() const {
+  return config.denoise_interval;
+}
+
+void Renderer::setDenoiseInterval(unsigned int interval) {
+  config.denoise_interval = interval;
+}
+
+bool Renderer::getAOVEnabled(const LayerType& layer_type) const {
+  switch (layer_type) {
+    case LayerType::Albedo:
+      return config.aov_albedo;
+    case LayerType::Normal:
+      return config.aov_normal;
+    case LayerType::UV:
+      return config.aov_uv;
+    case LayerType::Position:
+      return config.aov_position;
+    case LayerType::Depth:
+      return config.aov_depth;
+    case LayerType::Sample:
+      return config.aov_sample;
+    default:
+      return true;
+  }
+}
+
+void Renderer::setAOVEnabled(const LayerType& layer_type, bool enabled) {
+  switch (layer_type) {
+    case LayerType::Albedo:
+      config.aov_albedo = enabled;
+      break;
+    case LayerType::Normal:
+      config.aov_normal = enabled;
+      break;
+    case LayerType::UV:
+      config.aov_uv = enabled;
+      break;
+    case LayerType::Position:
+      config.aov_position = enabled;
+      break;
+    case LayerType::Depth:
+      config.aov_depth = enabled;
+      break;
+    case LayerType::Sample:
+      config.aov_sample = enabled;
+      break;
+    default:
+      break;
+  }
 }
 
 IntegratorType Renderer::getIntegratorType() const {
@@ -306,6 +762,8 @@ void Renderer::setIntegratorType(const IntegratorType& type) {
     integrator = std::make_shared<PT>();
   } else if (type == IntegratorType::NEE) {
     integrator = std::make_shared<NEE>();
+  } else if (type == IntegratorType::Wavefront) {
+    integrator = std::make_shared<WavefrontPT>();
   }
 }
 
@@ -409,6 +867,11 @@ void Renderer::setThinLensCameraFocusDistance(float distance) {
 }
 
 Real Renderer::getRenderProgress() const {
+  uint64_t num_rendered_pixels = 0;
+  for (const auto& context : contexts) {
+    num_rendered_pixels +=
+        context->num_samples.load(std::memory_order_relaxed);
+  }
   return static_cast<Real>(num_rendered_pixels) /
          (static_cast<Real>(config.width) * config.height * config.samples);
 }
@@ -416,8 +879,9 @@ Real Renderer::getRenderProgress() const {
 unsigned int Renderer::getRenderingTime() const { return rendering_time; }
 
 void Renderer::commitCamera() {
-  const auto film = std::make_shared<Film>(
-      config.width, config.height, config.width_length, config.height_length);
+  const auto film =
+      std::make_shared<Film>(config.width, config.height, config.width_length,
+                             config.height_length, config.film_type);
   const auto transform = std::make_shared<Transform>(
       lookAt(config.camera_position, config.camera_lookat));
 
@@ -594,168 +1058,175 @@ void Renderer::getLayersRGB(std::vector<float>& rgb) const {
 }
 
 void Renderer::saveLayer(const std::string& filename) const {
-  std::vector<float> image;
-  getLayersRGB(image);
-
-  if (config.image_type == ImageType::PPM) {
-    writePPM(filename, config.width, config.height, image);
-  } else if (config.image_type == ImageType::PNG) {
-    writePNG(filename, config.width, config.height, image);
-  } else if (config.image_type == ImageType::EXR) {
-    writeEXR(filename, config.width, config.height, image);
-  } else if (config.image_type == ImageType::HDR) {
-    writeHDR(filename, config.width, config.height, image);
-  } else if (config.image_type == ImageType::PFM) {
-    writePFM(filename, config.width, config.height, image);
-  } else {
-    std::cerr << "nvalid image type" << std::endl;
+  // 読み出した画像は書き出しが終わるまで書き出し側で持つ
+  const auto image = std::make_shared<std::vector<float>>();
+  getLayersRGB(*image);
+
+  const ImageType image_type = config.image_type;
+  const unsigned int width = config.width;
+  const unsigned int height = config.height;
+  image_writer.enqueue([filename, image, image_type, width, height]() {
+    const ImageView view(*image, width, height);
+    if (image_type == ImageType::PPM) {
+      writePPM(filename, view);
+    } else if (image_type == ImageType::PNG) {
+      writePNG(filename, view);
+    } else if (image_type == ImageType::EXR) {
+      writeEXR(filename, view);
+    } else if (image_type == ImageType::HDR) {
+      writeHDR(filename, view);
+    } else if (image_type == ImageType::PFM) {
+      writePFM(filename, view);
+    } else {
+      std::cerr << "nvalid image type" << std::endl;
+    }
+  });
+}
+
+void Renderer::saveAllLayers(const std::string& filename) const {
+  // 書き出すレイヤー
+  struct Layer {
+    std::string name;                   // レイヤー名
+    std::vector<std::string> channels;  // チャンネル名
+    bool half;                          // HALFで保存するか
+    std::vector<float> rgb;             // サンプル数で割った値
+  };
+  const auto layers = std::make_shared<std::vector<Layer>>();
+
+  // サンプル数で割るだけで、Tone Mappingやガンマ補正は行わない
+  const auto addLayer = [&](const std::string& name,
+                            const std::vector<std::string>& channels,
+                            bool half, const Real* src, bool divide) {
+    layers->push_back({name, channels, half, {}});
+    postProcessLayer(src, divide, PostProcessSettings(), layers->back().rgb);
+  };
+
+  addLayer("", {"R", "G", "B"}, true, layer.render_sRGB.data(), true);
+
+  // デノイズの結果がある場合だけ書き出す
+  denoiser.readResult(config.width, config.height, [&](const Real* rgb) {
+    addLayer("denoise", {"R", "G", "B"}, true, rgb, false);
+  });
+  if (config.aov_albedo) {
+    addLayer("albedo", {"R", "G", "B"}, true, layer.albedo_sRGB.data(), true);
+  }
+  if (config.aov_normal) {
+    addLayer("N", {"X", "Y", "Z"}, true, layer.normal_sRGB.data(), true);
+    // [0, 1]に写したものを[-1, 1]に戻す
+    for (auto& v : layers->back().rgb) {
+      v = 2.0f * v - 1.0f;
+    }
+  }
+  if (config.aov_uv) {
+    addLayer("uv", {"U", "V"}, false, layer.uv_sRGB.data(), true);
+  }
+  if (config.aov_position) {
+    addLayer("P", {"X", "Y", "Z"}, false, layer.position_sRGB.data(), true);
   }
+  if (config.aov_depth) {
+    // 3つとも同じ値なので1チャンネルだけ書き出す
+    addLayer("", {"Z"}, false, layer.depth_sRGB.data(), true);
+  }
+  if (config.aov_sample) {
+    addLayer("sample", {"R", "G", "B"}, true, layer.sample_sRGB.data(), true);
+  }
+
+  EXROptions options;
+  options.compression = config.exr_compression;
+  options.tile_size = config.exr_tile_size;
+  const unsigned int width = config.width;
+  const unsigned int height = config.height;
+  image_writer.enqueue([filename, layers, options, width, height]() {
+    std::vector<EXRLayer> exr_layers;
+    for (const auto& l : *layers) {
+      exr_layers.push_back(
+          {l.name, l.channels, ImageView(l.rgb, width, height), l.half});
+    }
+    writeMultiLayerEXR(filename, exr_layers, options);
+  });
 }
 
-void Renderer::getRendersRGB(std::vector<float>& rgb) const {
-  rgb.resize(3 * config.width * config.height);
+void Renderer::waitSaveLayer() const { image_writer.wait(); }
 
-  for (unsigned int j = 0; j < config.height; ++j) {
-    for (unsigned int i = 0; i < config.width; ++i) {
-      RGB rgb_vec = RGB(layer.render_sRGB[3 * i + 3 * config.width * j],
-                        layer.render_sRGB[3 * i + 3 * config.width * j + 1],
-                        layer.render_sRGB[3 * i + 3 * config.width * j + 2]) /
-                    layer.samples[i + config.width * j];
-
-      // Tone Mapping
-      // RGB to luminance
-      // https://imdoingitwrong.wordpress.com/tag/tone-mapping/
-      const float luminance =
-          0.2126 * rgb_vec[0] + 0.7152 * rgb_vec[1] + 0.0722 * rgb_vec[2];
-      if (config.tone_mapping_type == ToneMappingType::Reinhard) {
-        rgb_vec *= reinhardToneMapping(luminance, config.exposure) / luminance;
-      }
+EXRCompression Renderer::getEXRCompression() const {
+  return config.exr_compression;
+}
 
-      // ガンマ補正
-      rgb_vec[0] = std::pow(rgb_vec[0], 1 / config.gamma);
-      rgb_vec[1] = std::pow(rgb_vec[1], 1 / config.gamma);
-      rgb_vec[2] = std::pow(rgb_vec[2], 1 / config.gamma);
+void Renderer::setEXRCompression(const EXRCompression& compression) {
+  config.exr_compression = compression;
+}
 
-      rgb[3 * i + 3 * config.width * j + 0] = rgb_vec.x();
-      rgb[3 * i + 3 * config.width * j + 1] = rgb_vec.y();
-      rgb[3 * i + 3 * config.width * j + 2] = rgb_vec.z();
-    }
-  }
+unsigned int Renderer::getEXRTileSize() const { return config.exr_tile_size; }
+
+void Renderer::setEXRTileSize(unsigned int tile_size) {
+  config.exr_tile_size = tile_size;
 }
 
-void Renderer::getDenoisesRGB(std::vector<float>& rgb) const {
+void Renderer::postProcessLayer(const Real* src, bool divide,
+                                const PostProcessSettings& settings,
+                                std::vector<float>& rgb) const {
   rgb.resize(3 * config.width * config.height);
 
-  for (unsigned int j = 0; j < config.height; ++j) {
-    for (unsigned int i = 0; i < config.width; ++i) {
-      RGB rgb_vec = RGB(layer.denoised_sRGB[3 * i + 3 * config.width * j],
-                        layer.denoised_sRGB[3 * i + 3 * config.width * j + 1],
-                        layer.denoised_sRGB[3 * i + 3 * config.width * j + 2]) /
-                    layer.samples[i + config.width * j];
-
-      // Tone Mapping
-      // RGB to luminance
-      // https://imdoingitwrong.wordpress.com/tag/tone-mapping/
-      const float luminance =
-          0.2126 * rgb_vec[0] + 0.7152 * rgb_vec[1] + 0.0722 * rgb_vec[2];
-      if (config.tone_mapping_type == ToneMappingType::Reinhard) {
-        rgb_vec *= reinhardToneMapping(luminance, config.exposure) / luminance;
-      }
+  // 1行ずつまとめて変換する
+  readout_pool.parallelFor1D(
+      [&](unsigned int j) {
+        const unsigned int offset = config.width * j;
+        postProcess(src + 3 * offset,
+                    divide ? layer.samples.data() + offset : nullptr,
+                    config.width, settings, rgb.data() + 3 * offset);
+      },
+      readout_pool.getNumThreads(), config.height);
+}
 
-      // ガンマ補正
-      rgb_vec[0] = std::pow(rgb_vec[0], 1 / config.gamma);
-      rgb_vec[1] = std::pow(rgb_vec[1], 1 / config.gamma);
-      rgb_vec[2] = std::pow(rgb_vec[2], 1 / config.gamma);
+PostProcessSettings Renderer::getPostProcessSettings() const {
+  PostProcessSettings settings;
+  settings.tone_mapping =
+      config.tone_mapping_type == ToneMappingType::Reinhard;
+  settings.exposure = config.exposure;
+  settings.gamma = config.gamma;
+  return settings;
+}
 
-      rgb[3 * i + 3 * config.width * j + 0] = rgb_vec.x();
-      rgb[3 * i + 3 * config.width * j + 1] = rgb_vec.y();
-      rgb[3 * i + 3 * config.width * j + 2] = rgb_vec.z();
-    }
+void Renderer::getRendersRGB(std::vector<float>& rgb) const {
+  postProcessLayer(layer.render_sRGB.data(), true, getPostProcessSettings(),
+                   rgb);
+}
+
+void Renderer::getDenoisesRGB(std::vector<float>& rgb) const {
+  // デノイズの入力はサンプル数で割ってあるので、結果は割らずに使う
+  // まだ結果がない場合は黒を返す
+  const bool found =
+      denoiser.readResult(config.width, config.height, [&](const Real* src) {
+        postProcessLayer(src, false, getPostProcessSettings(), rgb);
+      });
+  if (!found) {
+    rgb.assign(3 * config.width * config.height, 0);
   }
 }
 
 void Renderer::getAlbedosRGB(std::vector<float>& rgb) const {
-  rgb.resize(3 * config.width * config.height);
-
-  for (unsigned int j = 0; j < config.height; ++j) {
-    for (unsigned int i = 0; i < config.width; ++i) {
-      const unsigned int index = 3 * i + 3 * config.width * j;
-      const unsigned int current_samples = layer.samples[i + config.width * j];
-      rgb[index + 0] = layer.albedo_sRGB[index + 0] / current_samples;
-      rgb[index + 1] = layer.albedo_sRGB[index + 1] / current_samples;
-      rgb[index + 2] = layer.albedo_sRGB[index + 2] / current_samples;
-    }
-  }
+  postProcessLayer(layer.albedo_sRGB.data(), true, PostProcessSettings(), rgb);
 }
 
 void Renderer::getNormalsRGB(std::vector<float>& rgb) const {
-  rgb.resize(3 * config.width * config.height);
-
-  for (unsigned int j = 0; j < config.height; ++j) {
-    for (unsigned int i = 0; i < config.width; ++i) {
-      const unsigned int index = 3 * i + 3 * config.width * j;
-      const unsigned int current_samples = layer.samples[i + config.width * j];
-      rgb[index + 0] = layer.normal_sRGB[index + 0] / current_samples;
-      rgb[index + 1] = layer.normal_sRGB[index + 1] / current_samples;
-      rgb[index + 2] = layer.normal_sRGB[index + 2] / current_samples;
-    }
-  }
+  postProcessLayer(layer.normal_sRGB.data(), true, PostProcessSettings(), rgb);
 }
 
 void Renderer::getUVsRGB(std::vector<float>& rgb) const {
-  rgb.resize(3 * config.width * config.height);
-
-  for (unsigned int j = 0; j < config.height; ++j) {
-    for (unsigned int i = 0; i < config.width; ++i) {
-      const unsigned int index = 3 * i + 3 * config.width * j;
-      const unsigned int current_samples = layer.samples[i + config.width * j];
-      rgb[index + 0] = layer.uv_sRGB[index + 0] / current_samples;
-      rgb[index + 1] = layer.uv_sRGB[index + 1] / current_samples;
-      rgb[index + 2] = layer.uv_sRGB[index + 2] / current_samples;
-    }
-  }
+  postProcessLayer(layer.uv_sRGB.data(), true, PostProcessSettings(), rgb);
 }
 
 void Renderer::getPositionsRGB(std::vector<float>& rgb) const {
-  rgb.resize(3 * config.width * config.height);
-
-  for (unsigned int j = 0; j < config.height; ++j) {
-    for (unsigned int i = 0; i < config.width; ++i) {
-      const unsigned int index = 3 * i + 3 * config.width * j;
-      const unsigned int current_samples = layer.samples[i + config.width * j];
-      rgb[index + 0] = layer.position_sRGB[index + 0] / current_samples;
-      rgb[index + 1] = layer.position_sRGB[index + 1] / current_samples;
-      rgb[index + 2] = layer.position_sRGB[index + 2] / current_samples;
-    }
-  }
+  postProcessLayer(layer.position_sRGB.data(), true, PostProcessSettings(),
+                   rgb);
 }
 
 void Renderer::getDepthsRGB(std::vector<float>& rgb) const {
-  rgb.resize(3 * config.width * config.height);
-
-  for (unsigned int j = 0; j < config.height; ++j) {
-    for (unsigned int i = 0; i < config.width; ++i) {
-      const unsigned int index = 3 * i + 3 * config.width * j;
-      const unsigned int current_samples = layer.samples[i + config.width * j];
-      rgb[index + 0] = layer.depth_sRGB[index + 0] / current_samples;
-      rgb[index + 1] = layer.depth_sRGB[index + 1] / current_samples;
-      rgb[index + 2] = layer.depth_sRGB[index + 2] / current_samples;
-    }
-  }
+  postProcessLayer(layer.depth_sRGB.data(), true, PostProcessSettings(), rgb);
 }
 
 void Renderer::getSamplesRGB(std::vector<float>& rgb) const {
-  rgb.resize(3 * config.width * config.height);
-
-  for (unsigned int j = 0; j < config.height; ++j) {
-    for (unsigned int i = 0; i < config.width; ++i) {
-      const unsigned int index = 3 * i + 3 * config.width * j;
-      const unsigned int current_samples = layer.samples[i + config.width * j];
-      rgb[index + 0] = layer.sample_sRGB[index + 0] / current_samples;
-      rgb[index + 1] = layer.sample_sRGB[index + 1] / current_samples;
-      rgb[index + 2] = layer.sample_sRGB[index + 2] / current_samples;
-    }
-  }
+  postProcessLayer(layer.sample_sRGB.data(), true, PostProcessSettings(), rgb);
 }
 
 void Renderer::getCameraMatrix(Mat4& mat) const {
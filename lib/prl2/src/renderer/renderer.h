@@ -3,13 +3,19 @@
 
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include "core/primitive.h"
 #include "integrator/integrator.h"
+#include "io/image-writer.h"
 #include "io/io.h"
 #include "parallel/parallel.h"
+#include "postprocess/denoiser.h"
+#include "postprocess/postprocess.h"
+#include "postprocess/tiled_denoiser.h"
 #include "renderer/render-config.h"
+#include "renderer/render-context.h"
 #include "renderer/render-layer.h"
 #include "renderer/scene.h"
 
@@ -35,8 +41,32 @@ class Renderer {
   void render(const std::atomic<bool>& cancel);
 
   // デノイズする
+  // 終わるまで待ち、結果をDenoise Layerに書き込む
+  // config.denoise_tile_sizeが0でなければタイルに分割してデノイズする
   void denoise();
 
+  // タイルに分割してデノイズし、結果をPFM画像としてfilenameに書き出す
+  // 結果はタイルごとにファイルに足し込むので、画像全体をメモリに置かない
+  // 結果はサンプル数で割った値で、Tone Mappingやガンマ補正は行わない
+  bool denoiseToFile(const std::string& filename);
+
+  // その時点のRender Layerのスナップショットをバックグラウンドでデノイズする
+  // 結果はDenoise Layerを読み出した時に反映される
+  // 前のデノイズが終わっていない場合は何もせずにfalseを返す
+  // レンダリング中に他のスレッドから呼ぶ場合はrequestDenoiseを使う
+  bool denoiseAsync();
+
+  // denoiseAsyncを要求する(GUIなどレンダリングスレッド以外から呼ぶ)
+  // レンダリング中でなければすぐに開始する
+  // レンダリング中はレイヤーに書き込んでいる最中に入力をコピーしないように、
+  // 次のパスの区切りかレンダリングの終わりにレンダリングスレッドで開始する
+  void requestDenoise();
+
+  // Interactiveでデノイズするパスの間隔を入手する
+  unsigned int getDenoiseInterval() const;
+  // Interactiveでデノイズするパスの間隔を設定する(0ならデノイズしない)
+  void setDenoiseInterval(unsigned int interval);
+
   // 指定した画素のサンプルパスを生成する
   void generatePath(unsigned int i, unsigned int j,
                     std::vector<Ray>& path) const;
@@ -78,6 +108,13 @@ class Renderer {
   // 出力レイヤーを指定する
   void setOutputLayer(const LayerType& _layer_type);
 
+  // AOVレイヤーを計算するかを入手する
+  // Render, Denoiseは常に有効
+  bool getAOVEnabled(const LayerType& layer_type) const;
+  // AOVレイヤーを計算するかを設定する
+  // 無効にしたレイヤーはレンダリング中に計算されない
+  void setAOVEnabled(const LayerType& layer_type, bool enabled);
+
   // 出力画像形式を入手する
   ImageType getImageType() const;
   // 出力画像形式を指定する
@@ -148,7 +185,7 @@ class Renderer {
   // ピントの合う位置までの距離をセット
   void setThinLensCameraFocusDistance(float distance);
 
-  // FilmにあるSPDを入手する
+  // FilmにあるSPDを入手する(XYZ Filmの場合は黒を返す)
   SPD getSPD(unsigned int i, unsigned int j) const;
 
   // ConfigからCameraを初期化する
@@ -185,20 +222,115 @@ class Renderer {
   // LayerをsRGBとして入手
   void getLayersRGB(std::vector<float>& rgb) const;
 
-  // Layerを画像として保存
+  // Layerを画像として保存する
+  // 画像を読み出したら書き出しは専用のスレッドに任せ、すぐに戻る
   void saveLayer(const std::string& filename) const;
 
+  // 全てのレイヤーを1つのEXR画像にまとめて保存する
+  // Render, Denoise, 有効なAOVをそれぞれ別のチャンネルとして書き出す
+  // 値はサンプル数で割ったもので、Tone Mappingやガンマ補正は行わない
+  // saveLayerと同様に書き出しは専用のスレッドで行う
+  void saveAllLayers(const std::string& filename) const;
+
+  // saveLayer, saveAllLayersで始めた書き出しが全て終わるまで待つ
+  void waitSaveLayer() const;
+
+  // Multi-Layer EXRの圧縮方式を入手する
+  EXRCompression getEXRCompression() const;
+  // Multi-Layer EXRの圧縮方式を設定する
+  void setEXRCompression(const EXRCompression& compression);
+
+  // Multi-Layer EXRのタイルの一辺の長さを入手する
+  unsigned int getEXRTileSize() const;
+  // Multi-Layer EXRのタイルの一辺の長さを設定する(0ならスキャンライン)
+  void setEXRTileSize(unsigned int tile_size);
+
  private:
   RenderLayer layer;                       // RenderLayer
   std::shared_ptr<Sampler> sampler;        // Sampler
   std::shared_ptr<Integrator> integrator;  // Integrator
   Parallel pool;                           // Rendering Thhread Pool
+  Denoiser denoiser;                       // Denoiser
+  mutable ImageWriter image_writer;        // 画像の書き出しを行うスレッド
+
+  // 読み出し用のThread Pool
+  mutable Parallel readout_pool{MAX_READOUT_THREADS};
+
+  std::vector<std::unique_ptr<RenderContext>>
+      contexts;  // レンダリングスレッドごとの作業領域
+  std::vector<SamplerState>
+      sampler_states;  // 画素ごとのSamplerの状態(Interactive用)
 
-  std::atomic<uint64_t> num_rendered_pixels;  // レンダリング済みのピクセル数
   unsigned int rendering_time;  // レンダリングにかかった時間[ms]
 
+  std::mutex render_mutex;  // renderの実行中に保持する
+  std::atomic<bool> denoise_requested{false};  // デノイズが要求されているか
+
+  // 要求されたデノイズがあれば開始する
+  // レイヤーに書き込んでいないレンダリングスレッドから呼ぶ
+  void submitRequestedDenoise();
+
+  // レンダリング中でなければ、要求されたデノイズを開始する
+  void processDenoiseRequest();
+
+  // レンダリングスレッドごとの作業領域を初期化する
+  void initRenderContexts();
+
+  // 読み出し用のThread Poolのスレッド数の上限
+  // レンダリング中の読み出しがレンダリングのスレッドとコアを取り合わないように少なくする
+  static constexpr unsigned int MAX_READOUT_THREADS = 2;
+
+  // Wavefrontで1回に追跡するパスの最大数
+  static constexpr unsigned int WAVE_SIZE = 1 << 14;
+
+  // Adaptive Samplingで1パスに1つの画素へ配分するサンプル数の上限
+  // (adaptive_min_samplesに対する倍率)
+  static constexpr unsigned int ADAPTIVE_MAX_PASS_FACTOR = 4;
+
+  // 画素ごとにサンプリングを繰り返してレンダリングを行う
+  void renderProgressive(const std::atomic<bool>& cancel);
+
+  // タイル内の画素サンプルをまとめてIntegratorに渡してレンダリングを行う
+  void renderWavefront(const std::atomic<bool>& cancel);
+
   // (i, j)のレンダリングを行う
-  void renderPixel(unsigned int i, unsigned int j, Sampler& pixel_sampler);
+  void renderPixel(unsigned int i, unsigned int j, RenderContext& context);
+
+  // Integratorの結果を(i, j)のフィルム、Layerに加算する
+  void splatSample(unsigned int i, unsigned int j,
+                   const IntegratorResult& result, RenderContext& context);
+
+  // 画素ごとの相対誤差に応じてサンプルを配分しながらレンダリングを行う
+  // 収束した画素のサンプリングを止め、余ったサンプルを誤差の大きい画素に回す
+  void renderAdaptive(const std::atomic<bool>& cancel);
+
+  // (i, j)の輝度の相対誤差(平均の標準誤差 / 平均)を計算する
+  Real computeRelativeError(unsigned int i, unsigned int j) const;
+
+  // (i, j)のSPDをsRGBに変換し、Render Layerに書き込む
+  // Filmに加算したレンダリングスレッドが画素のサンプリングを終えた時に呼ぶ
+  // 読み出し側はFilmに触らず、変換済みのRender Layerだけを読む
+  void resolveRenderPixel(unsigned int i, unsigned int j);
+
+  // 範囲[x0, x1) x [y0, y1)のデノイザーの入力を書き込む
+  // 各レイヤーはサンプルの和なので、画素ごとにサンプル数で割った値にする
+  // 法線は[0, 1]に写したものを[-1, 1]に戻す
+  void writeDenoiseInput(unsigned int x0, unsigned int y0, unsigned int x1,
+                         unsigned int y1, Real* color, Real* albedo,
+                         Real* normal) const;
+
+  // タイルに分割してデノイズし、結果をwriterに渡す
+  bool denoiseTiled(const TiledDenoiser::TileWriter& writer);
+
+  // レイヤーの値srcを行ごとに並列にpostProcessしてrgbに書き込む
+  // divideがtrueなら画素ごとにサンプル数で割る
+  // レンダリング中でも待たされないように、readout_poolで実行する
+  void postProcessLayer(const Real* src, bool divide,
+                        const PostProcessSettings& settings,
+                        std::vector<float>& rgb) const;
+
+  // Render Post Processingの設定を入手する
+  PostProcessSettings getPostProcessSettings() const;
 
   // Render LayerをsRGBとして入手
   void getRendersRGB(std::vector<float>& rgb) const;
@@ -0,0 +1,221 @@
+#include "renderer/scene-cache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <vector>
+
+#include "io/mapped-file.h"
+
+namespace Prl2 {
+
+namespace {
+
+constexpr char SCENE_CACHE_MAGIC[8] = {'P', 'R', 'L', '2', 'S', 'C', 'N', 0};
+
+// 配列を置く境界
+constexpr uint64_t SCENE_CACHE_ALIGNMENT = 64;
+
+// ファイルの先頭に置くヘッダ
+struct SceneCacheHeader {
+  char magic[8];             // SCENE_CACHE_MAGIC
+  uint32_t version;          // SCENE_CACHE_VERSION
+  uint32_t real_size;        // sizeof(Real)
+  uint32_t vec3_size;        // sizeof(Vec3)
+  uint32_t vec2_size;        // sizeof(Vec2)
+  uint32_t spd_samples;      // SPD::LAMBDA_SAMPLES
+  uint32_t num_vertices;     // 頂点数
+  uint32_t num_faces;        // 面の数
+  uint32_t has_normals;      // 頂点法線を持つか
+  uint32_t has_uvs;          // 頂点UVを持つか
+  uint32_t reserved;
+  uint64_t source_size;      // 元ファイルのサイズ
+  int64_t source_mtime;      // 元ファイルの更新時刻
+  uint64_t vertices_offset;  // 頂点座標の位置
+  uint64_t indices_offset;   // 頂点インデックスの位置
+  uint64_t normals_offset;   // 頂点法線の位置
+  uint64_t uvs_offset;       // 頂点UVの位置
+  uint64_t spd_offset;       // 分光反射率の位置
+  uint64_t file_size;        // キャッシュ全体のサイズ
+};
+
+uint64_t align(uint64_t offset) {
+  return (offset + SCENE_CACHE_ALIGNMENT - 1) / SCENE_CACHE_ALIGNMENT *
+         SCENE_CACHE_ALIGNMENT;
+}
+
+// 元ファイルのサイズと更新時刻を取得する
+bool getSourceStamp(const std::string& source, uint64_t& size,
+                    int64_t& mtime) {
+  std::error_code ec;
+  size = std::filesystem::file_size(source, ec);
+  if (ec) {
+    return false;
+  }
+  mtime = std::filesystem::last_write_time(source, ec)
+              .time_since_epoch()
+              .count();
+  return !ec;
+}
+
+// 配列がファイルの範囲に収まっているか
+bool inRange(uint64_t offset, uint64_t bytes, uint64_t file_size) {
+  return offset <= file_size && bytes <= file_size - offset;
+}
+
+}  // namespace
+
+bool writeSceneCache(const std::string& filename, const std::string& source,
+                     const SceneCacheData& data) {
+  const TriangleMesh& mesh = *data.mesh;
+
+  SceneCacheHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, SCENE_CACHE_MAGIC, sizeof(header.magic));
+  header.version = SCENE_CACHE_VERSION;
+  header.real_size = sizeof(Real);
+  header.vec3_size = sizeof(Vec3);
+  header.vec2_size = sizeof(Vec2);
+  header.spd_samples = SPD::LAMBDA_SAMPLES;
+  header.num_vertices = mesh.num_vertices;
+  header.num_faces = mesh.num_faces;
+  header.has_normals = !mesh.normals.empty();
+  header.has_uvs = !mesh.uvs.empty();
+  if (!getSourceStamp(source, header.source_size, header.source_mtime)) {
+    return false;
+  }
+
+  // 配列の位置を決める
+  const uint64_t vertices_bytes = sizeof(Vec3) * mesh.vertices.size();
+  const uint64_t indices_bytes = sizeof(unsigned int) * mesh.indices.size();
+  const uint64_t normals_bytes = sizeof(Vec3) * mesh.normals.size();
+  const uint64_t uvs_bytes = sizeof(Vec2) * mesh.uvs.size();
+  const uint64_t spd_bytes = sizeof(Real) * SPD::LAMBDA_SAMPLES;
+  header.vertices_offset = align(sizeof(header));
+  header.indices_offset = align(header.vertices_offset + vertices_bytes);
+  header.normals_offset = align(header.indices_offset + indices_bytes);
+  header.uvs_offset = align(header.normals_offset + normals_bytes);
+  header.spd_offset = align(header.uvs_offset + uvs_bytes);
+  header.file_size = header.spd_offset + spd_bytes;
+
+  // 一時ファイルに書き込む
+  const std::string tmp_filename = filename + ".tmp";
+  {
+    std::ofstream file(tmp_filename, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return false;
+    }
+
+    const auto writeAt = [&](uint64_t offset, const void* ptr,
+                             uint64_t bytes) {
+      // 境界まで0で埋める
+      static const char zeros[SCENE_CACHE_ALIGNMENT] = {};
+      const uint64_t pos = static_cast<uint64_t>(file.tellp());
+      file.write(zeros, static_cast<std::streamsize>(offset - pos));
+      file.write(static_cast<const char*>(ptr),
+                 static_cast<std::streamsize>(bytes));
+    };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeAt(header.vertices_offset, mesh.vertices.data(), vertices_bytes);
+    writeAt(header.indices_offset, mesh.indices.data(), indices_bytes);
+    writeAt(header.normals_offset, mesh.normals.data(), normals_bytes);
+    writeAt(header.uvs_offset, mesh.uvs.data(), uvs_bytes);
+    writeAt(header.spd_offset, data.material_spd.phi.data(), spd_bytes);
+
+    if (!file) {
+      return false;
+    }
+  }
+
+  // 書き終わってから置き換える
+  std::error_code ec;
+  std::filesystem::rename(tmp_filename, filename, ec);
+  return !ec;
+}
+
+bool readSceneCache(const std::string& filename, const std::string& source,
+                    SceneCacheData& data) {
+  // メッシュの配列はマップした領域を直接参照するので、メッシュと共有する
+  const auto file = std::make_shared<MappedFile>();
+  if (!file->open(filename) || file->size() < sizeof(SceneCacheHeader)) {
+    return false;
+  }
+
+  // ヘッダを確認する
+  SceneCacheHeader header;
+  std::memcpy(&header, file->data(), sizeof(header));
+  if (std::memcmp(header.magic, SCENE_CACHE_MAGIC, sizeof(header.magic)) !=
+          0 ||
+      header.version != SCENE_CACHE_VERSION ||
+      header.real_size != sizeof(Real) || header.vec3_size != sizeof(Vec3) ||
+      header.vec2_size != sizeof(Vec2) ||
+      header.spd_samples != SPD::LAMBDA_SAMPLES ||
+      header.file_size != file->size()) {
+    return false;
+  }
+
+  // 元ファイルが変更されていないか確認する
+  uint64_t source_size;
+  int64_t source_mtime;
+  if (!getSourceStamp(source, source_size, source_mtime) ||
+      source_size != header.source_size ||
+      source_mtime != header.source_mtime) {
+    return false;
+  }
+
+  const uint64_t num_vertices = header.num_vertices;
+  const uint64_t num_indices = 3 * static_cast<uint64_t>(header.num_faces);
+  const uint64_t vertices_bytes = sizeof(Vec3) * num_vertices;
+  const uint64_t indices_bytes = sizeof(unsigned int) * num_indices;
+  const uint64_t normals_bytes =
+      header.has_normals ? sizeof(Vec3) * num_vertices : 0;
+  const uint64_t uvs_bytes = header.has_uvs ? sizeof(Vec2) * num_vertices : 0;
+  const uint64_t spd_bytes = sizeof(Real) * SPD::LAMBDA_SAMPLES;
+  if (!inRange(header.vertices_offset, vertices_bytes, file->size()) ||
+      !inRange(header.indices_offset, indices_bytes, file->size()) ||
+      !inRange(header.normals_offset, normals_bytes, file->size()) ||
+      !inRange(header.uvs_offset, uvs_bytes, file->size()) ||
+      !inRange(header.spd_offset, spd_bytes, file->size())) {
+    return false;
+  }
+
+  // 配列はそのままの形で64バイト境界に置いてあるので、解析もコピーもせずに
+  // マップした領域をそのままメッシュの配列として使う
+  const auto view = [&](uint64_t offset) {
+    return file->data() + offset;
+  };
+  const auto mesh = std::make_shared<TriangleMesh>();
+  mesh->num_vertices = header.num_vertices;
+  mesh->num_faces = header.num_faces;
+  mesh->vertices = MeshArray<Vec3>(
+      reinterpret_cast<const Vec3*>(view(header.vertices_offset)),
+      num_vertices, file);
+  mesh->indices = MeshArray<unsigned int>(
+      reinterpret_cast<const unsigned int*>(view(header.indices_offset)),
+      num_indices, file);
+  if (header.has_normals) {
+    mesh->normals = MeshArray<Vec3>(
+        reinterpret_cast<const Vec3*>(view(header.normals_offset)),
+        num_vertices, file);
+  }
+  if (header.has_uvs) {
+    mesh->uvs = MeshArray<Vec2>(
+        reinterpret_cast<const Vec2*>(view(header.uvs_offset)), num_vertices,
+        file);
+  }
+
+  // 頂点インデックスの範囲を確認する
+  for (const unsigned int index : mesh->indices) {
+    if (index >= mesh->num_vertices) {
+      return false;
+    }
+  }
+
+  data.mesh = mesh;
+  std::memcpy(data.material_spd.phi.data(), view(header.spd_offset),
+              spd_bytes);
+  return true;
+}
+
+}  // namespace Prl2
@@ -0,0 +1,38 @@
+#ifndef _PRL2_SCENE_CACHE_H
+#define _PRL2_SCENE_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "core/spectrum.h"
+#include "shape/triangle.h"
+
+namespace Prl2 {
+
+// シーンキャッシュの形式のバージョン
+// 形式を変えた場合は上げる(古いキャッシュは読み込まずに作り直す)
+constexpr uint32_t SCENE_CACHE_VERSION = 1;
+
+// シーンキャッシュに保存する、読み込み済みのシーンの中身
+struct SceneCacheData {
+  std::shared_ptr<TriangleMesh> mesh;  // 三角形メッシュ
+  SPD material_spd;                    // メッシュのDiffuseの分光反射率
+};
+
+// sourceから作ったシーンをバイナリのキャッシュとしてfilenameに書き込む
+// 各配列はそのままメモリに置ける形で64バイト境界に並べる
+// 書き込み途中のファイルが残らないように一時ファイルに書いてから置き換える
+bool writeSceneCache(const std::string& filename, const std::string& source,
+                     const SceneCacheData& data);
+
+// filenameのキャッシュをマップして読み込む
+// メッシュの配列はマップした領域を参照し、メッシュが破棄されるまでマップを保つ
+// バージョンや型の大きさが違う場合、sourceのサイズや更新時刻が
+// キャッシュを作った時と違う場合はfalseを返す
+bool readSceneCache(const std::string& filename, const std::string& source,
+                    SceneCacheData& data);
+
+}  // namespace Prl2
+
+#endif
@@ -1,43 +1,488 @@
 #include "renderer/scene-loader.h"
 
-#include "tiny_obj_loader.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+
+#include "intersector/bvh.h"
+#ifdef PRL2_USE_EMBREE
+#include "intersector/embree.h"
+#endif
+#include "io/mapped-file.h"
+#include "material/diffuse.h"
+#include "renderer/scene-cache.h"
+#include "shape/mesh.h"
+#include "shape/triangle.h"
 
 namespace Prl2 {
 
-bool loadTriangleMeshFromObj(const std::string& filename) {
-  tinyobj::attrib_t attrib;
-  std::vector<tinyobj::shape_t> shapes;
-  std::vector<tinyobj::material_t> materials;
+namespace {
+
+// OBJの面の頂点が参照するv/vt/vnのインデックス
+// 負のインデックス(相対参照)はチャンク内の位置で保持し、後で全体の位置に直す
+struct ObjIndex {
+  static constexpr uint8_t HAS_VT = 1 << 0;  // vtを持つ
+  static constexpr uint8_t HAS_VN = 1 << 1;  // vnを持つ
+  static constexpr uint8_t REL_V = 1 << 2;   // vがチャンク内の位置
+  static constexpr uint8_t REL_VT = 1 << 3;  // vtがチャンク内の位置
+  static constexpr uint8_t REL_VN = 1 << 4;  // vnがチャンク内の位置
+
+  int64_t v;
+  int64_t vt;
+  int64_t vn;
+  uint8_t flags;
+};
+
+// ファイルを分割した1つのチャンクの解析結果
+struct ObjChunk {
+  std::vector<Vec3> vertices;  // v
+  std::vector<Vec3> normals;   // vn
+  std::vector<Vec2> uvs;       // vt
+  std::vector<ObjIndex> face_vertices;  // 三角形分割した面の頂点(3つずつ)
+};
 
-  std::string warn;
-  std::string err;
+// 1チャンクの最小バイト数
+constexpr std::size_t MIN_CHUNK_SIZE = 1 << 20;
 
-  bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err,
-                              filename.c_str());
+bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
 
-  if (!warn.empty()) {
-    std::cout << warn << std::endl;
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+void skipSpaces(const char*& p, const char* end) {
+  while (p < end && isSpace(*p)) {
+    ++p;
   }
+}
 
-  if (!err.empty()) {
-    std::cout << err << std::endl;
+void skipLine(const char*& p, const char* end) {
+  while (p < end && *p != '\n') {
+    ++p;
+  }
+  if (p < end) {
+    ++p;
   }
+}
 
-  if (!ret) {
+// 整数を読む
+// 数字が無い場合はfalseを返す
+bool parseInt(const char*& p, const char* end, int64_t& value) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+  if (p == end || !isDigit(*p)) {
     return false;
   }
 
-  for (size_t s = 0; s < shapes.size(); ++s) {
-    size_t index_offset = 0;
-    for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); ++f) {
-      const size_t fv = shapes[s].mesh.num_face_vertices[f];
-      for (size_t v = 0; v < fv; ++v) {
-        tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
+  value = 0;
+  while (p < end && isDigit(*p)) {
+    value = 10 * value + (*p - '0');
+    ++p;
+  }
+  if (negative) {
+    value = -value;
+  }
+  return true;
+}
+
+// 実数を読む
+// strtofはNULL終端を必要とし、マップしたファイルの末尾を越えて読む可能性があるので使わない
+bool parseReal(const char*& p, const char* end, Real& value) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+
+  double mantissa = 0;
+  bool has_digits = false;
+  while (p < end && isDigit(*p)) {
+    mantissa = 10 * mantissa + (*p - '0');
+    has_digits = true;
+    ++p;
+  }
+  int exponent = 0;
+  if (p < end && *p == '.') {
+    ++p;
+    while (p < end && isDigit(*p)) {
+      mantissa = 10 * mantissa + (*p - '0');
+      exponent--;
+      has_digits = true;
+      ++p;
+    }
+  }
+  if (!has_digits) {
+    return false;
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    int64_t e;
+    if (!parseInt(p, end, e)) {
+      return false;
+    }
+    exponent += e;
+  }
+
+  const double v = mantissa * std::pow(10.0, exponent);
+  value = negative ? -v : v;
+  return true;
+}
+
+// v/vt/vnのインデックスを1つ読む
+// count: チャンク内でこれまでに現れた数
+bool parseIndex(const char*& p, const char* end, std::size_t count,
+                int64_t& index, bool& relative) {
+  int64_t i;
+  if (!parseInt(p, end, i) || i == 0) {
+    return false;
+  }
+  if (i > 0) {
+    index = i - 1;
+    relative = false;
+  } else {
+    index = static_cast<int64_t>(count) + i;
+    relative = true;
+  }
+  return true;
+}
+
+// 面の頂点を1つ読む(v, v/vt, v//vn, v/vt/vn)
+bool parseFaceVertex(const char*& p, const char* end, const ObjChunk& chunk,
+                     ObjIndex& index) {
+  index.flags = 0;
+  index.vt = 0;
+  index.vn = 0;
+
+  bool relative;
+  if (!parseIndex(p, end, chunk.vertices.size(), index.v, relative)) {
+    return false;
+  }
+  if (relative) index.flags |= ObjIndex::REL_V;
+
+  if (p < end && *p == '/') {
+    ++p;
+    if (p < end && *p != '/') {
+      if (!parseIndex(p, end, chunk.uvs.size(), index.vt, relative)) {
+        return false;
+      }
+      index.flags |= ObjIndex::HAS_VT;
+      if (relative) index.flags |= ObjIndex::REL_VT;
+    }
+    if (p < end && *p == '/') {
+      ++p;
+      if (!parseIndex(p, end, chunk.normals.size(), index.vn, relative)) {
+        return false;
+      }
+      index.flags |= ObjIndex::HAS_VN;
+      if (relative) index.flags |= ObjIndex::REL_VN;
+    }
+  }
+  return true;
+}
+
+// [begin, end)の行を解析する
+// 解析できない行があった場合はその行番号(チャンク内)を返し、無ければ0を返す
+std::size_t parseChunk(const char* begin, const char* end, ObjChunk& chunk) {
+  std::vector<ObjIndex> polygon;
+
+  std::size_t line = 0;
+  const char* p = begin;
+  while (p < end) {
+    line++;
+    skipSpaces(p, end);
+    if (p == end) {
+      break;
+    }
+
+    bool ok = true;
+    if (p + 1 < end && p[0] == 'v' && isSpace(p[1])) {
+      // 頂点座標
+      p += 2;
+      Vec3 v;
+      for (int k = 0; k < 3 && ok; ++k) {
+        skipSpaces(p, end);
+        ok = parseReal(p, end, v[k]);
+      }
+      chunk.vertices.push_back(v);
+    } else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && isSpace(p[2])) {
+      // 頂点法線
+      p += 3;
+      Vec3 n;
+      for (int k = 0; k < 3 && ok; ++k) {
+        skipSpaces(p, end);
+        ok = parseReal(p, end, n[k]);
+      }
+      chunk.normals.push_back(n);
+    } else if (p + 2 < end && p[0] == 'v' && p[1] == 't' && isSpace(p[2])) {
+      // 頂点UV(3つ目の値は無視する)
+      p += 3;
+      Vec2 uv;
+      for (int k = 0; k < 2 && ok; ++k) {
+        skipSpaces(p, end);
+        ok = parseReal(p, end, uv[k]);
+      }
+      chunk.uvs.push_back(uv);
+    } else if (p + 1 < end && p[0] == 'f' && isSpace(p[1])) {
+      // 面
+      // 多角形は最初の頂点を中心に扇形に三角形分割する
+      p += 2;
+      polygon.clear();
+      while (ok) {
+        skipSpaces(p, end);
+        if (p == end || *p == '\n' || *p == '#') {
+          break;
+        }
+        ObjIndex index;
+        ok = parseFaceVertex(p, end, chunk, index);
+        polygon.push_back(index);
+      }
+      ok = ok && polygon.size() >= 3;
+      for (std::size_t k = 2; ok && k < polygon.size(); ++k) {
+        chunk.face_vertices.push_back(polygon[0]);
+        chunk.face_vertices.push_back(polygon[k - 1]);
+        chunk.face_vertices.push_back(polygon[k]);
+      }
+    }
+    // その他の行(コメント、グループ、マテリアルなど)は読み飛ばす
+
+    if (!ok) {
+      return line;
+    }
+    skipLine(p, end);
+  }
+
+  return 0;
+}
+
+// v/vt/vnの組をキーにして頂点をまとめるためのハッシュ
+struct ObjIndexHash {
+  std::size_t operator()(const ObjIndex& index) const noexcept {
+    std::size_t h = std::hash<int64_t>()(index.v);
+    h ^= std::hash<int64_t>()(index.vt) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    h ^= std::hash<int64_t>()(index.vn) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    return h;
+  }
+};
+struct ObjIndexEqual {
+  bool operator()(const ObjIndex& a, const ObjIndex& b) const noexcept {
+    return a.v == b.v && a.vt == b.vt && a.vn == b.vn;
+  }
+};
+
+}  // namespace
+
+std::shared_ptr<TriangleMesh> loadTriangleMeshFromObj(
+    const std::string& filename) {
+  MappedFile file;
+  if (!file.open(filename)) {
+    std::cerr << "failed to open " << filename << std::endl;
+    return nullptr;
+  }
+  const char* data = file.data();
+  const std::size_t size = file.size();
+
+  // ファイルを行の境界でチャンクに分割する
+  const unsigned int num_threads =
+      std::max(std::thread::hardware_concurrency(), 1u);
+  const std::size_t num_chunks = std::max<std::size_t>(
+      1, std::min<std::size_t>(4 * num_threads, size / MIN_CHUNK_SIZE));
+  std::vector<const char*> bounds = {data};
+  for (std::size_t k = 1; k < num_chunks; ++k) {
+    const char* p = std::max(data + k * size / num_chunks, bounds.back());
+    while (p < data + size && *p != '\n') {
+      ++p;
+    }
+    bounds.push_back(std::min(p + 1, data + size));
+  }
+  bounds.push_back(data + size);
+
+  // チャンクごとに並列に解析する
+  std::vector<ObjChunk> chunks(num_chunks);
+  std::vector<std::future<std::size_t>> results;
+  for (std::size_t k = 0; k < num_chunks; ++k) {
+    results.push_back(std::async(std::launch::async, [&, k]() {
+      return parseChunk(bounds[k], bounds[k + 1], chunks[k]);
+    }));
+  }
+  bool ok = true;
+  for (std::size_t k = 0; k < num_chunks; ++k) {
+    const std::size_t line = results[k].get();
+    if (line != 0) {
+      std::cerr << filename << ": failed to parse line " << line
+                << " of chunk " << k << std::endl;
+      ok = false;
+    }
+  }
+  if (!ok) {
+    return nullptr;
+  }
+
+  // チャンクの結果をつなげ、相対参照のインデックスを全体の位置に直す
+  std::vector<Vec3> vertices;
+  std::vector<Vec3> normals;
+  std::vector<Vec2> uvs;
+  std::vector<ObjIndex> face_vertices;
+  for (const ObjChunk& chunk : chunks) {
+    const int64_t v_offset = static_cast<int64_t>(vertices.size());
+    const int64_t vt_offset = static_cast<int64_t>(uvs.size());
+    const int64_t vn_offset = static_cast<int64_t>(normals.size());
+    vertices.insert(vertices.end(), chunk.vertices.begin(),
+                    chunk.vertices.end());
+    uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+    normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+
+    for (ObjIndex index : chunk.face_vertices) {
+      if (index.flags & ObjIndex::REL_V) index.v += v_offset;
+      if (index.flags & ObjIndex::REL_VT) index.vt += vt_offset;
+      if (index.flags & ObjIndex::REL_VN) index.vn += vn_offset;
+      face_vertices.push_back(index);
+    }
+  }
+  chunks.clear();
+
+  if (face_vertices.empty()) {
+    std::cerr << filename << ": no faces" << std::endl;
+    return nullptr;
+  }
+
+  // インデックスの範囲を確認し、全ての頂点がvt/vnを持つか調べる
+  bool all_vt = true, all_vn = true;
+  for (const ObjIndex& index : face_vertices) {
+    const bool has_vt = index.flags & ObjIndex::HAS_VT;
+    const bool has_vn = index.flags & ObjIndex::HAS_VN;
+    if (index.v < 0 || index.v >= static_cast<int64_t>(vertices.size()) ||
+        (has_vt &&
+         (index.vt < 0 || index.vt >= static_cast<int64_t>(uvs.size()))) ||
+        (has_vn &&
+         (index.vn < 0 || index.vn >= static_cast<int64_t>(normals.size())))) {
+      std::cerr << filename << ": index out of range" << std::endl;
+      return nullptr;
+    }
+    all_vt = all_vt && has_vt;
+    all_vn = all_vn && has_vn;
+  }
+
+  // 一部の頂点にしか無いvt/vnは使わない
+  // 使うvt/vnが全てvと同じインデックスか調べる
+  bool shared_index = true;
+  for (ObjIndex& index : face_vertices) {
+    if (!all_vt) index.vt = 0;
+    if (!all_vn) index.vn = 0;
+    shared_index = shared_index && (!all_vt || index.vt == index.v) &&
+                   (!all_vn || index.vn == index.v);
+  }
+
+  std::vector<unsigned int> indices(face_vertices.size());
+  if (shared_index && (!all_vt || uvs.size() >= vertices.size()) &&
+      (!all_vn || normals.size() >= vertices.size())) {
+    // v/vt/vnが同じインデックスを使う場合(スキャンデータなど)は配列をそのまま使う
+    for (std::size_t k = 0; k < face_vertices.size(); ++k) {
+      indices[k] = face_vertices[k].v;
+    }
+    if (all_vt) {
+      uvs.resize(vertices.size());
+    }
+    if (all_vn) {
+      normals.resize(vertices.size());
+    }
+  } else {
+    // v/vt/vnの組ごとに1つの頂点を作る
+    std::vector<Vec3> mesh_vertices;
+    std::vector<Vec2> mesh_uvs;
+    std::vector<Vec3> mesh_normals;
+    std::unordered_map<ObjIndex, unsigned int, ObjIndexHash, ObjIndexEqual>
+        vertex_index;
+    for (std::size_t k = 0; k < face_vertices.size(); ++k) {
+      const ObjIndex& index = face_vertices[k];
+      const auto it =
+          vertex_index.emplace(index, mesh_vertices.size()).first;
+      if (it->second == mesh_vertices.size()) {
+        mesh_vertices.push_back(vertices[static_cast<std::size_t>(index.v)]);
+        if (all_vt) {
+          mesh_uvs.push_back(uvs[static_cast<std::size_t>(index.vt)]);
+        }
+        if (all_vn) {
+          mesh_normals.push_back(normals[static_cast<std::size_t>(index.vn)]);
+        }
       }
+      indices[k] = it->second;
+    }
+    vertices = std::move(mesh_vertices);
+    uvs = std::move(mesh_uvs);
+    normals = std::move(mesh_normals);
+  }
+
+  const auto mesh = std::make_shared<TriangleMesh>();
+  mesh->num_vertices = vertices.size();
+  mesh->num_faces = indices.size() / 3;
+  mesh->vertices = std::move(vertices);
+  mesh->indices = std::move(indices);
+  if (all_vt) {
+    mesh->uvs = std::move(uvs);
+  }
+  if (all_vn) {
+    mesh->normals = std::move(normals);
+  }
+
+  return mesh;
+}
+
+std::shared_ptr<Intersector> createIntersector(IntersectorType type) {
+  switch (type) {
+    case IntersectorType::Embree:
+#ifdef PRL2_USE_EMBREE
+      return std::make_shared<EmbreeIntersector>();
+#else
+      std::cerr << "built without Embree, using BVH instead" << std::endl;
+      return std::make_shared<BVHIntersector>();
+#endif
+    case IntersectorType::BVH:
+      return std::make_shared<BVHIntersector>();
+    default:
+      return std::make_shared<BVHIntersector>();
+  }
+}
+
+bool loadSceneFromObj(const std::string& filename, Scene& scene,
+                      bool use_cache, IntersectorType intersector_type) {
+  // キャッシュが有効ならOBJの解析とスペクトルの変換を省略する
+  SceneCacheData data;
+  const std::string cache_filename = filename + ".prl2cache";
+  if (!use_cache || !readSceneCache(cache_filename, filename, data)) {
+    data.mesh = loadTriangleMeshFromObj(filename);
+    if (!data.mesh) {
+      return false;
     }
+
+    // マテリアルは読まずに白のDiffuseにする
+    data.material_spd = RGB2Spectrum(RGB(0.8));
+
+    if (use_cache && !writeSceneCache(cache_filename, filename, data)) {
+      std::cerr << "failed to write scene cache: " << cache_filename
+                << std::endl;
+    }
+  }
+  const std::shared_ptr<TriangleMesh>& mesh = data.mesh;
+
+  // メッシュ全体を1つのPrimitiveにする
+  // 面ごとのオブジェクトは作らず、面はTriangleMeshのインデックスで扱う
+  const auto material = std::make_shared<Diffuse>(data.material_spd);
+  const auto geometry = std::make_shared<Geometry>(
+      std::make_shared<Mesh>(mesh), std::make_shared<Transform>());
+  scene.addPrimitive(std::make_shared<Primitive>(geometry, material));
+
+  if (!scene.intersector) {
+    scene.setIntersector(createIntersector(intersector_type));
   }
+  scene.initScene();
 
   return true;
 }
 
-}  // namespace Prl2
\ No newline at end of file
+}  // namespace Prl2
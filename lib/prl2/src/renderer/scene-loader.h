@@ -9,11 +9,29 @@
 #include "renderer/render-config.h"
 #include "renderer/scene.h"
 #include "shape/shape.h"
+#include "shape/triangle.h"
 #include "texture/texture.h"
 
 namespace Prl2 {
 
-bool loadTriangleMeshFromObj(const std::string& filename);
+// OBJファイルを読み込み、TriangleMeshを作成する
+// ファイルはメモリにマップし、行の境界で分割したチャンクごとに並列に解析する
+// 多角形は三角形に分割する。読み込めなかった場合はnullptrを返す
+std::shared_ptr<TriangleMesh> loadTriangleMeshFromObj(
+    const std::string& filename);
+
+// 指定された種類のIntersectorを作成する
+// Embreeを使わずにビルドした場合、EmbreeはBVHで代用する
+std::shared_ptr<Intersector> createIntersector(IntersectorType type);
+
+// OBJファイルのメッシュをSceneに追加し、Sceneを初期化する
+// use_cacheがtrueの場合は、filename.prl2cacheにシーンキャッシュを作成し、
+// 次回からOBJファイルが変更されていなければキャッシュから読み込む
+// SceneにIntersectorが無い場合はintersector_typeのIntersectorを使う
+bool loadSceneFromObj(const std::string& filename, Scene& scene,
+                      bool use_cache = true,
+                      IntersectorType intersector_type =
+                          DEFAULT_INTERSECTOR_TYPE);
 
 // シーンファイルを読み込み、Sceneクラスを作成する
 class SceneLoader {
@@ -15,11 +15,25 @@ void Scene::initScene() {
   intersector->initialize();
 
   // Initialize Light Array
+  lights.clear();
+  light_table.clear();
+  std::vector<Real> light_powers;
   for (const auto& prim : primitives) {
     if (prim->isLight()) {
-      lights.push_back(prim->getLight());
+      const auto& light = prim->getLight();
+      light->setIndex(light_table.size());
+      lights.push_back(light);
+      light_table.push_back(light.get());
+      light_powers.push_back(light->getPower());
     }
   }
+
+  // 放射束に比例して光源を選ぶ
+  // 暗い光源が多数あっても明るい光源にシャドウレイが集まるようにする
+  light_distribution.build(light_powers);
+
+  // 衝突点ごとに光源の面を選ぶLight BVH
+  light_bvh.build(light_table);
 }
 
 }  // namespace Prl2
\ No newline at end of file
@@ -6,7 +6,9 @@
 #include "camera/camera.h"
 #include "core/isect.h"
 #include "intersector/intersector.h"
+#include "light/light-bvh.h"
 #include "light/light.h"
+#include "sampler/alias-table.h"
 #include "sky/sky.h"
 
 namespace Prl2 {
@@ -22,12 +24,25 @@ struct Scene {
   std::vector<std::shared_ptr<Primitive>> primitives;  // Primitive Array
   std::vector<std::shared_ptr<Light>> lights;          // Light Array
 
+  // 描画中に参照する光源の表
+  // 所有権はlightsが持ち、initSceneで作り直すまで変更しない
+  // shared_ptrをコピーすると参照カウントの更新がスレッド間で競合するので、
+  // 描画中はこちらのポインタを使う
+  std::vector<const Light*> light_table;
+
+  // 光源の放射束に比例して光源を選ぶ分布(light_tableの番号に対応する)
+  AliasTable light_distribution;
+
+  // 衝突点への寄与の目安に比例して光源の面を選ぶLight BVH
+  LightBVH light_bvh;
+
   Scene();
   Scene(const std::shared_ptr<Camera> _camera,
         const std::shared_ptr<Intersector> _intersector,
         const std::shared_ptr<Sky> _sky);
 
   // シーンの初期化を行う
+  // 描画中はPrimitiveや光源を変更しないこと
   void initScene();
 
   // Primitiveを追加する
@@ -35,11 +50,51 @@ struct Scene {
     primitives.push_back(prim);
   };
 
+  // 放射束に比例して光源を1つ選び、選ぶ確率をpdfに返す
+  // u: [0, 1)^2の乱数
+  // 光源が無い場合はnullptrを返す
+  const Light* sampleLight(const Vec2& u, Real& pdf) const {
+    if (light_table.empty()) {
+      return nullptr;
+    }
+    return light_table[light_distribution.sample(u, pdf)];
+  };
+
+  // sampleLightでlightが選ばれる確率を返す
+  Real lightPdf(const Light* light) const {
+    return light_distribution.getPdf(light->getIndex());
+  };
+
+  // infoの点への寄与の目安に比例して光源の面を1つ選び、選ぶ確率をpdfに返す
+  // u: [0, 1)の乱数, face: 選んだ面
+  // 寄与する光源が無い場合はnullptrを返す
+  const Light* sampleLight(const IntersectInfo& info, const Real& u,
+                           unsigned int& face, Real& pdf) const {
+    return light_bvh.sample(info, u, face, pdf);
+  };
+
+  // infoの点に対してsampleLightでlightのface番目の面が選ばれる確率を返す
+  Real lightPdf(const IntersectInfo& info, const Light* light,
+                unsigned int face) const {
+    return light_bvh.getPdf(info, light, face);
+  };
+
   // レイとシーンの衝突計算を行う
   bool intersect(const Ray& ray, IntersectInfo& info) const {
     return intersector->intersect(ray, info);
   };
 
+  // レイがtmaxまでにシーンと衝突するか判定する
+  bool occluded(const Ray& ray, const Real& tmax) const {
+    return intersector->occluded(ray, tmax);
+  };
+
+  // n本のレイとシーンの衝突計算をまとめて行う
+  void intersectBatch(unsigned int n, const Ray* rays,
+                      IntersectInfo* infos) const {
+    intersector->intersectBatch(n, rays, infos);
+  };
+
   // Skyをセットする
   void setSky(const std::shared_ptr<Sky>& _sky) { sky = _sky; };
 
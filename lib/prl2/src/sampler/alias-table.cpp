@@ -0,0 +1,74 @@
+#include "sampler/alias-table.h"
+
+#include <algorithm>
+
+namespace Prl2 {
+
+void AliasTable::build(const std::vector<Real>& weights) {
+  const unsigned int n = weights.size();
+  bins.resize(n);
+  if (n == 0) {
+    return;
+  }
+
+  // 正規化する
+  double sum = 0;
+  for (const Real& w : weights) {
+    sum += std::max(w, Real(0));
+  }
+  for (unsigned int i = 0; i < n; ++i) {
+    bins[i].pdf = sum > 0 ? std::max(weights[i], Real(0)) / sum : Real(1) / n;
+  }
+
+  // 平均を1にした確率を、1より小さいものと大きいものに分ける
+  std::vector<unsigned int> small, large;
+  std::vector<double> scaled(n);
+  for (unsigned int i = 0; i < n; ++i) {
+    scaled[i] = static_cast<double>(bins[i].pdf) * n;
+    if (scaled[i] < 1) {
+      small.push_back(i);
+    } else {
+      large.push_back(i);
+    }
+  }
+
+  // 小さいビンの足りない分を大きいビンから埋める
+  while (!small.empty() && !large.empty()) {
+    const unsigned int s = small.back();
+    small.pop_back();
+    const unsigned int l = large.back();
+
+    bins[s].prob = scaled[s];
+    bins[s].alias = l;
+
+    scaled[l] -= 1 - scaled[s];
+    if (scaled[l] < 1) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+
+  // 残りは丸め誤差を除いて1になっている
+  for (const unsigned int i : small) {
+    bins[i].prob = 1;
+    bins[i].alias = i;
+  }
+  for (const unsigned int i : large) {
+    bins[i].prob = 1;
+    bins[i].alias = i;
+  }
+}
+
+unsigned int AliasTable::sample(const Vec2& u, Real& pdf) const {
+  // 1つの乱数の整数部と小数部を使うと、ビンが多い場合に小数部の精度が
+  // 足りなくなり、エイリアスを選ぶ確率が量子化されてgetPdfと合わなくなる
+  // そのためビンの選択と自身かエイリアスかの選択には別の乱数を使う
+  const unsigned int i = std::min(
+      static_cast<unsigned int>(static_cast<double>(u.x()) * bins.size()),
+      size() - 1);
+  const unsigned int k = u.y() < bins[i].prob ? i : bins[i].alias;
+  pdf = bins[k].pdf;
+  return k;
+}
+
+}  // namespace Prl2
@@ -0,0 +1,45 @@
+#ifndef _PRL2_ALIAS_TABLE_H
+#define _PRL2_ALIAS_TABLE_H
+
+#include <vector>
+
+#include "core/type.h"
+#include "core/vec2.h"
+
+namespace Prl2 {
+
+// 離散分布をO(1)でサンプリングするためのエイリアステーブル(Vose's method)
+// 各ビンは自身を選ぶ確率と、選ばなかった場合に代わりに選ぶビンを持つ
+class AliasTable {
+ public:
+  AliasTable(){};
+
+  // 重みに比例する分布を構築する
+  // 重みの合計が0以下の場合は一様分布にする
+  void build(const std::vector<Real>& weights);
+
+  // [0, 1)^2の乱数からビンを1つ選び、その確率をpdfに返す
+  // u.x()でビンを選び、u.y()でそのビンかエイリアスかを選ぶ
+  unsigned int sample(const Vec2& u, Real& pdf) const;
+
+  // i番目のビンが選ばれる確率を返す
+  Real getPdf(unsigned int i) const { return bins[i].pdf; };
+
+  // ビンの数を返す
+  unsigned int size() const { return bins.size(); };
+
+  bool empty() const { return bins.empty(); };
+
+ private:
+  struct Bin {
+    Real prob;           // 自身を選ぶ確率
+    unsigned int alias;  // 自身を選ばなかった場合に選ぶビン
+    Real pdf;            // 正規化した確率
+  };
+
+  std::vector<Bin> bins;  // ビン
+};
+
+}  // namespace Prl2
+
+#endif
@@ -18,6 +18,14 @@ class RandomSampler : public Sampler {
     return Vec2(rng.uniformReal(), rng.uniformReal());
   };
 
+  SamplerState getState() const override {
+    const pcg32_random_t& state = rng.getState();
+    return SamplerState{state.state, state.inc};
+  };
+  void setState(const SamplerState& state) override {
+    rng.setState(pcg32_random_t{state.state, state.inc});
+  };
+
   std::unique_ptr<Sampler> clone(uint64_t seed) override {
     return std::unique_ptr<Sampler>(new RandomSampler(seed));
   };
@@ -33,6 +33,11 @@ class RNG {
 
   void setSeed(uint64_t seed);
 
+  // 内部状態を入手する
+  const pcg32_random_t& getState() const { return state; }
+  // 内部状態を復元する
+  void setState(const pcg32_random_t& _state) { state = _state; }
+
   uint32_t uniformUInt32();
   Real uniformReal();
 
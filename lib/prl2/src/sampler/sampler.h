@@ -10,6 +10,13 @@
 
 namespace Prl2 {
 
+// Samplerの内部状態
+// 画素ごとに保存しておき、1つのSamplerを使い回すために使う
+struct SamplerState {
+  uint64_t state;
+  uint64_t inc;
+};
+
 // 乱数を生成するクラス
 class Sampler {
  public:
@@ -24,6 +31,12 @@ class Sampler {
   // 次の次元の乱数を２つ入手
   virtual Vec2 getNext2D() = 0;
 
+  // 内部状態を入手する
+  virtual SamplerState getState() const = 0;
+
+  // 内部状態を復元する
+  virtual void setState(const SamplerState& state) = 0;
+
   // Cloneする
   virtual std::unique_ptr<Sampler> clone(uint64_t seed) = 0;
 };
@@ -43,6 +43,14 @@ inline Vec3 sampleCosineHemisphere(const Vec2& u) {
   return Vec3(d.x(), z, d.y());
 }
 
+// 2つのサンプリング手法を組み合わせる時のMISの重み(Power Heuristic)
+// pdf_fが重みを計算する手法のpdf、pdf_gがもう一方の手法のpdf
+inline Real powerHeuristic(const Real& pdf_f, const Real& pdf_g) {
+  const Real f2 = pdf_f * pdf_f;
+  const Real g2 = pdf_g * pdf_g;
+  return f2 + g2 > 0 ? f2 / (f2 + g2) : 0;
+}
+
 }  // namespace Prl2
 
 #endif
\ No newline at end of file
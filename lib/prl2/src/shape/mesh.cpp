@@ -0,0 +1,78 @@
+#include "shape/mesh.h"
+
+#include <algorithm>
+
+namespace Prl2 {
+
+Mesh::Mesh(const std::shared_ptr<TriangleMesh>& _mesh) : mesh(_mesh) {
+  // バウンディングボックス
+  if (!mesh->vertices.empty()) {
+    bounds = Bounds3(mesh->vertices[0], mesh->vertices[0]);
+    for (const Vec3& v : mesh->vertices) {
+      bounds = mergeBounds(bounds, v);
+    }
+  }
+
+  // 面積の累積分布
+  area_cdf.resize(mesh->num_faces);
+  total_area = 0;
+  for (unsigned int face = 0; face < mesh->num_faces; ++face) {
+    total_area += mesh->getFaceArea(face);
+    area_cdf[face] = total_area;
+  }
+  if (total_area > 0) {
+    for (Real& c : area_cdf) {
+      c /= total_area;
+    }
+  }
+}
+
+bool Mesh::intersect(const Ray& ray, IntersectInfo& info) const {
+  bool hit = false;
+  Real t = ray.tmax;
+  IntersectInfo info_tmp;
+  for (unsigned int face = 0; face < mesh->num_faces; ++face) {
+    //衝突距離が最も小さいものを選ぶ
+    if (mesh->intersectFace(face, ray, info_tmp) && info_tmp.t < t) {
+      t = info_tmp.t;
+      info = info_tmp;
+      hit = true;
+    }
+  }
+  return hit;
+}
+
+bool Mesh::occluded(const Ray& ray, const Real& tmax) const {
+  for (unsigned int face = 0; face < mesh->num_faces; ++face) {
+    if (mesh->occludedFace(face, ray, tmax)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Bounds3 Mesh::getBounds() const { return bounds; }
+
+void Mesh::samplePoint(Sampler& sampler, Vec3& p, Vec3& n,
+                       Real& pdf_area) const {
+  // 面積に比例して面を選ぶ
+  const Real u = sampler.getNext();
+  const unsigned int face = std::min(
+      static_cast<unsigned int>(
+          std::upper_bound(area_cdf.begin(), area_cdf.end(), u) -
+          area_cdf.begin()),
+      mesh->num_faces - 1);
+
+  // 面上の点をサンプリングする
+  // 面を選ぶ確率(面積 / 表面積)と面上の点の確率(1 / 面積)の積は1 / 表面積になる
+  mesh->sampleFace(face, sampler.getNext2D(), p, n);
+  pdf_area = 1 / total_area;
+}
+
+void Mesh::sampleFace(unsigned int face, Sampler& sampler, Vec3& p, Vec3& n,
+                      Real& pdf_area) const {
+  mesh->sampleFace(face, sampler.getNext2D(), p, n);
+  pdf_area = 1 / mesh->getFaceArea(face);
+}
+
+}  // namespace Prl2
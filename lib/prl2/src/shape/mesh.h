@@ -0,0 +1,72 @@
+#ifndef _PRL2_MESH_H
+#define _PRL2_MESH_H
+
+#include <memory>
+#include <vector>
+
+#include "core/type.h"
+#include "shape/shape.h"
+#include "shape/triangle.h"
+
+namespace Prl2 {
+
+// 三角形メッシュ全体を1つのShapeとして表現するクラス
+// 面ごとにTriangleを作らずに、面のインデックスで衝突計算やサンプリングを行う
+// 面ごとに持つのはTriangleMeshの頂点インデックスと面積の累積分布のみ
+class Mesh : public Shape {
+ public:
+  Mesh(const std::shared_ptr<TriangleMesh>& _mesh);
+
+  // 全ての面との衝突計算を行う
+  // BVHやEmbreeを使う場合は面ごとの関数が使われる
+  bool intersect(const Ray& ray, IntersectInfo& info) const override;
+
+  bool occluded(const Ray& ray, const Real& tmax) const override;
+
+  Bounds3 getBounds() const override;
+
+  Real getArea() const override { return total_area; };
+
+  // 面積に比例して面を選び、その面上の点を一様にサンプリングする
+  void samplePoint(Sampler& sampler, Vec3& p, Vec3& n,
+                   Real& pdf_area) const override;
+
+  unsigned int getNumFaces() const override { return mesh->num_faces; };
+
+  bool intersectFace(unsigned int face, const Ray& ray,
+                     IntersectInfo& info) const override {
+    return mesh->intersectFace(face, ray, info);
+  };
+
+  bool occludedFace(unsigned int face, const Ray& ray,
+                    const Real& tmax) const override {
+    return mesh->occludedFace(face, ray, tmax);
+  };
+
+  Bounds3 getFaceBounds(unsigned int face) const override {
+    return mesh->getFaceBounds(face);
+  };
+
+  Real getFaceArea(unsigned int face) const override {
+    return mesh->getFaceArea(face);
+  };
+
+  DirectionCone getFaceNormalCone(unsigned int face) const override {
+    return mesh->getFaceNormalCone(face);
+  };
+
+  void sampleFace(unsigned int face, Sampler& sampler, Vec3& p, Vec3& n,
+                  Real& pdf_area) const override;
+
+  const std::shared_ptr<TriangleMesh>& getMesh() const { return mesh; };
+
+ private:
+  const std::shared_ptr<TriangleMesh> mesh;  // Triangle Mesh
+
+  Bounds3 bounds;                // バウンディングボックス
+  Real total_area;               // 表面積
+  std::vector<Real> area_cdf;    // 面積の累積分布(正規化済み)
+};
+
+}  // namespace Prl2
+#endif
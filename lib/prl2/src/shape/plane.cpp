@@ -16,9 +16,9 @@ bool Plane::intersect(const Ray& ray, IntersectInfo& info) const {
   return true;
 }
 
-bool Plane::occluded(const Ray& ray) const {
+bool Plane::occluded(const Ray& ray, const Real& tmax) const {
   const Real t = -ray.origin[1] / ray.direction[1];
-  if (t < ray.tmin || t > ray.tmax || std::isnan(t)) return false;
+  if (t < ray.tmin || t > tmax || std::isnan(t)) return false;
 
   const Vec3 hitPos = ray(t);
   if (std::abs(hitPos.x()) > 0.5 || std::abs(hitPos.z()) > 0.5) return false;
@@ -36,6 +36,8 @@ void Plane::samplePoint(Sampler& sampler, Vec3& p, Vec3& n,
   pdf_area = 1;
 }
 
+Real Plane::getArea() const { return 1; }
+
 Bounds3 Plane::getBounds() const {
   return Bounds3(Vec3(-0.5, -EPS, -0.5), Vec3(0.5, EPS, 0.5));
 }
@@ -11,10 +11,16 @@ class Plane : public Shape {
 
   bool intersect(const Ray& ray, IntersectInfo& info) const override;
 
-  bool occluded(const Ray& ray) const override;
+  bool occluded(const Ray& ray, const Real& tmax) const override;
 
   Bounds3 getBounds() const override;
 
+  Real getArea() const override;
+
+  DirectionCone getFaceNormalCone(unsigned int face) const override {
+    return DirectionCone(Vec3(0, 1, 0));
+  };
+
   void samplePoint(Sampler& sampler, Vec3& p, Vec3& n,
                    Real& pdf_area) const override;
 };
@@ -4,6 +4,7 @@
 #include <memory>
 
 #include "core/bounds3.h"
+#include "core/direction-cone.h"
 #include "core/isect.h"
 #include "core/ray.h"
 #include "core/transform.h"
@@ -25,14 +26,56 @@ class Shape {
   virtual bool intersect(const Ray& ray, IntersectInfo& info) const = 0;
 
   // 受け取ったレイとの衝突判定を行う
-  virtual bool occluded(const Ray& ray) const = 0;
+  // tmax : 最大衝突距離(これより遠い衝突は無視する)
+  virtual bool occluded(const Ray& ray, const Real& tmax) const = 0;
 
   // ローカル座標系のバウンディングボックスを返す
   virtual Bounds3 getBounds() const = 0;
 
+  // ローカル座標系での表面積を返す
+  virtual Real getArea() const = 0;
+
   // 表面上の点をサンプリングする
   virtual void samplePoint(Sampler& sampler, Vec3& p, Vec3& n,
                            Real& pdf_area) const = 0;
+
+  // 面の数を返す
+  // メッシュのように複数の面からなるShapeは面ごとに衝突計算ができる
+  // それ以外のShapeは全体を1つの面として扱う
+  virtual unsigned int getNumFaces() const { return 1; };
+
+  // face番目の面との衝突計算を行う
+  virtual bool intersectFace(unsigned int face, const Ray& ray,
+                             IntersectInfo& info) const {
+    return intersect(ray, info);
+  };
+
+  // face番目の面とのtmaxまでの衝突判定を行う
+  virtual bool occludedFace(unsigned int face, const Ray& ray,
+                            const Real& tmax) const {
+    return occluded(ray, tmax);
+  };
+
+  // face番目の面のローカル座標系のバウンディングボックスを返す
+  virtual Bounds3 getFaceBounds(unsigned int face) const {
+    return getBounds();
+  };
+
+  // face番目の面のローカル座標系での表面積を返す
+  virtual Real getFaceArea(unsigned int face) const { return getArea(); };
+
+  // face番目の面の法線を全て含む円錐を返す
+  // 既定では全ての方向とする
+  virtual DirectionCone getFaceNormalCone(unsigned int face) const {
+    return DirectionCone::entireSphere();
+  };
+
+  // face番目の面上の点をサンプリングする
+  // pdf_areaは面上の面積に関するpdf
+  virtual void sampleFace(unsigned int face, Sampler& sampler, Vec3& p,
+                          Vec3& n, Real& pdf_area) const {
+    samplePoint(sampler, p, n, pdf_area);
+  };
 };
 
 }  // namespace Prl2
@@ -52,7 +52,7 @@ bool Sphere::intersect(const Ray& ray, IntersectInfo& info) const {
   return true;
 }
 
-bool Sphere::occluded(const Ray& ray) const {
+bool Sphere::occluded(const Ray& ray, const Real& tmax) const {
   const Real a = length2(ray.direction);
   const Real b = 2 * dot(ray.direction, ray.origin);
   const Real c = length2(ray.origin) - 1;
@@ -72,9 +72,9 @@ bool Sphere::occluded(const Ray& ray) const {
 
   //近い方の解を計算
   Real t = t0;
-  if (t < ray.tmin || t > ray.tmax) {
+  if (t < ray.tmin || t > tmax) {
     t = t1;
-    if (t < ray.tmin || t > ray.tmax) {
+    if (t < ray.tmin || t > tmax) {
       return false;
     }
   }
@@ -91,4 +91,6 @@ void Sphere::samplePoint(Sampler& sampler, Vec3& p, Vec3& n,
 
 Bounds3 Sphere::getBounds() const { return Bounds3(Vec3(-1), Vec3(1)); }
 
+Real Sphere::getArea() const { return PI_MUL_4; }
+
 }  // namespace Prl2
\ No newline at end of file
@@ -13,10 +13,12 @@ class Sphere : public Shape {
 
   bool intersect(const Ray& ray, IntersectInfo& info) const override;
 
-  bool occluded(const Ray& ray) const override;
+  bool occluded(const Ray& ray, const Real& tmax) const override;
 
   Bounds3 getBounds() const override;
 
+  Real getArea() const override;
+
   void samplePoint(Sampler& sampler, Vec3& p, Vec3& n,
                    Real& pdf_area) const override;
 };
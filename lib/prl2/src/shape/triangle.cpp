@@ -4,25 +4,12 @@
 
 namespace Prl2 {
 
-Triangle::Triangle(const std::shared_ptr<TriangleMesh>& _mesh,
-                   unsigned int face_index)
-    : mesh(_mesh),
-      v0(_mesh->indices[3 * face_index]),
-      v1(_mesh->indices[3 * face_index + 1]),
-      v2(_mesh->indices[3 * face_index + 2]) {
-  const Vec3& p0 = mesh->vertices[v0];
-  const Vec3& p1 = mesh->vertices[v0];
-  const Vec3& p2 = mesh->vertices[v0];
-  face_area = 0.5f * length(cross(p1 - p0, p2 - p0));
-}
-
 // Möller–Trumbore intersection algorithm
 // https://www.wikiwand.com/en/M%C3%B6ller%E2%80%93Trumbore_intersection_algorithm
-bool Triangle::intersect(const Ray& ray, IntersectInfo& info) const {
-  const Vec3& p0 = mesh->vertices[v0];
-  const Vec3& p1 = mesh->vertices[v1];
-  const Vec3& p2 = mesh->vertices[v2];
-
+// 衝突した場合は衝突距離と重心座標を返す
+static bool intersectTriangle(const Vec3& p0, const Vec3& p1, const Vec3& p2,
+                              const Ray& ray, const Real& tmax, Real& t,
+                              Real& u, Real& v) {
   const Vec3 edge1 = p1 - p0;
   const Vec3 edge2 = p2 - p0;
   const Vec3 h = cross(ray.direction, edge2);
@@ -33,93 +20,65 @@ bool Triangle::intersect(const Ray& ray, IntersectInfo& info) const {
   }
 
   const Real f = 1.0f / a;
-  const Vec3 s = ray.origin - v0;
-  const Real u = f * dot(s, h);
+  const Vec3 s = ray.origin - p0;
+  u = f * dot(s, h);
   if (u < 0.0f || u > 1.0f) {
     return false;
   }
 
   const Vec3 q = cross(s, edge1);
-  const Real v = f * dot(ray.direction, q);
+  v = f * dot(ray.direction, q);
 
   if (v < 0.0f || u + v > 1.0f) {
     return false;
   }
 
   // compute hit distance
-  const Real t = f * dot(edge2, q);
-  if (t < ray.tmin || t > ray.tmax) {
+  t = f * dot(edge2, q);
+  if (t < ray.tmin || t > tmax) {
     return false;
   }
-  info.t = t;
-
-  // compute hit position
-  info.hitPos = ray(t);
-
-  // compute normal
-  if (mesh->normals) {
-    const Vec3& n0 = mesh->normals[v0];
-    const Vec3& n1 = mesh->normals[v1];
-    const Vec3& n2 = mesh->normals[v2];
-    info.hitNormal = lerp3(u, v, n0, n1, n2);
-  } else {
-    info.hitNormal = normalize(cross(edge1, edge2));
-  }
-
-  // compute uv
-  if (mesh->uvs) {
-    const Vec2& uv0 = mesh->uvs[v0];
-    const Vec2& uv1 = mesh->uvs[v1];
-    const Vec2& uv2 = mesh->uvs[v2];
-    info.uv = lerp3(u, v, uv0, uv1, uv2);
-  } else {
-    info.uv = Vec2(u, v);
-  }
 
   return true;
 }
 
-bool Triangle::occluded(const Ray& ray) const {
-  const Vec3& p0 = mesh->vertices[v0];
-  const Vec3& p1 = mesh->vertices[v1];
-  const Vec3& p2 = mesh->vertices[v2];
+bool TriangleMesh::intersectFace(unsigned int face, const Ray& ray,
+                                 IntersectInfo& info) const {
+  const Vec3& p0 = vertices[indices[3 * face]];
+  const Vec3& p1 = vertices[indices[3 * face + 1]];
+  const Vec3& p2 = vertices[indices[3 * face + 2]];
 
-  const Vec3 edge1 = p1 - p0;
-  const Vec3 edge2 = p2 - p0;
-  const Vec3 h = cross(ray.direction, edge2);
-
-  const Real a = dot(edge1, h);
-  if (a > -EPS && a < EPS) {
-    return false;
-  }
-
-  const Real f = 1.0f / a;
-  const Vec3 s = ray.origin - v0;
-  const Real u = f * dot(s, h);
-  if (u < 0.0f || u > 1.0f) {
+  Real t, u, v;
+  if (!intersectTriangle(p0, p1, p2, ray, ray.tmax, t, u, v)) {
     return false;
   }
+  info.t = t;
 
-  const Vec3 q = cross(s, edge1);
-  const Real v = f * dot(ray.direction, q);
+  // compute hit position
+  info.hitPos = ray(t);
 
-  if (v < 0.0f || u + v > 1.0f) {
-    return false;
-  }
+  // compute normal and uv
+  getShadingInfo(face, u, v, info.hitNormal, info.uv);
 
-  // compute hit distance
-  const Real t = f * dot(edge2, q);
-  if (t < ray.tmin || t > ray.tmax) {
-    return false;
-  }
+  info.faceID = face;
 
   return true;
 }
 
-Bounds3 Triangle::getBounds() const {
-  const Vec3& p0 = mesh->vertices[v0];
-  const Vec3& p1 = mesh->vertices[v1];
-  const Vec3& p2 = mesh->vertices[v2];
+bool TriangleMesh::occludedFace(unsigned int face, const Ray& ray,
+                                const Real& tmax) const {
+  const Vec3& p0 = vertices[indices[3 * face]];
+  const Vec3& p1 = vertices[indices[3 * face + 1]];
+  const Vec3& p2 = vertices[indices[3 * face + 2]];
+
+  Real t, u, v;
+  return intersectTriangle(p0, p1, p2, ray, tmax, t, u, v);
+}
+
+Bounds3 TriangleMesh::getFaceBounds(unsigned int face) const {
+  const Vec3& p0 = vertices[indices[3 * face]];
+  const Vec3& p1 = vertices[indices[3 * face + 1]];
+  const Vec3& p2 = vertices[indices[3 * face + 2]];
 
   const Real p0x = std::min(p0.x(), std::min(p1.x(), p2.x()));
   const Real p0y = std::min(p0.y(), std::min(p1.y(), p2.y()));
@@ -132,25 +91,97 @@ Bounds3 Triangle::getBounds() const {
   return Bounds3(Vec3(p0x, p0y, p0z), Vec3(p1x, p1y, p1z));
 }
 
-void Triangle::samplePoint(Sampler& sampler, Vec3& p, Vec3& n,
-                           Real& pdf_area) const {
-  const Vec3& p0 = mesh->vertices[v0];
-  const Vec3& p1 = mesh->vertices[v1];
-  const Vec3& p2 = mesh->vertices[v2];
+Real TriangleMesh::getFaceArea(unsigned int face) const {
+  const Vec3& p0 = vertices[indices[3 * face]];
+  const Vec3& p1 = vertices[indices[3 * face + 1]];
+  const Vec3& p2 = vertices[indices[3 * face + 2]];
+  return 0.5f * length(cross(p1 - p0, p2 - p0));
+}
 
-  const Vec2 uv = sampleTriangle(sampler.getNext2D());
+DirectionCone TriangleMesh::getFaceNormalCone(unsigned int face) const {
+  const unsigned int v0 = indices[3 * face];
+  const unsigned int v1 = indices[3 * face + 1];
+  const unsigned int v2 = indices[3 * face + 2];
+
+  if (normals.empty()) {
+    const Vec3& p0 = vertices[v0];
+    const Vec3& p1 = vertices[v1];
+    const Vec3& p2 = vertices[v2];
+    return DirectionCone(normalize(cross(p1 - p0, p2 - p0)));
+  }
+
+  // 補間した法線は頂点法線の円錐に含まれる
+  // ただし円錐が半球より広いと補間した法線が外に出ることがあるので全方向にする
+  const DirectionCone cone =
+      mergeCones(mergeCones(DirectionCone(normalize(normals[v0])),
+                            DirectionCone(normalize(normals[v1]))),
+                 DirectionCone(normalize(normals[v2])));
+  return cone.cos_theta > 0 ? cone : DirectionCone::entireSphere();
+}
+
+void TriangleMesh::sampleFace(unsigned int face, const Vec2& u, Vec3& p,
+                              Vec3& n) const {
+  const Vec3& p0 = vertices[indices[3 * face]];
+  const Vec3& p1 = vertices[indices[3 * face + 1]];
+  const Vec3& p2 = vertices[indices[3 * face + 2]];
+
+  const Vec2 uv = sampleTriangle(u);
 
   p = lerp3(uv.x(), uv.y(), p0, p1, p2);
 
-  if (mesh->normals) {
-    const Vec3& n0 = mesh->normals[v0];
-    const Vec3& n1 = mesh->normals[v1];
-    const Vec3& n2 = mesh->normals[v2];
-    n = lerp3(uv.x(), uv.y(), n0, n1, n2);
+  Vec2 uv_shading;
+  getShadingInfo(face, uv.x(), uv.y(), n, uv_shading);
+}
+
+void TriangleMesh::getShadingInfo(unsigned int face, const Real& u,
+                                  const Real& v, Vec3& n, Vec2& uv) const {
+  const unsigned int v0 = indices[3 * face];
+  const unsigned int v1 = indices[3 * face + 1];
+  const unsigned int v2 = indices[3 * face + 2];
+
+  // compute normal
+  if (!normals.empty()) {
+    const Vec3& n0 = normals[v0];
+    const Vec3& n1 = normals[v1];
+    const Vec3& n2 = normals[v2];
+    n = normalize(lerp3(u, v, n0, n1, n2));
   } else {
+    const Vec3& p0 = vertices[v0];
+    const Vec3& p1 = vertices[v1];
+    const Vec3& p2 = vertices[v2];
     n = normalize(cross(p1 - p0, p2 - p0));
   }
 
+  // compute uv
+  if (!uvs.empty()) {
+    const Vec2& uv0 = uvs[v0];
+    const Vec2& uv1 = uvs[v1];
+    const Vec2& uv2 = uvs[v2];
+    uv = lerp3(u, v, uv0, uv1, uv2);
+  } else {
+    uv = Vec2(u, v);
+  }
+}
+
+Triangle::Triangle(const std::shared_ptr<TriangleMesh>& _mesh,
+                   unsigned int _face_index)
+    : mesh(_mesh), face_index(_face_index) {
+  face_area = mesh->getFaceArea(face_index);
+}
+
+bool Triangle::intersect(const Ray& ray, IntersectInfo& info) const {
+  return mesh->intersectFace(face_index, ray, info);
+}
+
+bool Triangle::occluded(const Ray& ray, const Real& tmax) const {
+  return mesh->occludedFace(face_index, ray, tmax);
+}
+
+Bounds3 Triangle::getBounds() const { return mesh->getFaceBounds(face_index); }
+
+void Triangle::samplePoint(Sampler& sampler, Vec3& p, Vec3& n,
+                           Real& pdf_area) const {
+  mesh->sampleFace(face_index, sampler.getNext2D(), p, n);
   pdf_area = 1 / face_area;
 }
 
@@ -1,32 +1,95 @@
 #ifndef _PRL2_TRIANGLE_H
 #define _PRL2_TRIANGLE_H
 
+#include <cstddef>
 #include <memory>
+#include <vector>
 
 #include "core/type.h"
 #include "shape/shape.h"
 
 namespace Prl2 {
 
+// 連続したメモリに置かれた読み取り専用の配列
+// vectorから作った場合は中身を引き取り、
+// マップしたファイルなどの領域から作った場合はコピーせずに参照する
+// 参照先の領域はstorageが持ち続けるので、コピーしても同じ領域を共有する
+template <typename T>
+class MeshArray {
+ public:
+  MeshArray() : ptr(nullptr), count(0){};
+
+  MeshArray(std::vector<T>&& v) {
+    const auto owned = std::make_shared<const std::vector<T>>(std::move(v));
+    storage = owned;
+    ptr = owned->data();
+    count = owned->size();
+  };
+
+  // _ptrから_count個の要素を参照する
+  // _storageは_ptrの領域を持つオブジェクト
+  MeshArray(const T* _ptr, std::size_t _count,
+            const std::shared_ptr<const void>& _storage)
+      : storage(_storage), ptr(_ptr), count(_count){};
+
+  const T& operator[](std::size_t i) const { return ptr[i]; };
+
+  const T* data() const { return ptr; };
+  std::size_t size() const { return count; };
+  bool empty() const { return count == 0; };
+
+  const T* begin() const { return ptr; };
+  const T* end() const { return ptr + count; };
+
+ private:
+  std::shared_ptr<const void> storage;  // 要素の領域を持つオブジェクト
+  const T* ptr;                         // 先頭の要素
+  std::size_t count;                    // 要素数
+};
+
 // 三角形メッシュを表す
+// 各配列は連続したメモリに置き、Embreeなどからそのまま参照できるようにする
+// normalsとuvsは持たない場合は空にする
+// 面ごとの計算は面のインデックスを受け取って行い、面ごとのオブジェクトは作らない
 struct TriangleMesh {
-  unsigned int num_vertices;  // 頂点数
-  unsigned int num_faces;     // 面の数
-  Vec3* vertices;             // 頂点座標
-  unsigned int* indices;      // 頂点インデックス配列
-  Vec3* normals;              // 頂点法線
-  Vec2* uvs;                  // 頂点UV
+  unsigned int num_vertices;          // 頂点数
+  unsigned int num_faces;             // 面の数
+  MeshArray<Vec3> vertices;           // 頂点座標
+  MeshArray<unsigned int> indices;    // 頂点インデックス配列(面ごとに3つ)
+  MeshArray<Vec3> normals;            // 頂点法線
+  MeshArray<Vec2> uvs;                // 頂点UV
 
   TriangleMesh() {
     num_vertices = 0;
     num_faces = 0;
-    vertices = nullptr;
-    indices = nullptr;
-    normals = nullptr;
-    uvs = nullptr;
   };
+
+  // face番目の面との衝突計算を行う
+  bool intersectFace(unsigned int face, const Ray& ray,
+                     IntersectInfo& info) const;
+
+  // face番目の面とのtmaxまでの衝突判定を行う
+  bool occludedFace(unsigned int face, const Ray& ray, const Real& tmax) const;
+
+  // face番目の面のバウンディングボックスを返す
+  Bounds3 getFaceBounds(unsigned int face) const;
+
+  // face番目の面の面積を返す
+  Real getFaceArea(unsigned int face) const;
+
+  // face番目の面のシェーディング法線を全て含む円錐を返す
+  DirectionCone getFaceNormalCone(unsigned int face) const;
+
+  // face番目の面上の点を一様にサンプリングする
+  void sampleFace(unsigned int face, const Vec2& u, Vec3& p, Vec3& n) const;
+
+  // face番目の面の重心座標(u, v)でのシェーディング法線とUVを計算する
+  // 頂点法線や頂点UVが無い場合は面の法線と(u, v)をそのまま返す
+  void getShadingInfo(unsigned int face, const Real& u, const Real& v, Vec3& n,
+                      Vec2& uv) const;
 };
 
+// 三角形メッシュの1つの面を表す
 class Triangle : public Shape {
  public:
   // face_index: 面のインデックス
@@ -34,21 +97,28 @@ class Triangle : public Shape {
 
   bool intersect(const Ray& ray, IntersectInfo& info) const override;
 
-  bool occluded(const Ray& ray) const override;
+  bool occluded(const Ray& ray, const Real& tmax) const override;
 
   Bounds3 getBounds() const override;
 
+  Real getArea() const override { return face_area; };
+
+  DirectionCone getFaceNormalCone(unsigned int face) const override {
+    return mesh->getFaceNormalCone(face_index);
+  };
+
   void samplePoint(Sampler& sampler, Vec3& p, Vec3& n,
                    Real& pdf_area) const override;
 
+  const std::shared_ptr<TriangleMesh>& getMesh() const { return mesh; };
+  unsigned int getFaceIndex() const { return face_index; };
+
  private:
   const std::shared_ptr<TriangleMesh> mesh;  // Triangle Mesh
-  const unsigned int v0;                     // 頂点0のインデックス
-  const unsigned int v1;                     // 頂点1のインデックス
-  const unsigned int v2;                     // 頂点2のインデックス
+  const unsigned int face_index;             // 面のインデックス
 
   Real face_area;
 };
 
 }  // namespace Prl2
-#endif
\ No newline at end of file
+#endif
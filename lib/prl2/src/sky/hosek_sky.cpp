@@ -1,54 +1,348 @@
 #include "sky/hosek_sky.h"
 
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "sampler/alias-table.h"
+
 namespace Prl2 {
 
-HosekSky::HosekSky(const Vec3& _sunDirection, const Real& turbidity,
-                   const SPD& albedo)
-    : sunDirection(normalize(_sunDirection)) {
-  Real solarElevation, _tmp;
-  cartesianToSpherical(sunDirection, solarElevation, _tmp);
-  solarElevation = PI_DIV_2 - solarElevation;
+// 焼き込んだ空
+// パラメーターが同じHosekSkyの間で共有する
+struct HosekSky::Table {
+  // 太陽の方向, Turbidity, Albedo
+  Vec3 sun_direction;
+  Real turbidity;
+  SPD albedo;
+
+  // 波長ごとのモデルの状態(太陽の円盤の評価に使う)
+  ArHosekSkyModelState* state[SPD::LAMBDA_SAMPLES];
+
+  // 空の放射輝度
+  // 画素(i, j)のbin番目の波長の値を(i + TABLE_WIDTH * j) * LAMBDA_SAMPLES + bin
+  // に並べる
+  std::vector<float> radiance;
+
+  AliasTable distribution;  // 空の画素を選ぶ分布
+  Real sun_prob;            // 太陽を選ぶ確率
+
+  Table(const Vec3& _sun_direction, const Real& _turbidity, const SPD& _albedo);
+  ~Table();
+
+  Table(const Table&) = delete;
+  Table& operator=(const Table&) = delete;
+
+  bool hasSameParameters(const Vec3& _sun_direction, const Real& _turbidity,
+                         const SPD& _albedo) const {
+    return sun_direction.x() == _sun_direction.x() &&
+           sun_direction.y() == _sun_direction.y() &&
+           sun_direction.z() == _sun_direction.z() &&
+           turbidity == _turbidity && albedo.phi == _albedo.phi;
+  };
+};
+
+namespace {
+
+// モデルが定義されている波長の範囲[nm]
+constexpr Real MODEL_LAMBDA_MIN = 320;
+constexpr Real MODEL_LAMBDA_MAX = 720;
+
+// 保持しておくテーブルの数
+constexpr std::size_t TABLE_CACHE_SIZE = 8;
+
+// 波長に対応するSPDのビンを返す
+// モデルの範囲外の場合は-1を返す
+int lambdaToBin(const Real& l) {
+  if (l < MODEL_LAMBDA_MIN || l >= MODEL_LAMBDA_MAX || l < SPD::LAMBDA_MIN) {
+    return -1;
+  }
+  const int bin = (l - SPD::LAMBDA_MIN) / SPD::LAMBDA_INTERVAL;
+  return std::min(bin, static_cast<int>(SPD::LAMBDA_SAMPLES) - 1);
+}
+
+// 太陽の円盤の立体角
+// 1 - cosは桁落ちするので半角の公式で計算する
+Real sunSolidAngle() {
+  const Real s = std::sin(0.5f * HosekSky::SUN_RADIUS);
+  return PI_MUL_2 * 2 * s * s;
+}
+
+// 最近使ったテーブルを新しい順に並べたもの
+std::mutex table_cache_mutex;
+std::vector<std::shared_ptr<const HosekSky::Table>> table_cache;
+
+// パラメーターが同じテーブルがあれば使い回し、なければ作る
+std::shared_ptr<const HosekSky::Table> getTable(const Vec3& sun_direction,
+                                                const Real& turbidity,
+                                                const SPD& albedo) {
+  std::lock_guard<std::mutex> lock(table_cache_mutex);
+  for (auto it = table_cache.begin(); it != table_cache.end(); ++it) {
+    if ((*it)->hasSameParameters(sun_direction, turbidity, albedo)) {
+      const auto table = *it;
+      table_cache.erase(it);
+      table_cache.insert(table_cache.begin(), table);
+      return table;
+    }
+  }
+
+  const auto table =
+      std::make_shared<const HosekSky::Table>(sun_direction, turbidity, albedo);
+  table_cache.insert(table_cache.begin(), table);
+  if (table_cache.size() > TABLE_CACHE_SIZE) {
+    table_cache.pop_back();
+  }
+  return table;
+}
+
+}  // namespace
+
+HosekSky::Table::Table(const Vec3& _sun_direction, const Real& _turbidity,
+                       const SPD& _albedo)
+    : sun_direction(_sun_direction), turbidity(_turbidity), albedo(_albedo) {
+  Real sun_theta, _tmp;
+  cartesianToSpherical(sun_direction, sun_theta, _tmp);
+  const Real solarElevation = PI_DIV_2 - sun_theta;
 
   for (unsigned int i = 0; i < SPD::LAMBDA_SAMPLES; ++i) {
     state[i] =
         arhosekskymodelstate_alloc_init(solarElevation, turbidity, albedo[i]);
   }
+
+  // 画素の中心の方向で空の放射輝度を評価する
+  // 行ごとに独立なので並列に計算する
+  radiance.resize(TABLE_WIDTH * TABLE_HEIGHT * SPD::LAMBDA_SAMPLES);
+  std::vector<Real> weights(TABLE_WIDTH * TABLE_HEIGHT);
+  const auto bakeRows = [&](unsigned int j0, unsigned int j1) {
+    for (unsigned int j = j0; j < j1; ++j) {
+      const Real theta = PI_DIV_2 * (j + 0.5f) / TABLE_HEIGHT;
+      const Real sin_theta = std::sin(theta);
+      for (unsigned int i = 0; i < TABLE_WIDTH; ++i) {
+        const Real phi = PI_MUL_2 * (i + 0.5f) / TABLE_WIDTH;
+        const Vec3 direction = sphericalToCartesian(theta, phi);
+        const Real gamma = std::acos(
+            std::clamp(dot(direction, sun_direction), -1.0f, 1.0f));
+
+        const unsigned int index = i + TABLE_WIDTH * j;
+        float* texel = &radiance[index * SPD::LAMBDA_SAMPLES];
+        Real sum = 0;
+        for (unsigned int bin = 0; bin < SPD::LAMBDA_SAMPLES; ++bin) {
+          const Real l = SPD::LAMBDA_MIN + (bin + 0.5f) * SPD::LAMBDA_INTERVAL;
+          Real value = 0;
+          if (lambdaToBin(l) >= 0) {
+            value = arhosekskymodel_radiance(state[bin], theta, gamma, l);
+            if (!std::isfinite(value) || value < 0) {
+              value = 0;
+            }
+          }
+          texel[bin] = value;
+          sum += value;
+        }
+
+        // 波長は一様にサンプリングされるので、全波長の和を重みとする
+        weights[index] = sum * sin_theta;
+      }
+    }
+  };
+
+  const unsigned int num_threads =
+      std::max(std::thread::hardware_concurrency(), 1u);
+  const unsigned int num_chunks = std::min(num_threads, TABLE_HEIGHT);
+  std::vector<std::future<void>> results;
+  for (unsigned int k = 0; k < num_chunks; ++k) {
+    results.push_back(std::async(std::launch::async, bakeRows,
+                                 k * TABLE_HEIGHT / num_chunks,
+                                 (k + 1) * TABLE_HEIGHT / num_chunks));
+  }
+  for (auto& result : results) {
+    result.get();
+  }
+
+  distribution.build(weights);
+
+  // 太陽と空の放射束の比で太陽を選ぶ確率を決める
+  // 空の放射束は画素の放射輝度 * sinθ * dθ * dφの和
+  Real sky_power = 0;
+  for (const Real& w : weights) {
+    sky_power += w;
+  }
+  sky_power *= (PI_DIV_2 / TABLE_HEIGHT) * (PI_MUL_2 / TABLE_WIDTH);
+
+  Real sun_power = 0;
+  if (sun_theta < PI_DIV_2) {
+    for (unsigned int bin = 0; bin < SPD::LAMBDA_SAMPLES; ++bin) {
+      const Real l = SPD::LAMBDA_MIN + (bin + 0.5f) * SPD::LAMBDA_INTERVAL;
+      if (lambdaToBin(l) >= 0) {
+        const Real value =
+            arhosekskymodel_solar_radiance(state[bin], sun_theta, 0, l);
+        if (std::isfinite(value) && value > 0) {
+          sun_power += value;
+        }
+      }
+    }
+    sun_power *= sunSolidAngle();
+  }
+
+  sun_prob = sun_power + sky_power > 0 ? sun_power / (sun_power + sky_power)
+                                       : 0;
 }
 
-HosekSky::~HosekSky() {
+HosekSky::Table::~Table() {
   for (unsigned int i = 0; i < SPD::LAMBDA_SAMPLES; ++i) {
     arhosekskymodelstate_free(state[i]);
   }
 }
 
-Real HosekSky::getRadiance(const Ray& ray) const {
-  // Compute theta, gamma
+HosekSky::HosekSky(const Vec3& _sunDirection, const Real& turbidity,
+                   const SPD& albedo)
+    : sunDirection(normalize(_sunDirection)) {
+  table = getTable(sunDirection, turbidity, albedo);
+}
+
+bool HosekSky::inSunDisc(const Vec3& direction, Real& gamma) const {
+  // 角度が小さいのでacos(dot)ではなく外積の長さから計算する
+  if (dot(direction, sunDirection) <= 0) {
+    return false;
+  }
+  const Real sin_gamma = length(cross(direction, sunDirection));
+  if (sin_gamma >= std::sin(SUN_RADIUS)) {
+    return false;
+  }
+  gamma = std::asin(sin_gamma);
+  return true;
+}
+
+SampledSpectrum HosekSky::getRadiance(const Ray& ray,
+                                      const SampledWavelengths& lambda) const {
+  // Compute theta, phi
   Real theta, phi;
   cartesianToSpherical(ray.direction, theta, phi);
-  if (theta > PI_DIV_2) return 0;
-
-  const Real gamma = radianBetween(ray.direction, sunDirection);
-
-  Real ret = 0;
-  if (ray.lambda >= 320 && ray.lambda < 720) {
-    // Compute State Index
-    const unsigned int index = (ray.lambda - SPD::LAMBDA_MIN) /
-                               (SPD::LAMBDA_MAX - SPD::LAMBDA_MIN) *
-                               SPD::LAMBDA_SAMPLES;
-
-    // gammaが太陽の視野角/2以下なら太陽光を計算
-    if (gamma < 0.251 / 180.0 * PI) {
-      ret = arhosekskymodel_solar_radiance(state[index], theta, gamma,
-                                           ray.lambda);
-    } else {
-      ret = arhosekskymodel_radiance(state[index], theta, gamma, ray.lambda);
+  if (theta > PI_DIV_2) return SampledSpectrum(0);
+
+  // 太陽の円盤の中は解析的に計算する
+  SampledSpectrum ret;
+  Real gamma;
+  if (inSunDisc(ray.direction, gamma)) {
+    for (unsigned int k = 0; k < WAVELENGTH_SAMPLES; ++k) {
+      const int bin = lambdaToBin(lambda[k]);
+      if (bin >= 0) {
+        ret[k] = arhosekskymodel_solar_radiance(table->state[bin], theta,
+                                                gamma, lambda[k]);
+        if (std::isnan(ret[k])) {
+          ret[k] = 0;
+        }
+      }
     }
+    return ret;
   }
 
-  if (std::isnan(ret)) {
-    ret = 0;
+  // 画素の中心を格子点として双線形補間する
+  // φ方向は周期的につなぎ、θ方向は端の値で延長する
+  const Real x = phi * INV_PI_MUL_2 * TABLE_WIDTH - 0.5f;
+  const Real y = theta / PI_DIV_2 * TABLE_HEIGHT - 0.5f;
+  const int ix = std::floor(x);
+  const int iy = std::floor(y);
+  const Real fx = x - ix;
+  const Real fy = std::clamp(y - iy, 0.0f, 1.0f);
+  // φ >= 0なのでix >= -1になり、符号なしに直してから添字にする
+  const int max_iy = static_cast<int>(TABLE_HEIGHT) - 1;
+  const unsigned int i0 =
+      static_cast<unsigned int>(ix + static_cast<int>(TABLE_WIDTH)) %
+      TABLE_WIDTH;
+  const unsigned int i1 = static_cast<unsigned int>(ix + 1) % TABLE_WIDTH;
+  const unsigned int j0 = static_cast<unsigned int>(std::clamp(iy, 0, max_iy));
+  const unsigned int j1 =
+      static_cast<unsigned int>(std::clamp(iy + 1, 0, max_iy));
+
+  const float* t00 = &table->radiance[(i0 + TABLE_WIDTH * j0) *
+                                      SPD::LAMBDA_SAMPLES];
+  const float* t10 = &table->radiance[(i1 + TABLE_WIDTH * j0) *
+                                      SPD::LAMBDA_SAMPLES];
+  const float* t01 = &table->radiance[(i0 + TABLE_WIDTH * j1) *
+                                      SPD::LAMBDA_SAMPLES];
+  const float* t11 = &table->radiance[(i1 + TABLE_WIDTH * j1) *
+                                      SPD::LAMBDA_SAMPLES];
+  for (unsigned int k = 0; k < WAVELENGTH_SAMPLES; ++k) {
+    const int bin = lambdaToBin(lambda[k]);
+    if (bin >= 0) {
+      ret[k] = (1 - fy) * ((1 - fx) * t00[bin] + fx * t10[bin]) +
+               fy * ((1 - fx) * t01[bin] + fx * t11[bin]);
+    }
   }
   return ret;
 }
 
-}
\ No newline at end of file
+Vec3 HosekSky::sampleDirection(Sampler& sampler, Real& pdf) const {
+  Vec3 direction;
+  if (sampler.getNext() < table->sun_prob) {
+    // 太陽の円盤内で一様にサンプリングする
+    // 1 - cosが小さいので1 - cosθを直接サンプリングしてsinθを計算する
+    const Vec2 u = sampler.getNext2D();
+    const Real s = std::sin(0.5f * SUN_RADIUS);
+    const Real one_minus_cos = u.x() * 2 * s * s;
+    const Real cos_theta = 1 - one_minus_cos;
+    const Real sin_theta =
+        std::sqrt(std::max(0.0f, one_minus_cos * (2 - one_minus_cos)));
+    const Real phi = PI_MUL_2 * u.y();
+
+    Vec3 t, b;
+    orthonormalBasis(sunDirection, t, b);
+    direction = normalize(sin_theta * std::cos(phi) * t +
+                          cos_theta * sunDirection +
+                          sin_theta * std::sin(phi) * b);
+  } else {
+    // 画素を選び、画素内で一様に(u, v)をサンプリングする
+    Real texel_pdf;
+    const unsigned int index =
+        table->distribution.sample(sampler.getNext2D(), texel_pdf);
+    const unsigned int i = index % TABLE_WIDTH;
+    const unsigned int j = index / TABLE_WIDTH;
+
+    const Vec2 u = sampler.getNext2D();
+    const Real phi = PI_MUL_2 * (i + u.x()) / TABLE_WIDTH;
+    const Real theta = PI_DIV_2 * (j + u.y()) / TABLE_HEIGHT;
+    direction = sphericalToCartesian(theta, phi);
+  }
+
+  // 2つの手法を混合したpdfを計算する
+  pdf = getPdf(direction);
+  return direction;
+}
+
+Real HosekSky::getPdf(const Vec3& direction) const {
+  Real theta, phi;
+  cartesianToSpherical(direction, theta, phi);
+  if (theta > PI_DIV_2) {
+    return 0;
+  }
+
+  Real pdf = 0;
+
+  // 太陽
+  Real gamma;
+  if (table->sun_prob > 0 && inSunDisc(direction, gamma)) {
+    pdf += table->sun_prob / sunSolidAngle();
+  }
+
+  // 空
+  // 画素内では(u, v)について一様なので、dω = π^2 sinθ du dvで変換する
+  const Real sin_theta = std::sin(theta);
+  if (sin_theta > 0) {
+    const unsigned int i =
+        std::min(static_cast<unsigned int>(phi * INV_PI_MUL_2 * TABLE_WIDTH),
+                 TABLE_WIDTH - 1);
+    const unsigned int j =
+        std::min(static_cast<unsigned int>(theta / PI_DIV_2 * TABLE_HEIGHT),
+                 TABLE_HEIGHT - 1);
+    pdf += (1 - table->sun_prob) *
+           table->distribution.getPdf(i + TABLE_WIDTH * j) * TABLE_WIDTH *
+           TABLE_HEIGHT / (PI * PI * sin_theta);
+  }
+
+  return pdf;
+}
+
+}  // namespace Prl2
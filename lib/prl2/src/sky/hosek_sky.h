@@ -1,6 +1,8 @@
 #ifndef _PRL2_HOSEK_SKY
 #define _PRL2_HOSEK_SKY
 
+#include <memory>
+
 #include "core/spectrum.h"
 #include "sky/sky.h"
 
@@ -10,18 +12,44 @@ extern "C" {
 
 namespace Prl2 {
 
+// Hosek-Wilkieモデルによる空
+// 構築時に上半球の空の放射輝度を波長ごとに緯度経度のテーブルに焼き込み、
+// getRadianceではテーブルを双線形補間する
+// 太陽の円盤の中だけはモデルを解析的に評価する
+// 同じパラメーターのテーブルはキャッシュして使い回す
 class HosekSky : public Sky {
  public:
   HosekSky(const Vec3& _sunDirection, const Real& turbidity, const SPD& albedo);
-  ~HosekSky();
 
-  Real getRadiance(const Ray& ray) const override;
+  SampledSpectrum getRadiance(const Ray& ray,
+                              const SampledWavelengths& lambda) const override;
+
+  bool hasDistribution() const override { return true; };
+
+  // 太陽と空の放射束に比例してどちらかを選び、
+  // 太陽は円盤内で一様に、空はテーブルの画素を放射輝度に比例して選ぶ
+  Vec3 sampleDirection(Sampler& sampler, Real& pdf) const override;
+
+  Real getPdf(const Vec3& direction) const override;
+
+  // テーブルの解像度
+  static constexpr unsigned int TABLE_WIDTH = 256;  // φ方向の画素数
+  static constexpr unsigned int TABLE_HEIGHT = 64;  // θ方向の画素数(上半球)
+
+  // 太陽の視野角/2[rad]
+  static constexpr Real SUN_RADIUS = 0.251f / 180.0f * PI;
+
+  struct Table;
 
  private:
-  ArHosekSkyModelState* state[SPD::LAMBDA_SAMPLES];
-  const Vec3 sunDirection;  // 太陽の方向
+  std::shared_ptr<const Table> table;  // 焼き込んだテーブル
+  const Vec3 sunDirection;             // 太陽の方向
+
+  // directionが太陽の円盤の中にあるか
+  // 中にある場合は太陽の方向との角度をgammaに返す
+  bool inSunDisc(const Vec3& direction, Real& gamma) const;
 };
 
 }  // namespace Prl2
 
-#endif
\ No newline at end of file
+#endif
@@ -1,39 +1,115 @@
 #include "sky/ibl_sky.h"
 
 #include <algorithm>
+#include <cmath>
 
 #include "stb_image.h"
 
 namespace Prl2 {
 
-IBLSky::IBLSky(const std::string& filename) {
+IBLSky::IBLSky(const std::string& filename) : width(0), height(0) {
   // HDR画像の読み込み
   int c;
-  pixels = stbi_loadf(filename.c_str(), &width, &height, &c, 3);
-}
+  float* pixels = stbi_loadf(filename.c_str(), &width, &height, &c, 3);
+  if (pixels == nullptr) {
+    width = 0;
+    height = 0;
+    return;
+  }
+
+  // 画素ごとに基底の係数に変換し、画素を選ぶ重みを計算する
+  // 重みは画素の放射輝度の積分に比例するように輝度に画素の中心のsinθを掛ける
+  const std::size_t num_texels =
+      static_cast<std::size_t>(width) * static_cast<std::size_t>(height);
+  texels.resize(num_texels);
+  std::vector<Real> weights(num_texels);
+  for (int j = 0; j < height; ++j) {
+    const Real sin_theta = std::sin(PI * (j + 0.5f) / height);
+    for (int i = 0; i < width; ++i) {
+      const unsigned int index = static_cast<unsigned int>(i + width * j);
+      const RGB rgb(pixels[3 * index], pixels[3 * index + 1],
+                    pixels[3 * index + 2]);
+      texels[index] = RGB2SpectrumCoefficients(rgb);
 
-IBLSky::~IBLSky() { stbi_image_free(pixels); }
+      const Real luminance =
+          0.2126f * rgb.x() + 0.7152f * rgb.y() + 0.0722f * rgb.z();
+      weights[index] = std::max(luminance, 0.0f) * sin_theta;
+    }
+  }
+  stbi_image_free(pixels);
+
+  distribution.build(weights);
+}
 
-Real IBLSky::getRadiance(const Ray& ray) const {
+unsigned int IBLSky::getTexelIndex(const Vec3& direction) const {
   // 球面座標を計算
   Real theta, phi;
-  cartesianToSpherical(ray.direction, theta, phi);
+  cartesianToSpherical(direction, theta, phi);
 
   // (u, v)を計算
   const Real u = phi * INV_PI_MUL_2;
   const Real v = theta * INV_PI;
 
   // (i, j)を計算
-  const int i = u * width;
-  const int j = v * height;
+  const int i = std::clamp(static_cast<int>(u * width), 0, width - 1);
+  const int j = std::clamp(static_cast<int>(v * height), 0, height - 1);
+  return static_cast<unsigned int>(i + width * j);
+}
+
+SampledSpectrum IBLSky::getRadiance(const Ray& ray,
+                                    const SampledWavelengths& lambda) const {
+  if (texels.empty()) {
+    return SampledSpectrum(0);
+  }
+
+  // 基底を必要な波長だけサンプリングして足し合わせる
+  const RGBSpectrumCoefficients& texel = texels[getTexelIndex(ray.direction)];
+  SampledSpectrum radiance(0);
+  for (int k = 0; k < 3; ++k) {
+    if (texel.coeffs[k] != 0) {
+      radiance += texel.coeffs[k] *
+                  RGB2SpectrumBasis(texel.basis[k]).sample(lambda);
+    }
+  }
+  return radiance;
+}
+
+bool IBLSky::hasDistribution() const { return !texels.empty(); }
+
+Real IBLSky::toSolidAnglePdf(unsigned int index, const Real& sin_theta) const {
+  if (sin_theta <= 0) {
+    return 0;
+  }
+  // 画素内では(u, v)について一様なので、(u, v)のpdfはp * width * height
+  // dω = 2π^2 sinθ du dv で立体角測度に変換する
+  return distribution.getPdf(index) * width * height /
+         (2 * PI * PI * sin_theta);
+}
 
-  // RGBをSPDに変換
-  const Real r = pixels[3 * i + 3 * width * j];
-  const Real g = pixels[3 * i + 3 * width * j + 1];
-  const Real b = pixels[3 * i + 3 * width * j + 2];
-  const SPD spd = RGB2Spectrum(RGB(r, g, b));
+Vec3 IBLSky::sampleDirection(Sampler& sampler, Real& pdf) const {
+  // 画素を選ぶ
+  Real texel_pdf;
+  const unsigned int index =
+      distribution.sample(sampler.getNext2D(), texel_pdf);
+  const unsigned int i = index % static_cast<unsigned int>(width);
+  const unsigned int j = index / static_cast<unsigned int>(width);
+
+  // 画素内で一様に(u, v)をサンプリングする
+  const Vec2 u = sampler.getNext2D();
+  const Real phi = PI_MUL_2 * (i + u.x()) / width;
+  const Real theta = PI * (j + u.y()) / height;
+
+  pdf = toSolidAnglePdf(index, std::sin(theta));
+  return sphericalToCartesian(theta, phi);
+}
 
-  return spd.sample(ray.lambda);
+Real IBLSky::getPdf(const Vec3& direction) const {
+  if (texels.empty()) {
+    return 0;
+  }
+  const Real sin_theta = std::sqrt(
+      std::max(0.0f, 1.0f - direction.y() * direction.y()));
+  return toSolidAnglePdf(getTexelIndex(direction), sin_theta);
 }
 
-}  // namespace Prl2
\ No newline at end of file
+}  // namespace Prl2
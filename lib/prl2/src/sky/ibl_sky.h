@@ -2,24 +2,46 @@
 #define _PRL2_IBL_SKY_H
 
 #include <string>
+#include <vector>
 
 #include "core/spectrum.h"
+#include "sampler/alias-table.h"
 #include "sky/sky.h"
 
 namespace Prl2 {
+
+// HDR画像(正距円筒図法)による空
+// 読み込み時に各画素をRGB2Spectrumの基底の係数に変換しておき、
+// 放射輝度の計算では必要な波長だけ基底をサンプリングする
+// また画素ごとの放射輝度に比例する分布を作り、方向を重点的にサンプリングできる
 class IBLSky : public Sky {
  public:
   IBLSky(const std::string& filename);
-  ~IBLSky();
 
-  Real getRadiance(const Ray& ray) const override;
+  SampledSpectrum getRadiance(const Ray& ray,
+                              const SampledWavelengths& lambda) const override;
+
+  bool hasDistribution() const override;
+
+  // 画素を放射輝度に比例して選び、画素内で一様に方向をサンプリングする
+  Vec3 sampleDirection(Sampler& sampler, Real& pdf) const override;
+
+  Real getPdf(const Vec3& direction) const override;
 
  private:
-  int width;      // 横幅[px]
-  int height;     // 縦幅[px]
-  float* pixels;  // 画素の配列(容量削減のためRGBで保存)
+  int width;   // 横幅[px]
+  int height;  // 縦幅[px]
+  std::vector<RGBSpectrumCoefficients> texels;  // 画素ごとの基底の係数
+
+  AliasTable distribution;  // 画素を選ぶ分布(輝度 * sinθに比例)
+
+  // 方向に対応する画素の番号を計算する
+  unsigned int getTexelIndex(const Vec3& direction) const;
+
+  // 画素を選ぶ確率から立体角測度のpdfを計算する
+  Real toSolidAnglePdf(unsigned int index, const Real& sin_theta) const;
 };
 
 }  // namespace Prl2
 
-#endif
\ No newline at end of file
+#endif
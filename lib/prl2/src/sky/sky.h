@@ -1,8 +1,12 @@
 #ifndef _PRL2_SKY_H
 #define _PRL2_SKY_H
 
+#include "core/constant.h"
 #include "core/ray.h"
+#include "core/sampled-spectrum.h"
 #include "core/type.h"
+#include "sampler/sampler.h"
+#include "sampler/sampling.h"
 
 namespace Prl2 {
 
@@ -10,10 +14,26 @@ class Sky {
  public:
   Sky(){};
 
-  // レイの方向から来る放射輝度を計算して返す
-  virtual Real getRadiance(const Ray& ray) const = 0;
+  // レイの方向から来る放射輝度を波長ごとに計算して返す
+  virtual SampledSpectrum getRadiance(
+      const Ray& ray, const SampledWavelengths& lambda) const = 0;
+
+  // 放射輝度に応じた方向の分布を持つか
+  // trueの場合、NEEで空の方向を直接サンプリングする
+  virtual bool hasDistribution() const { return false; };
+
+  // 空の方向をサンプリングする
+  // pdfは立体角測度で返す
+  // デフォルトでは球面上で一様にサンプリングする
+  virtual Vec3 sampleDirection(Sampler& sampler, Real& pdf) const {
+    pdf = INV_PI_MUL_4;
+    return sampleSphere(sampler.getNext2D());
+  };
+
+  // sampleDirectionでdirectionがサンプリングされる確率密度(立体角測度)
+  virtual Real getPdf(const Vec3& direction) const { return INV_PI_MUL_4; };
 };
 
 }  // namespace Prl2
 
-#endif
\ No newline at end of file
+#endif
@@ -10,8 +10,9 @@ class UniformSky : public Sky {
  public:
   UniformSky(const SPD& _spd) noexcept : spd(_spd) {}
 
-  Real getRadiance(const Ray& ray) const override {
-    return spd.sample(ray.lambda);
+  SampledSpectrum getRadiance(const Ray& ray,
+                              const SampledWavelengths& lambda) const override {
+    return spd.sample(lambda);
   }
 
  private:
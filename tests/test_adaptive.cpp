@@ -0,0 +1,130 @@
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "light/area-light.h"
+#include "material/diffuse.h"
+#include "material/glass.h"
+#include "renderer/renderer.h"
+#include "renderer/scene-loader.h"
+#include "shape/plane.h"
+#include "shape/sphere.h"
+
+using namespace Prl2;
+
+// app/src/render.cppと同じCornell Box風のシーンを作る
+// 誤差の大きい画素ができるように球はガラスにしている
+void initScene(Scene& scene) {
+  const auto plane = std::make_shared<Plane>();
+  const auto sphere = std::make_shared<Sphere>();
+
+  const auto diffuse_white =
+      std::make_shared<Diffuse>(RGB2Spectrum(RGB(0.8)));
+  const auto diffuse_green =
+      std::make_shared<Diffuse>(RGB2Spectrum(RGB(0.0, 0.8, 0.0)));
+  const auto diffuse_red =
+      std::make_shared<Diffuse>(RGB2Spectrum(RGB(0.8, 0.0, 0.0)));
+  const auto glass = std::make_shared<Glass>(
+      SellmeierEquation(1.26, 0.15, 0.88, 0.009, 0.044, 106.82),
+      RGB2Spectrum(RGB(0.8)));
+
+  const auto geom1 = std::make_shared<Geometry>(
+      sphere, std::make_shared<Transform>(translate(Vec3(0, 1, 0))));
+  const auto geom2 = std::make_shared<Geometry>(
+      plane, std::make_shared<Transform>(scale(Vec3(4))));
+  const auto geom3 = std::make_shared<Geometry>(
+      plane, std::make_shared<Transform>(translate(Vec3(0, 4, 0)) *
+                                         scale(Vec3(4)) * rotateX(PI)));
+  const auto geom4 = std::make_shared<Geometry>(
+      plane, std::make_shared<Transform>(translate(Vec3(2, 2, 0)) *
+                                         scale(Vec3(4)) * rotateZ(PI_DIV_2)));
+  const auto geom5 = std::make_shared<Geometry>(
+      plane, std::make_shared<Transform>(translate(Vec3(-2, 2, 0)) *
+                                         scale(Vec3(4)) * rotateZ(-PI_DIV_2)));
+  const auto geom6 = std::make_shared<Geometry>(
+      plane, std::make_shared<Transform>(translate(Vec3(0, 2, -2)) *
+                                         scale(Vec3(4)) * rotateX(PI_DIV_2)));
+  const auto geom7 = std::make_shared<Geometry>(
+      plane,
+      std::make_shared<Transform>(translate(Vec3(0, 3.9, 0)) * rotateX(PI)));
+
+  const SPD light_spd({400, 500, 600, 700}, {0, 8, 15.6, 18.4});
+  const auto light = std::make_shared<AreaLight>(0.05 * light_spd, geom7);
+
+  scene.intersector = createIntersector(DEFAULT_INTERSECTOR_TYPE);
+  scene.addPrimitive(std::make_shared<Primitive>(geom1, glass));
+  scene.addPrimitive(std::make_shared<Primitive>(geom2, diffuse_white));
+  scene.addPrimitive(std::make_shared<Primitive>(geom3, diffuse_white));
+  scene.addPrimitive(std::make_shared<Primitive>(geom4, diffuse_green));
+  scene.addPrimitive(std::make_shared<Primitive>(geom5, diffuse_red));
+  scene.addPrimitive(std::make_shared<Primitive>(geom6, diffuse_white));
+  scene.addPrimitive(std::make_shared<Primitive>(geom7, diffuse_white, light));
+  scene.initScene();
+}
+
+Real computeRMSE(const std::vector<float>& image,
+                 const std::vector<float>& reference) {
+  double sum = 0;
+  for (std::size_t k = 0; k < image.size(); ++k) {
+    const double d = image[k] - reference[k];
+    sum += d * d;
+  }
+  return std::sqrt(sum / image.size());
+}
+
+// 同じサンプル数(ほぼ同じ時間)で一様なサンプリングとAdaptive Samplingを比較する
+// Adaptive SamplingのRMSEが一様なサンプリングより悪化していたら失敗とする
+int main() {
+  RenderConfig config;
+  config.width = 128;
+  config.height = 128;
+  config.tone_mapping_type = ToneMappingType::Linear;
+  config.sampler_type = "random";
+
+  Renderer renderer(config);
+  initScene(renderer.scene);
+
+  const std::atomic<bool> cancel(false);
+
+  // 参照画像
+  std::vector<float> reference;
+  renderer.config.samples = 4096;
+  renderer.render(cancel);
+  renderer.getLayersRGB(reference);
+
+  // 参照画像自体のノイズによる揺らぎを許容する
+  const Real tolerance = 0.05f;
+  unsigned int num_failures = 0;
+
+  for (const unsigned int samples : {16, 64, 256}) {
+    std::vector<float> image;
+    renderer.config.samples = samples;
+
+    renderer.config.render_adaptive = false;
+    renderer.render(cancel);
+    renderer.getLayersRGB(image);
+    const Real uniform_rmse = computeRMSE(image, reference);
+    const unsigned int uniform_time = renderer.getRenderingTime();
+
+    renderer.config.render_adaptive = true;
+    renderer.render(cancel);
+    renderer.getLayersRGB(image);
+    const Real adaptive_rmse = computeRMSE(image, reference);
+    const unsigned int adaptive_time = renderer.getRenderingTime();
+
+    std::cout << samples << " spp: uniform " << uniform_rmse << " ("
+              << uniform_time << " ms), adaptive " << adaptive_rmse << " ("
+              << adaptive_time << " ms), ratio "
+              << uniform_rmse / adaptive_rmse << std::endl;
+
+    if (adaptive_rmse > (1 + tolerance) * uniform_rmse) {
+      std::cout << samples << " spp: adaptive sampling is worse than uniform"
+                << std::endl;
+      num_failures++;
+    }
+  }
+
+  return num_failures == 0 ? 0 : 1;
+}
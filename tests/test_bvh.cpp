@@ -0,0 +1,121 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "intersector/bvh.h"
+#include "intersector/linear.h"
+#include "shape/mesh.h"
+#include "shape/sphere.h"
+
+using namespace Prl2;
+
+// ランダムに配置した球とメッシュに対してBVHIntersectorとLinearIntersectorの結果を比較する
+int main() {
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<float> dist(-1, 1);
+
+  // 球を並べる
+  const unsigned int num_primitives = 2000;
+  const auto sphere = std::make_shared<Sphere>();
+  std::vector<std::shared_ptr<Primitive>> prims;
+  for (unsigned int k = 0; k < num_primitives; ++k) {
+    const Vec3 center(20 * dist(rng), 20 * dist(rng), 20 * dist(rng));
+    const Real radius = 0.05f + 0.2f * std::abs(dist(rng));
+    const auto geom = std::make_shared<Geometry>(
+        sphere, std::make_shared<Transform>(translate(center) *
+                                            scale(Vec3(radius))));
+    prims.push_back(std::make_shared<Primitive>(geom, nullptr));
+  }
+
+  // ランダムな三角形からなるメッシュを1つのPrimitiveとして置く
+  // BVHは面ごとに構築されるので、衝突した面のインデックスも比較する
+  const unsigned int num_faces = 2000;
+  std::vector<Vec3> vertices;
+  std::vector<unsigned int> indices;
+  for (unsigned int f = 0; f < num_faces; ++f) {
+    const Vec3 center(10 * dist(rng), 10 * dist(rng), 10 * dist(rng));
+    for (int v = 0; v < 3; ++v) {
+      indices.push_back(static_cast<unsigned int>(vertices.size()));
+      vertices.push_back(center +
+                         0.3f * Vec3(dist(rng), dist(rng), dist(rng)));
+    }
+  }
+  const auto mesh = std::make_shared<TriangleMesh>();
+  mesh->num_vertices = vertices.size();
+  mesh->vertices = std::move(vertices);
+  mesh->indices = std::move(indices);
+  mesh->num_faces = num_faces;
+  prims.push_back(std::make_shared<Primitive>(
+      std::make_shared<Geometry>(
+          std::make_shared<Mesh>(mesh),
+          std::make_shared<Transform>(translate(Vec3(5, 0, 0)))),
+      nullptr));
+
+  LinearIntersector linear;
+  linear.setPrimitives(prims);
+  linear.initialize();
+
+  BVHIntersector bvh;
+  bvh.setPrimitives(prims);
+  const auto build_start = std::chrono::steady_clock::now();
+  bvh.initialize();
+  const auto build_end = std::chrono::steady_clock::now();
+  std::cout << "build: "
+            << std::chrono::duration_cast<std::chrono::microseconds>(
+                   build_end - build_start)
+                   .count()
+            << " us, nodes: " << bvh.getNumNodes() << std::endl;
+
+  // レイを生成する
+  const unsigned int num_rays = 20000;
+  std::vector<Ray> rays;
+  std::vector<Real> tmaxs;
+  for (unsigned int k = 0; k < num_rays; ++k) {
+    const Vec3 origin(25 * dist(rng), 25 * dist(rng), 25 * dist(rng));
+    const Vec3 direction =
+        normalize(Vec3(dist(rng), dist(rng), dist(rng)) + 1e-3f);
+    rays.emplace_back(origin, direction);
+    tmaxs.push_back(40 * std::abs(dist(rng)));
+  }
+
+  // 衝突計算の結果を比較する
+  unsigned int num_hits = 0;
+  unsigned int num_mismatches = 0;
+  double linear_time = 0;
+  double bvh_time = 0;
+  for (unsigned int k = 0; k < num_rays; ++k) {
+    IntersectInfo linear_info, bvh_info;
+
+    auto start = std::chrono::steady_clock::now();
+    const bool linear_hit = linear.intersect(rays[k], linear_info);
+    const bool linear_occluded = linear.occluded(rays[k], tmaxs[k]);
+    auto end = std::chrono::steady_clock::now();
+    linear_time += std::chrono::duration<double>(end - start).count();
+
+    start = std::chrono::steady_clock::now();
+    const bool bvh_hit = bvh.intersect(rays[k], bvh_info);
+    const bool bvh_occluded = bvh.occluded(rays[k], tmaxs[k]);
+    end = std::chrono::steady_clock::now();
+    bvh_time += std::chrono::duration<double>(end - start).count();
+
+    if (linear_hit) {
+      num_hits++;
+    }
+    if (linear_hit != bvh_hit || linear_occluded != bvh_occluded ||
+        (linear_hit && (linear_info.hitPrimitive != bvh_info.hitPrimitive ||
+                        linear_info.faceID != bvh_info.faceID ||
+                        std::abs(linear_info.t - bvh_info.t) > 1e-4f))) {
+      num_mismatches++;
+    }
+  }
+
+  std::cout << "hits: " << num_hits << "/" << num_rays
+            << ", mismatches: " << num_mismatches << std::endl;
+  std::cout << "linear: " << linear_time << " s, bvh: " << bvh_time
+            << " s, speedup: " << linear_time / bvh_time << std::endl;
+
+  return num_mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "light/area-light.h"
+#include "light/light-bvh.h"
+#include "shape/mesh.h"
+#include "shape/sphere.h"
+
+using namespace Prl2;
+
+// Light BVHの選択確率がsampleとgetPdfで一致するかを確認する
+// 子ノードの寄与が両方0になるとnullptrが返るので、確率の和は光源が選ばれる割合と一致する
+int main() {
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<float> dist(-1, 1);
+
+  std::vector<std::shared_ptr<Light>> lights;
+
+  // 明るさの違う球の光源
+  const auto sphere = std::make_shared<Sphere>();
+  for (unsigned int k = 0; k < 64; ++k) {
+    const Vec3 center(10 * dist(rng), 10 * dist(rng), 10 * dist(rng));
+    const Real radius = 0.1f + 0.3f * std::abs(dist(rng));
+    const auto geometry = std::make_shared<Geometry>(
+        sphere, std::make_shared<Transform>(translate(center) *
+                                            scale(Vec3(radius))));
+    lights.push_back(std::make_shared<AreaLight>(
+        SPD(0.1f + 10 * std::abs(dist(rng))), geometry));
+  }
+
+  // 面ごとに選ばれる三角形メッシュの光源
+  std::vector<Vec3> vertices;
+  std::vector<unsigned int> indices;
+  for (unsigned int f = 0; f < 256; ++f) {
+    const Vec3 center(10 * dist(rng), 10 * dist(rng), 10 * dist(rng));
+    for (int v = 0; v < 3; ++v) {
+      indices.push_back(static_cast<unsigned int>(vertices.size()));
+      vertices.push_back(center +
+                         0.5f * Vec3(dist(rng), dist(rng), dist(rng)));
+    }
+  }
+  const auto mesh = std::make_shared<TriangleMesh>();
+  mesh->num_vertices = vertices.size();
+  mesh->vertices = std::move(vertices);
+  mesh->indices = std::move(indices);
+  mesh->num_faces = 256;
+  lights.push_back(std::make_shared<AreaLight>(
+      SPD(1), std::make_shared<Geometry>(std::make_shared<Mesh>(mesh),
+                                         std::make_shared<Transform>())));
+
+  std::vector<const Light*> light_table;
+  for (unsigned int k = 0; k < lights.size(); ++k) {
+    lights[k]->setIndex(k);
+    light_table.push_back(lights[k].get());
+  }
+
+  LightBVH light_bvh;
+  light_bvh.build(light_table);
+
+  unsigned int num_failures = 0;
+  for (unsigned int trial = 0; trial < 16; ++trial) {
+    IntersectInfo info;
+    info.hitPos = Vec3(12 * dist(rng), 12 * dist(rng), 12 * dist(rng));
+    info.hitNormal = normalize(Vec3(dist(rng), dist(rng), dist(rng)));
+
+    // 全ての面の確率の和
+    double sum = 0;
+    for (const Light* light : light_table) {
+      for (unsigned int face = 0; face < light->getNumFaces(); ++face) {
+        sum += light_bvh.getPdf(info, light, face);
+      }
+    }
+
+    // サンプリングした時の確率がgetPdfと一致するか
+    bool consistent = true;
+    unsigned int num_samples = 0;
+    for (unsigned int k = 0; k < 10000; ++k) {
+      unsigned int face;
+      Real pdf;
+      const Light* light =
+          light_bvh.sample(info, 0.5f * (dist(rng) + 1), face, pdf);
+      if (light == nullptr) {
+        continue;
+      }
+      num_samples++;
+      const Real expected = light_bvh.getPdf(info, light, face);
+      if (std::abs(pdf - expected) > 1e-4f * expected) {
+        consistent = false;
+      }
+    }
+
+    const double ratio = num_samples / 10000.0;
+    std::cout << "sum of pdf: " << sum << ", sampled ratio: " << ratio
+              << ", consistent: " << (consistent ? "yes" : "no") << std::endl;
+    if (sum > 1 + 1e-3 || std::abs(sum - ratio) > 1e-2 || !consistent) {
+      num_failures++;
+    }
+  }
+
+  return num_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "camera/pinhole.h"
+#include "integrator/nee.h"
+#include "intersector/bvh.h"
+#include "light/area-light.h"
+#include "material/diffuse.h"
+#include "renderer/scene.h"
+#include "sampler/random.h"
+#include "shape/sphere.h"
+#include "sky/uniform_sky.h"
+
+using namespace Prl2;
+
+// NEEのスループットがスレッド数に対してどこまで伸びるかを測るベンチマーク
+// 各スレッドに同じ数のサンプルを割り当て、1スレッドの時との比を表示する
+// 光源の選択などで共有データへの書き込みがあるとスレッド数を増やしても伸びなくなる
+int main() {
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<float> dist(-1, 1);
+
+  const unsigned int width = 256;
+  const unsigned int height = 256;
+  const auto film = std::make_shared<Film>(width, height);
+  const auto camera = std::make_shared<PinholeCamera>(
+      film, std::make_shared<Transform>(translate(Vec3(0, 0, 10))), 90.0f);
+
+  Scene scene(camera, std::make_shared<BVHIntersector>(),
+              std::make_shared<UniformSky>(SPD(0.1f)));
+
+  // 拡散反射の球と光源の球を並べる
+  const auto sphere = std::make_shared<Sphere>();
+  const auto diffuse = std::make_shared<Diffuse>(SPD(0.8f));
+  for (unsigned int k = 0; k < 256; ++k) {
+    const Vec3 center(8 * dist(rng), 8 * dist(rng), 8 * dist(rng) - 4);
+    const Real radius = 0.2f + 0.5f * std::abs(dist(rng));
+    const auto geometry = std::make_shared<Geometry>(
+        sphere, std::make_shared<Transform>(translate(center) *
+                                            scale(Vec3(radius))));
+    std::shared_ptr<Light> light;
+    if (k % 16 == 0) {
+      light = std::make_shared<AreaLight>(SPD(10), geometry);
+    }
+    scene.addPrimitive(std::make_shared<Primitive>(geometry, diffuse, light));
+  }
+
+  // 床
+  scene.addPrimitive(std::make_shared<Primitive>(
+      std::make_shared<Geometry>(
+          sphere, std::make_shared<Transform>(translate(Vec3(0, -1009, 0)) *
+                                              scale(Vec3(1000)))),
+      diffuse));
+  scene.initScene();
+
+  const NEE integrator;
+  const unsigned int samples_per_thread = 1 << 16;
+
+  // スレッドごとに画素を順に辿ってサンプルを計算する
+  const auto run = [&](unsigned int num_threads) {
+    std::vector<std::thread> threads;
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned int t = 0; t < num_threads; ++t) {
+      threads.emplace_back([&, t]() {
+        RandomSampler sampler(t + 1);
+        IntegratorResult result;
+        for (unsigned int k = 0; k < samples_per_thread; ++k) {
+          const unsigned int pixel = (k + t * samples_per_thread) %
+                                     (width * height);
+          result.clear();
+          integrator.integrate(pixel % width, pixel / width, scene, sampler,
+                               result);
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    const auto finish = std::chrono::steady_clock::now();
+    return num_threads * samples_per_thread /
+           std::chrono::duration<double>(finish - start).count();
+  };
+
+  // 1, 2, 4, ...と増やし、最後はコア数で測る
+  const unsigned int max_threads =
+      std::max(1U, std::thread::hardware_concurrency());
+  std::vector<unsigned int> thread_counts;
+  for (unsigned int n = 1; n < max_threads; n *= 2) {
+    thread_counts.push_back(n);
+  }
+  thread_counts.push_back(max_threads);
+
+  double single = 0;
+  for (const unsigned int n : thread_counts) {
+    const double throughput = run(n);
+    if (n == 1) {
+      single = throughput;
+    }
+    std::cout << "threads: " << n << ", samples/s: " << throughput
+              << ", speedup: " << throughput / single
+              << ", efficiency: " << throughput / (n * single) << std::endl;
+  }
+
+  return 0;
+}
@@ -1,14 +1,62 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <vector>
 
 #include "parallel/parallel.h"
 
 using namespace Prl2;
 
+// 画像の一部だけが重い仕事を想定したベンチマーク
+// 割り切れないサイズでも全ての画素が1回ずつ処理されることを確認する
 int main() {
-  // parallelFor1D([](int i) { std::cout << i << std::endl; }, 4, 16);
+  Parallel pool;
 
-  parallelFor2D([](int x, int y) { std::cout << x << ", " << y << std::endl; },
-                2, 2, 4, 4);
+  const unsigned int nx = 509;
+  const unsigned int ny = 317;
+
+  std::vector<std::atomic<unsigned int>> count(nx * ny);
+  for (auto& c : count) {
+    c = 0;
+  }
+
+  const auto job = [&](unsigned int x, unsigned int y) {
+    // 中央付近の画素だけ重くする
+    const unsigned int iterations =
+        (x > nx / 3 && x < nx / 2 && y > ny / 3 && y < ny / 2) ? 20000 : 100;
+    volatile float v = 0;
+    for (unsigned int k = 0; k < iterations; ++k) {
+      v = v + std::sqrt(static_cast<float>(k));
+    }
+    count[x + nx * y]++;
+  };
+
+  const unsigned int tiles[][2] = {{2, 2}, {4, 4}, {16, 16}, {64, 64}};
+  for (const auto& t : tiles) {
+    for (auto& c : count) {
+      c = 0;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    pool.parallelFor2D(job, t[0], t[1], nx, ny);
+    const auto finish = std::chrono::steady_clock::now();
+
+    bool covered = true;
+    for (const auto& c : count) {
+      covered &= (c == 1);
+    }
+
+    std::cout << "tiles: " << t[0] << "x" << t[1] << ", time: "
+              << std::chrono::duration<float, std::milli>(finish - start)
+                     .count()
+              << " [ms], tail idle: " << pool.getTailIdleTime()
+              << " [ms], covered: " << (covered ? "yes" : "no") << std::endl;
+
+    if (!covered) {
+      return 1;
+    }
+  }
 
   return 0;
-}
\ No newline at end of file
+}